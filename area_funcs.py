@@ -420,12 +420,17 @@ def pocket(a,tool_radius, extra_offset, stepover, depthparams, from_center, keep
     
     current_start_depth = depthparams.start_depth
 
+    depth_index = 0
     if start_point==None:
         for depth in depths:
+            op_progress(float(depth_index) / len(depths))
+            depth_index += 1
             cut_curvelist1(curve_list, depthparams.rapid_safety_space, current_start_depth, depth, depthparams.clearance_height, keep_tool_down_if_poss)
             current_start_depth = depth
 
     else:
         for depth in depths:
+            op_progress(float(depth_index) / len(depths))
+            depth_index += 1
             cut_curvelist2(curve_list, depthparams.rapid_safety_space, current_start_depth, depth, depthparams.clearance_height, keep_tool_down_if_poss, start_point)
             current_start_depth = depth
@@ -6,7 +6,15 @@ if len(sys.argv)>2:
     nc_file = sys.argv[2]
     
     machine_module = __import__('nc.' + reader, fromlist = ['dummy'])
+
+    if len(sys.argv)>3 and sys.argv[3] == 'binary':
+        from nc.hbin_writer import HbinWriter
+        writer = HbinWriter()
+    else:
+        writer = HxmlWriter()
         
-    parser = machine_module.Parser(HxmlWriter())
+    parser = machine_module.Parser(writer)
 
     parser.Parse(nc_file)
+
+    if hasattr(writer, 'close'): writer.close()
@@ -318,7 +318,10 @@ def profile(curve, direction = "on", radius = 1.0, offset_extra = 0.0, roll_radi
     
     endpoint = None
     
+    depth_index = 0
     for depth in depths:
+        op_progress(float(depth_index) / len(depths))
+        depth_index += 1
         mat_depth = prev_depth
         
         if len(tags) > 0:
@@ -3,14 +3,117 @@
 #
 # NC code creator for attaching Z coordinates to a surface
 #
+# The moves are projected onto the surface by the nc_attach library, which is built with HeeksCNC.
+# This creator only collects the moves of each path, and hands them all to the library at once.
+# If the library can't be loaded, OpenCAMLib is used instead, as it was before there was a library, and the output window says so.
 
 import recreator
-import ocl
-import ocl_funcs
 import nc
+import ctypes
+import array
+import sys
+import os
+import struct
+import math
 
 attached = False
 units = 1.0
+library_path = None # HeeksCNC sets this to the nc_attach library's file path
+library = None
+library_failed = False
+
+def library_not_loaded(reason):
+    global library
+    global library_failed
+    library = None
+    library_failed = True
+    # on stderr, so HeeksCNC shows it in the output window
+    sys.stderr.write('Error: the nc_attach library couldn\'t be loaded (' + reason + '), so OpenCAMLib is being used to attach to the surface\n')
+
+def load_library():
+    # returns None, if the library can't be loaded
+    global library
+    if library == None and not library_failed:
+        if library_path == None:
+            library_not_loaded('attach.library_path isn\'t set')
+            return None
+        try:
+            library = ctypes.CDLL(library_path)
+            library.attach_new
+        except (OSError, AttributeError) as e:
+            library_not_loaded(library_path + ': ' + str(e))
+            return None
+        library.attach_new.restype = ctypes.c_void_p
+        library.attach_new.argtypes = [ctypes.c_char_p]
+        library.attach_delete.argtypes = [ctypes.c_void_p]
+        library.attach_set_tool.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.c_double]
+        library.attach_drop.restype = ctypes.c_double
+        library.attach_drop.argtypes = [ctypes.c_void_p, ctypes.c_double, ctypes.c_double, ctypes.c_double]
+        library.attach_cut_path.restype = ctypes.c_int
+        library.attach_cut_path.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_double), ctypes.POINTER(ctypes.c_double), ctypes.c_int, ctypes.c_double, ctypes.c_double, ctypes.c_double]
+        library.attach_get_moves.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_double)]
+    return library
+
+# the move types of attach_cut_path
+LINE = 0
+ARC_CW = 1
+ARC_CCW = 2
+
+def is_binary_stl(filepath):
+    # a binary STL file is an 80 byte header, the number of triangles, then 50 bytes for each triangle
+    try:
+        f = open(filepath, 'rb')
+        header = f.read(84)
+        f.close()
+        if len(header) < 84: return False
+        count = struct.unpack('<I', header[80:84])[0]
+        return os.path.getsize(filepath) == 84 + count * 50
+    except (IOError, OSError):
+        return False
+
+################################################################################
+class Surface:
+    # the triangles of an STL file, loaded into the nc_attach library, or into OpenCAMLib
+
+    def __init__(self, filepath):
+        self.library = load_library()
+        self.handle = None
+        self.tool_set = None # the library makes a new tool each time it is given one, so it is only given one when it changes
+        if isinstance(filepath, unicode):
+            filepath = filepath.encode(sys.getfilesystemencoding())
+        if self.library == None:
+            # OpenCAMLib's STLReader only reads ASCII files, and would give an empty surface, which every point would drop through
+            if is_binary_stl(filepath):
+                raise IOError("OpenCAMLib can't read the binary STL file " + filepath + ", and the nc_attach library couldn't be loaded")
+            import ocl_funcs
+            self.ocl_surface = ocl_funcs.STLSurfFromFile(filepath)
+            return
+        self.handle = self.library.attach_new(filepath)
+        if not self.handle:
+            raise IOError("can't read " + filepath)
+
+    def __del__(self):
+        if self.handle:
+            self.library.attach_delete(self.handle)
+
+    def set_tool(self, tool, material_allowance):
+        if self.tool_set == (tool, material_allowance):
+            return
+        self.tool_set = (tool, material_allowance)
+        type, diameter, corner_radius, flat_radius, cutting_edge_angle = tool
+        self.library.attach_set_tool(self.handle, type, diameter, corner_radius, flat_radius, cutting_edge_angle, material_allowance)
+
+# the same cutters as CTool::OCLDefinition, for when the library can't be loaded
+def ocl_cutter(tool, material_allowance):
+    import ocl
+    type, diameter, corner_radius, flat_radius, cutting_edge_angle = tool
+    if type == 4: # ball end mill
+        return ocl.BallCutter(float(diameter + material_allowance * 2), 1000)
+    if type == 5 or type == 6: # chamfer or engraving tool
+        return ocl.CylConeCutter(float(flat_radius * 2 + material_allowance), float(diameter + material_allowance * 2), float(cutting_edge_angle * math.pi/360))
+    if corner_radius > 0.000000001:
+        return ocl.BullCutter(float(diameter + material_allowance * 2), float(corner_radius), 1000)
+    return ocl.CylCutter(float(diameter + material_allowance * 2), 1000)
 
 ################################################################################
 class Creator(recreator.Redirector):
@@ -18,70 +121,119 @@ class Creator(recreator.Redirector):
     def __init__(self, original):
         recreator.Redirector.__init__(self, original)
 
-        self.stl = None
-        self.cutter = None
+        self.stl = None # a Surface
+        self.tool = None # type, diameter, corner radius, flat radius, cutting edge angle
         self.minz = None
-        self.path = None
-        self.pdcf = None
         self.material_allowance = 0.0
+        self.sampling = 0.1
+        self.tolerance = 0.005
+        self.path_start = None
+        self.moves = array.array('d') # six numbers for each move; type, x, y, z, centre x, centre y
+        self.pdcf = None # OpenCAMLib's PathDropCutter, if the library can't be loaded
+        self.path = None # the OpenCAMLib path
 
     ############################################################################
     ##  Shift in Z
-    
-    def setPdcfIfNotSet(self):
+
+    def drop_minz(self):
+        if (self.z>self.minz):
+            return self.z  # Adjust Z if we have gotten a higher limit (Fix pocketing loosing steps when using attach?)
+        return self.minz/units # Else use minz
+
+    def z2(self, z):
+        if self.stl.library == None:
+            return self.ocl_z2()
+        self.stl.set_tool(self.tool, self.material_allowance)
+        return self.stl.library.attach_drop(self.stl.handle, self.x, self.y, self.drop_minz()) + self.material_allowance/units
+
+    def cut_path(self):
+        if self.stl != None and self.stl.library == None:
+            self.ocl_cut_path()
+            return
+        if len(self.moves) == 0: return
+        self.stl.set_tool(self.tool, self.material_allowance)
+
+        # get the moves on the surface, all at once
+        num_moves = len(self.moves) / 6
+        start = (ctypes.c_double * 3)(*self.path_start)
+        moves = ctypes.cast(self.moves.buffer_info()[0], ctypes.POINTER(ctypes.c_double))
+        n = self.stl.library.attach_cut_path(self.stl.handle, start, moves, num_moves, self.drop_minz(), self.sampling, self.tolerance)
+        made = (ctypes.c_double * (n * 6))()
+        self.stl.library.attach_get_moves(self.stl.handle, made)
+        self.moves = array.array('d')
+
+        for m in range(0, n):
+            type, x, y, z, i, j = made[m * 6 : m * 6 + 6]
+            z = z/units + self.material_allowance/units
+            if type == LINE:
+                self.original.feed(x/units, y/units, z)
+            elif type == ARC_CCW:
+                self.original.arc_ccw(x/units, y/units, z, i/units, j/units)
+            else:
+                self.original.arc_cw(x/units, y/units, z, i/units, j/units)
+
+    def add_move(self, type, px, py, pz, i = 0.0, j = 0.0):
+        if self.stl != None and self.stl.library == None:
+            self.ocl_add_move(type, px, py, pz, i, j)
+            return
+        if len(self.moves) == 0:
+            self.path_start = (px, py, pz)
+        self.moves.extend((type, self.x, self.y, self.z, i, j))
+
+    ############################################################################
+    ##  OpenCAMLib, for when the library can't be loaded
+
+    def set_pdcf_if_not_set(self):
+        import ocl
         if self.pdcf == None:
             self.pdcf = ocl.PathDropCutter()
-            self.pdcf.setSTL(self.stl)
-            self.pdcf.setCutter(self.cutter)
-            self.pdcf.setSampling(0.1)
-            self.pdcf.setZ(self.minz/units)
-                    
-    def z2(self, z):
+            self.pdcf.setSTL(self.stl.ocl_surface)
+            self.pdcf.setCutter(ocl_cutter(self.tool, self.material_allowance))
+            self.pdcf.setSampling(self.sampling)
+        self.pdcf.setZ(self.drop_minz())
+
+    def ocl_z2(self):
+        import ocl
         path = ocl.Path()
         # use a line with no length
         path.append(ocl.Line(ocl.Point(self.x, self.y, self.z), ocl.Point(self.x, self.y, self.z)))
-        self.setPdcfIfNotSet()
-        if (self.z>self.minz):
-            self.pdcf.setZ(self.z)  # Adjust Z if we have gotten a higher limit (Fix pocketing loosing steps when using attach?)
-        else:
-            self.pdcf.setZ(self.minz/units) # Else use minz
+        self.set_pdcf_if_not_set()
         self.pdcf.setPath(path)
         self.pdcf.run()
         plist = self.pdcf.getCLPoints()
-        p = plist[0]
-        return p.z + self.material_allowance/units
-        
-    def cut_path(self):
+        return plist[0].z + self.material_allowance/units
+
+    def ocl_cut_path(self):
+        import ocl
         if self.path == None: return
-        self.setPdcfIfNotSet()
-        
-        if (self.z>self.minz):
-            self.pdcf.setZ(self.z)  # Adjust Z if we have gotten a higher limit (Fix pocketing loosing steps when using attach?)
-        else:
-            self.pdcf.setZ(self.minz/units) # Else use minz
-            
-       # get the points on the surface
+        self.set_pdcf_if_not_set()
+
+        # get the points on the surface
         self.pdcf.setPath(self.path)
-        
         self.pdcf.run()
         plist = self.pdcf.getCLPoints()
-        
-        #refine the points
+
+        # refine the points
         f = ocl.LineCLFilter()
-        f.setTolerance(0.005)
+        f.setTolerance(self.tolerance)
         for p in plist:
             f.addCLPoint(p)
         f.run()
         plist = f.getCLPoints()
-        
-        i = 0
-        for p in plist:
-            if i > 0:
-                self.original.feed(p.x/units, p.y/units, p.z/units + self.material_allowance/units)
-            i = i + 1
-            
-        self.path = ocl.Path()
-        
+
+        for p in plist[1:]:
+            self.original.feed(p.x/units, p.y/units, p.z/units + self.material_allowance/units)
+
+        self.path = None
+
+    def ocl_add_move(self, type, px, py, pz, i, j):
+        import ocl
+        if self.path == None: self.path = ocl.Path()
+        if type == LINE:
+            self.path.append(ocl.Line(ocl.Point(px, py, pz), ocl.Point(self.x, self.y, self.z)))
+        else:
+            self.path.append(ocl.Arc(ocl.Point(px, py, pz), ocl.Point(self.x, self.y, self.z), ocl.Point(i, j, pz), type == ARC_CCW))
+
     def rapid(self, x=None, y=None, z=None, a=None, b=None, c=None ):
         if z != None:
             if z < self.z:
@@ -97,23 +249,25 @@ class Creator(recreator.Redirector):
             return
         if px == self.x and py == self.y:
             return
-            
+
         # add a line to the path
-        if self.path == None: self.path = ocl.Path()
-        self.path.append(ocl.Line(ocl.Point(px, py, pz), ocl.Point(self.x, self.y, self.z)))
-        
+        self.add_move(LINE, px, py, pz)
+
     def arc(self, x=None, y=None, z=None, i=None, j=None, k=None, r=None, ccw = True):
         px = self.x
         py = self.y
         pz = self.z
         recreator.Redirector.arc(self, x, y, z, i, j, k, r, ccw)
-        
+
         # add an arc to the path
-        if self.path == None: self.path = ocl.Path()
-        self.path.append(ocl.Arc(ocl.Point(px, py, pz), ocl.Point(self.x, self.y, self.z), ocl.Point(i, j, pz), ccw))
-        
-    def set_ocl_cutter(self, cutter):
-        self.cutter = cutter
+        if ccw: type = ARC_CCW
+        else: type = ARC_CW
+        self.add_move(type, px, py, pz, i * units, j * units)
+
+    def set_tool(self, type, diameter, corner_radius, flat_radius, cutting_edge_angle):
+        self.cut_path()
+        self.tool = (type, diameter, corner_radius, flat_radius, cutting_edge_angle)
+        self.pdcf = None
 
 ################################################################################
 
@@ -124,8 +278,6 @@ def attach_begin():
     nc.creator = Creator(nc.creator)
     recreator.units = units
     attached = True
-    nc.creator.pdcf = None
-    nc.creator.path = None
 
 def attach_end():
     global attached
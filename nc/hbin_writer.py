@@ -0,0 +1,230 @@
+################################################################################
+# hbin_writer.py
+#
+# Writes the backplot in the binary format read by CNCCode::ReadFromBinaryFile,
+# instead of the xml written by hxml_writer.py.
+#
+# Everything is in the machine's native byte order.
+# The file is a header, followed by these sections, each padded to 8 bytes:
+#   colour names      16 bytes each, zero padded; the colours below index this table
+#   blocks            uint32 number of texts, uint32 number of moves
+#   texts             uint32 offset into text arena, uint32 length in bytes, uint32 colour
+#   text arena        utf-8
+#   move types        uint8, 0 - line, 1 - arc
+#   move colours      uint8
+#   move tools        int32
+#   move end points   float64 x, y, z, in mm
+#   arc centres       float64 x, y, z, in mm, relative to the arc's start point
+#   arc directions    int8, 1 - anti-clockwise, -1 - clockwise
+#
+# Positions are absolute and in mm, so the reader has nothing to work out.
+
+import tempfile
+import struct
+import array
+import math
+
+HBIN_MAGIC = 'HNCB'
+HBIN_VERSION = 1
+
+class HbinWriter:
+    def __init__(self, file_path = None):
+        if file_path == None: file_path = tempfile.gettempdir()+'/backplot.hnc'
+        self.file_path = file_path
+        self.closed = False
+
+        self.colours = []
+        self.colour_index = {}
+
+        self.blocks = array.array('I')
+        self.texts = array.array('I')
+        self.text_arena = []
+        self.text_bytes = 0
+
+        self.move_types = array.array('B')
+        self.move_colours = array.array('B')
+        self.move_tools = array.array('i')
+        self.move_x = array.array('d')
+        self.arc_c = array.array('d')
+        self.arc_dir = array.array('b')
+
+        self.block_texts = 0
+        self.block_moves = 0
+        self.in_block = False
+
+        self.units = 1.0
+        self.path_col = 0
+        self.t = None
+        self.pos = [0.0, 0.0, 0.0] # in mm
+        self.oldx = None
+        self.oldy = None
+        self.oldz = None
+
+    def __del__(self):
+        self.close()
+
+    def close(self):
+        if self.closed: return
+        self.closed = True
+        if self.in_block: self.end_ncblock()
+
+        f = open(self.file_path, 'wb')
+        f.write(HBIN_MAGIC)
+        f.write(struct.pack('=7I', HBIN_VERSION, len(self.colours), len(self.blocks) / 2, len(self.texts) / 3, self.text_bytes, len(self.move_types), len(self.arc_dir)))
+
+        names = ''
+        for name in self.colours:
+            names += name[:15].ljust(16, '\0')
+        self.write_section(f, names)
+        self.write_section(f, self.blocks.tostring())
+        self.write_section(f, self.texts.tostring())
+        self.write_section(f, ''.join(self.text_arena))
+        self.write_section(f, self.move_types.tostring())
+        self.write_section(f, self.move_colours.tostring())
+        self.write_section(f, self.move_tools.tostring())
+        self.write_section(f, self.move_x.tostring())
+        self.write_section(f, self.arc_c.tostring())
+        self.write_section(f, self.arc_dir.tostring())
+        f.close()
+
+    def write_section(self, f, s):
+        f.write(s)
+        if len(s) % 8: f.write('\0' * (8 - len(s) % 8))
+
+    def get_colour(self, col):
+        if col == None: col = 'default'
+        if not col in self.colour_index:
+            self.colour_index[col] = len(self.colours)
+            self.colours.append(col)
+        return self.colour_index[col]
+
+    def write(self, s):
+        pass
+
+############################################
+
+    def begin_ncblock(self):
+        if self.in_block: self.end_ncblock()
+        self.in_block = True
+        self.block_texts = 0
+        self.block_moves = 0
+
+    def end_ncblock(self):
+        self.blocks.append(self.block_texts)
+        self.blocks.append(self.block_moves)
+        self.in_block = False
+
+    def add_text(self, s, col, cdata):
+        if isinstance(s, unicode): s = s.encode('utf-8')
+        self.texts.append(self.text_bytes)
+        self.texts.append(len(s))
+        self.texts.append(self.get_colour(col))
+        self.text_arena.append(s)
+        self.text_bytes += len(s)
+        self.block_texts += 1
+
+    def set_mode(self, units):
+        if (units != None) : self.units = float(units)
+
+    def metric(self):
+        self.set_mode(units = 1.0)
+
+    def imperial(self):
+        self.set_mode(units = 25.4)
+
+    def begin_path(self, col):
+        if col == None: col = 'rapid'
+        self.path_col = self.get_colour(col)
+
+    def end_path(self):
+        pass
+
+    def rapid(self, x=None, y=None, z=None, a=None, b=None, c=None):
+        self.begin_path("rapid")
+        self.add_line(x, y, z, a, b, c)
+        self.end_path()
+
+    def feed(self, x=None, y=None, z=None, a=None, b=None, c=None):
+        self.begin_path("feed")
+        self.add_line(x, y, z, a, b, c)
+        self.end_path()
+
+    def arc_cw(self, x=None, y=None, z=None, i=None, j=None, k=None, r=None):
+        self.begin_path("feed")
+        self.add_arc(x, y, z, i, j, k, r, -1)
+        self.end_path()
+
+    def arc_ccw(self, x=None, y=None, z=None, i=None, j=None, k=None, r=None):
+        self.begin_path("feed")
+        self.add_arc(x, y, z, i, j, k, r, 1)
+        self.end_path()
+
+    def tool_change(self, id):
+        self.t = id
+
+    def current_tool(self):
+        return self.t
+
+    def spindle(self, s, clockwise):
+        pass
+
+    def feedrate(self, f):
+        pass
+
+    def add_move(self, type, x, y, z):
+        if x != None: self.pos[0] = x * self.units
+        if y != None: self.pos[1] = y * self.units
+        if z != None: self.pos[2] = z * self.units
+        self.move_types.append(type)
+        self.move_colours.append(self.path_col)
+        tool = 0
+        if self.t != None: tool = int(self.t)
+        self.move_tools.append(tool)
+        self.move_x.extend(self.pos)
+        self.block_moves += 1
+
+    def add_line(self, x, y, z, a = None, b = None, c = None):
+        self.add_move(0, x, y, z)
+        if x != None: self.oldx = x
+        if y != None: self.oldy = y
+        if z != None: self.oldz = z
+
+    def add_arc(self, x, y, z, i, j, k, r = None, d = None):
+        if d == None: d = 1
+        start = list(self.pos)
+        centre = [0.0, 0.0, 0.0]
+        if r != None:
+            centre = self.centre_from_radius(start, x, y, r * self.units, d)
+        else:
+            if (i != None):
+                if self.oldx == None: print 'arc move "i" without x set!'
+                else: centre[0] = (i - self.oldx) * self.units
+            if (j != None):
+                if self.oldy == None: print 'arc move "j" without y set!'
+                else: centre[1] = (j - self.oldy) * self.units
+            if (k != None):
+                if self.oldz == None: print 'arc move "k" without z set!'
+                else: centre[2] = (k - self.oldz) * self.units
+        self.add_move(1, x, y, z)
+        self.arc_c.extend(centre)
+        self.arc_dir.append(d)
+        if x != None: self.oldx = x
+        if y != None: self.oldy = y
+        if z != None: self.oldz = z
+
+    def centre_from_radius(self, start, x, y, r, d):
+        # a positive radius means the shorter way round, a negative one the longer way round
+        ex = start[0]
+        ey = start[1]
+        if x != None: ex = x * self.units
+        if y != None: ey = y * self.units
+        vx = ex - start[0]
+        vy = ey - start[1]
+        l = math.sqrt(vx * vx + vy * vy)
+        if l == 0.0: return [0.0, 0.0, 0.0]
+        h = r * r - l * l / 4
+        if h < 0.0: h = 0.0
+        h = math.sqrt(h)
+        # left of the direction of travel for a short anti-clockwise arc
+        if (r < 0) != (d < 0): h = -h
+        return [vx / 2 - vy * h / l, vy / 2 + vx * h / l, 0.0]
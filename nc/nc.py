@@ -39,6 +39,12 @@ class Creator:
     def write(self, s):
         self.file.write(s)
 
+    def progress(self, op_index, op_count, fraction = 0.0):
+        """Tell HeeksCNC how far through the program it has got; fraction is how far through the operation"""
+        import sys
+        sys.stdout.write('HEEKSCNC_PROGRESS\t%d\t%d\t%d\n' % (op_index, op_count, int(fraction * 1000)))
+        sys.stdout.flush()
+
     ############################################################################
     ##  Programs
 
@@ -404,6 +410,22 @@ def write(s):
 def output(filename):
     creator.file_open(filename)
 
+progress_op_index = 0
+progress_op_count = 0
+progress_fraction = 0.0
+
+def progress(op_index, op_count, fraction = 0.0):
+    global progress_op_index, progress_op_count, progress_fraction
+    progress_op_index = op_index
+    progress_op_count = op_count
+    progress_fraction = fraction
+    creator.progress(op_index, op_count, fraction)
+
+def op_progress(fraction):
+    # for the helpers, like kurve_funcs.profile, to tell how far through the operation they have got; it only goes forwards
+    if progress_op_count == 0 or fraction <= progress_fraction: return
+    progress(progress_op_index, progress_op_count, fraction)
+
 ############################################################################
 ##  Programs
 
@@ -0,0 +1,353 @@
+################################################################################
+# opcache.py
+#
+# Keeps the NC code made by each operation, so it can be used again, without running the operation, in the next post-process
+#
+# HeeksCNC puts each operation's python in a block like this
+#
+#   if not opcache.begin('key'):
+#       ...the operation...
+#       opcache.end()
+#
+# The key is a hash, made by HeeksCNC, of everything the operation's NC code depends on.
+# The state of the machine's creator, at the start of the block, is added to it here, so the NC code is only used again
+# if the operation starts from the same state. The state at the end of the block is kept with the NC code, and given back to
+# the creator when the NC code is used again, so the operations after it carry on as if it had been run.
+#
+# HeeksCNC can also make a program for each operation, which run_jobs runs, at the same time, before the operations, then removes.
+# Each of these runs the python before the operations, then the operation, with the creator in a CallRecorder, which keeps every call
+# made to the creator, and everything read from it. When the program gets to the operation's block, and there's no NC code kept for it,
+# the calls are given to its creator. This makes the same NC code as running the operation, with the modal words and tool changes right
+# for where the program is, as long as the creator gives the same answers to what the operation read. If it doesn't, the operation is run.
+# Operations which use a surface or a pattern don't get a program, because their redirector reads where the operation before left the creator.
+
+import nc
+import os
+import hashlib
+import pickle
+import sys
+import subprocess
+import time
+
+folder = None # HeeksCNC sets this to the folder the NC code is kept in
+used = [] # the keys of the blocks in this program
+recording = None
+job = os.environ.get('HEEKSCNC_OPCACHE_JOB') != None # this is one of the programs run by run_jobs
+
+class Recorder:
+    # writes to the creator's file, and keeps what was written
+    def __init__(self, file):
+        self.file = file
+        self.text = []
+
+    def write(self, s):
+        if self.file != None: self.file.write(s)
+        self.text.append(s)
+
+    def __getattr__(self, name):
+        return getattr(self.file, name)
+
+class Recording:
+    def __init__(self, creator, key):
+        self.creator = creator
+        self.key = key
+        self.recorder = Recorder(creator.file)
+        creator.file = self.recorder
+
+def canonical(value, depth = 0):
+    # a string, which is the same for equal values, in any run of python
+    if depth > 20: return '?'
+    if isinstance(value, dict):
+        items = []
+        for k in value:
+            if k == 'file': continue
+            items.append(canonical(k, depth + 1) + ':' + canonical(value[k], depth + 1))
+        items.sort()
+        return '{' + ','.join(items) + '}'
+    if isinstance(value, (list, tuple)):
+        return '[' + ','.join([canonical(v, depth + 1) for v in value]) + ']'
+    if isinstance(value, (str, int, float, bool)) or value is None:
+        return repr(value)
+    if hasattr(value, '__dict__'):
+        return value.__class__.__name__ + canonical(value.__dict__, depth + 1)
+    return repr(value) # includes the address, so it won't match another run
+
+def state_of(creator):
+    state = dict(creator.__dict__)
+    if 'file' in state: del state['file']
+    return state
+
+def file_paths(key):
+    path = os.path.join(folder, key)
+    return path + '.nc', path + '.state'
+
+def job_file_paths(cpp_key):
+    path = os.path.join(folder, cpp_key)
+    return path + '.calls', path + '.out'
+
+def save(key, text, creator):
+    try:
+        state = pickle.dumps(state_of(creator), 2)
+    except:
+        return # the state can't be kept, so neither can the NC code
+
+    nc_path, state_path = file_paths(key)
+    try:
+        if not os.path.isdir(folder): os.makedirs(folder)
+        f = open(nc_path, 'w')
+        f.write(text)
+        f.close()
+        f = open(state_path, 'wb')
+        f.write(state)
+        f.close()
+    except:
+        pass
+
+def begin(cpp_key):
+    # returns True if the kept NC code was written, and the block doesn't need to be run
+    global recording
+    recording = None
+    creator = nc.creator
+    if folder == None or not hasattr(creator, 'file'): return False
+
+    state = canonical(state_of(creator))
+    if not isinstance(state, bytes): state = state.encode('utf-8')
+    key = cpp_key + '-' + hashlib.md5(state).hexdigest()[:16]
+    used.append(key)
+    used.append(cpp_key) # for the calls kept by the operation's program
+
+    nc_path, state_path = file_paths(key)
+    if os.path.isfile(nc_path) and os.path.isfile(state_path):
+        try:
+            f = open(state_path, 'rb')
+            state = pickle.load(f)
+            f.close()
+            f = open(nc_path, 'r')
+            text = f.read()
+            f.close()
+        except:
+            state = None
+        if state != None:
+            creator.file.write(text)
+            creator.__dict__.update(state)
+            return True
+
+    calls_path, out_path = job_file_paths(cpp_key)
+    if os.path.isfile(calls_path):
+        if replay(creator, key, calls_path, out_path): return True
+
+    recording = Recording(creator, key)
+    return False
+
+def end():
+    global recording
+    if recording == None: return
+    r = recording
+    recording = None
+    creator = r.creator
+    if creator.file is not r.recorder:
+        # the operation has changed the file, maybe to write a subprogram, so its NC code isn't all in one place
+        return
+    creator.file = r.recorder.file
+    save(r.key, ''.join(r.recorder.text), creator)
+
+def finish():
+    # removes the NC code kept for blocks which aren't in this program any more
+    if folder == None or not os.path.isdir(folder): return
+    keep = set()
+    for key in used:
+        for path in file_paths(key) + job_file_paths(key):
+            keep.add(os.path.basename(path))
+    for name in os.listdir(folder):
+        if os.path.splitext(name)[1] in ['.nc', '.state', '.calls', '.out', '.tmp'] and not name in keep:
+            try:
+                os.remove(os.path.join(folder, name))
+            except:
+                pass
+
+################################################################################
+# the programs for each operation
+
+class CallRecorder(object):
+    # passes everything on to the creator, and keeps it in calls
+    def __init__(self, creator):
+        object.__setattr__(self, 'creator', creator)
+        object.__setattr__(self, 'calls', [])
+
+    def __getattr__(self, name):
+        try:
+            value = getattr(self.creator, name)
+        except AttributeError:
+            self.calls.append(('missing', name))
+            raise
+        if callable(value):
+            calls = self.calls
+            def call(*args, **kwargs):
+                result = value(*args, **kwargs)
+                calls.append(('call', name, args, kwargs, canonical(result)))
+                return result
+            return call
+        self.calls.append(('get', name, canonical(value)))
+        return value
+
+    def __setattr__(self, name, value):
+        self.calls.append(('set', name, value))
+        setattr(self.creator, name, value)
+
+def output_filename(filename):
+    # the programs run by run_jobs mustn't write over the program's NC code
+    if job:
+        if not os.path.isdir(folder): os.makedirs(folder)
+        return os.path.join(folder, 'job%d.tmp' % os.getpid())
+    return filename
+
+def record_begin():
+    nc.creator = CallRecorder(nc.creator)
+
+def record_end(cpp_key):
+    recorder = nc.creator
+    if not isinstance(recorder, CallRecorder): return # the operation didn't finish with the creator it started with
+    nc.creator = recorder.creator
+    nc.creator.file.close()
+    try:
+        os.remove(nc.creator.filename)
+    except:
+        pass
+
+    try:
+        data = pickle.dumps(recorder.calls, 2)
+    except:
+        return # the operation will be run by the program
+    calls_path, out_path = job_file_paths(cpp_key)
+    f = open(calls_path, 'wb')
+    f.write(data)
+    f.close()
+
+def has_nc_code(cpp_key):
+    for name in os.listdir(folder):
+        if name.startswith(cpp_key + '-') and name.endswith('.nc'): return True
+    return False
+
+def number_of_processors():
+    try:
+        import multiprocessing
+        return multiprocessing.cpu_count()
+    except:
+        return 2
+
+def remove_files(paths):
+    for path in paths:
+        try:
+            os.remove(path)
+        except:
+            pass
+
+def read_jobs(filepath):
+    # the list of jobs HeeksCNC writes; a line for each, with the key, a tab, then the program's file path
+    jobs = []
+    try:
+        f = open(filepath, 'r')
+        for line in f.readlines():
+            fields = line.rstrip('\r\n').split('\t')
+            if len(fields) == 2: jobs.append((fields[0], fields[1]))
+        f.close()
+    except:
+        pass
+    remove_files([filepath]) # it is written again for each post-process
+    return jobs
+
+def run_jobs(jobs):
+    # jobs is a list of ( key, program file path ); runs the programs, as many at once as there are processors, and waits for them all
+    try:
+        if folder != None and not job: run_programs(jobs)
+    finally:
+        # the programs are only run once; the next post-process writes new ones
+        remove_files([path for cpp_key, path in jobs])
+
+def run_programs(jobs):
+    if not os.path.isdir(folder): os.makedirs(folder)
+
+    waiting = []
+    for cpp_key, path in jobs:
+        calls_path, out_path = job_file_paths(cpp_key)
+        if has_nc_code(cpp_key) or os.path.isfile(calls_path): continue # the operation hasn't changed
+        waiting.append((cpp_key, path))
+
+    env = dict(os.environ)
+    env['HEEKSCNC_OPCACHE_JOB'] = '1'
+    devnull = open(os.devnull, 'w') # errors are shown when the program runs the operation
+    running = []
+    max_running = number_of_processors()
+
+    while len(waiting) > 0 or len(running) > 0:
+        while len(waiting) > 0 and len(running) < max_running:
+            cpp_key, path = waiting.pop(0)
+            calls_path, out_path = job_file_paths(cpp_key)
+            out = open(out_path, 'w')
+            try:
+                process = subprocess.Popen([sys.executable, path], stdout = out, stderr = devnull, cwd = os.path.dirname(path), env = env)
+            except:
+                out.close()
+                continue
+            running.append((process, out))
+
+        still_running = []
+        for process, out in running:
+            if process.poll() == None:
+                still_running.append((process, out))
+            else:
+                out.close()
+        if len(still_running) == len(running): time.sleep(0.02)
+        running = still_running
+
+    devnull.close()
+
+def replay(creator, key, calls_path, out_path):
+    # gives the calls made by the operation's program to the creator, returns False if the creator didn't give the same answers
+    try:
+        f = open(calls_path, 'rb')
+        calls = pickle.load(f)
+        f.close()
+        state = pickle.dumps(state_of(creator), 2)
+    except:
+        return False
+
+    file = creator.file
+    buffer = Recorder(None)
+    creator.file = buffer
+    same = True
+    try:
+        for c in calls:
+            if c[0] == 'call':
+                same = canonical(getattr(creator, c[1])(*c[2], **c[3])) == c[4]
+            elif c[0] == 'get':
+                same = hasattr(creator, c[1]) and canonical(getattr(creator, c[1])) == c[2]
+            elif c[0] == 'missing':
+                same = not hasattr(creator, c[1])
+            elif c[0] == 'set':
+                setattr(creator, c[1], c[2])
+            if not same: break
+    except:
+        same = False
+    if creator.file is not buffer: same = False
+
+    if not same:
+        # put the creator back as it was, for the operation to be run
+        creator.__dict__.clear()
+        creator.__dict__.update(pickle.loads(state))
+        creator.file = file
+        return False
+
+    creator.file = file
+    text = ''.join(buffer.text)
+    file.write(text)
+    save(key, text, creator)
+
+    # anything the operation printed
+    try:
+        f = open(out_path, 'r')
+        sys.stdout.write(f.read())
+        f.close()
+    except:
+        pass
+    return True
@@ -298,3 +298,6 @@ class Redirector(nc.Creator):
         
     def set_ocl_cutter(self, cutter):
         self.original.set_ocl_cutter(cutter)
+
+    def set_tool(self, type, diameter, corner_radius, flat_radius, cutting_edge_angle):
+        self.original.set_tool(type, diameter, corner_radius, flat_radius, cutting_edge_angle)
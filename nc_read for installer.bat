@@ -1 +1 @@
-.\python.exe backplot.py %1 %2
+.\python.exe backplot.py %1 %2 %3
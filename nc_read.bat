@@ -1 +1 @@
-%HOMEDRIVE%\python26\python.exe backplot.py %1 %2
+%HOMEDRIVE%\python26\python.exe backplot.py %1 %2 %3
@@ -0,0 +1,132 @@
+# post_worker.py
+#
+# Runs python scripts, like post.py and backplot.py, one after the other, for HeeksCNC
+# It is started once and kept running, so python, and the modules the scripts import, are only loaded once
+#
+# Each job is a line on stdin; the working directory, the script, and the script's arguments, separated by tabs
+# When the script has finished, a line with DONE_MARKER is written to stderr, then to stdout
+# Modules stay loaded between jobs; compiled ones, like area and ocl, and the helpers, like area_funcs, kurve_funcs and the post module
+# Only the creator, and the modules which keep one program's state, are made again for each job
+# If one of the loaded python files has changed, all the modules loaded from python files are forgotten
+
+import sys
+import os
+import traceback
+
+DONE_MARKER = 'HEEKSCNC_WORKER_JOB_DONE'
+
+# modules which keep the state of the program they were used by
+PER_JOB_MODULES = ['nc.attach', 'nc.transform', 'nc.opcache', 'nc.drag_knife', 'nc.swap', 'nc.recreator']
+
+file_times = {} # module name -> modification time of its python file, when it was first seen
+
+def is_python_file(module):
+    filepath = getattr(module, '__file__', None)
+    if filepath == None: return False
+    return os.path.splitext(filepath)[1].lower() in ['.py', '.pyc', '.pyo']
+
+def file_time(module):
+    filepath = os.path.splitext(module.__file__)[0] + '.py'
+    try:
+        return os.path.getmtime(filepath)
+    except:
+        return None
+
+def files_changed():
+    changed = False
+    for name, module in sys.modules.items():
+        if not is_python_file(module): continue
+        t = file_time(module)
+        if name not in file_times: file_times[name] = t
+        elif file_times[name] != t: changed = True
+    return changed
+
+def base_creator(creator):
+    # the creator the post module made, from inside the redirectors and recorders the program put round it
+    while True:
+        d = getattr(creator, '__dict__', {})
+        if 'original' in d: creator = d['original']
+        elif 'creator' in d: creator = d['creator']
+        else: return creator
+
+def reset_creator():
+    nc_module = sys.modules.get('nc.nc')
+    if nc_module == None: return
+    creator = base_creator(getattr(nc_module, 'creator', None))
+
+    # close the output file, in case the last job stopped before program_end
+    f = getattr(creator, 'file', None)
+    if f != None:
+        try:
+            f.close()
+        except:
+            pass
+
+    # the post module stays loaded, so it won't make the next job's creator when it is imported
+    try:
+        nc_module.creator = creator.__class__()
+    except:
+        nc_module.creator = nc_module.Creator()
+
+def forget_modules(modules_at_start, names):
+    for name in list(sys.modules.keys()):
+        if name in modules_at_start: continue
+        if name in names:
+            if name in file_times: del file_times[name]
+            del sys.modules[name]
+
+def reset(modules_at_start, path_at_start, working_dir_at_start):
+    reset_creator()
+    if files_changed():
+        # start again with all the python files, as they would be for a new python
+        python_modules = [name for name in sys.modules.keys() if sys.modules[name] == None or is_python_file(sys.modules[name])]
+        forget_modules(modules_at_start, python_modules)
+    else:
+        forget_modules(modules_at_start, PER_JOB_MODULES)
+        kurve_funcs = sys.modules.get('kurve_funcs')
+        if kurve_funcs != None: kurve_funcs.clear_tags()
+    sys.path[:] = path_at_start
+    sys.argv[:] = [sys.argv[0]]
+    os.chdir(working_dir_at_start)
+
+def run_job(line, path_at_start):
+    fields = line.rstrip('\r\n').split('\t')
+    working_dir = fields[0]
+    script = fields[1]
+
+    os.chdir(working_dir)
+    sys.argv[:] = fields[1:]
+    # as if python had been started with the script
+    sys.path[:] = [os.path.dirname(os.path.abspath(script))] + path_at_start[1:]
+
+    f = open(script, 'r')
+    text = f.read()
+    f.close()
+
+    exec(compile(text, script, 'exec'), {'__name__':'__main__', '__file__':script})
+
+def main():
+    modules_at_start = set(sys.modules.keys())
+    path_at_start = list(sys.path)
+    working_dir_at_start = os.getcwd()
+
+    while True:
+        line = sys.stdin.readline()
+        if len(line) == 0: break # HeeksCNC has finished with this worker
+        if len(line.strip()) == 0: continue
+
+        try:
+            run_job(line, path_at_start)
+        except SystemExit:
+            pass
+        except:
+            traceback.print_exc()
+
+        reset(modules_at_start, path_at_start, working_dir_at_start)
+
+        sys.stderr.write(DONE_MARKER + '\n')
+        sys.stderr.flush()
+        sys.stdout.write(DONE_MARKER + '\n')
+        sys.stdout.flush()
+
+main()
@@ -23,6 +23,7 @@
 #include "PythonStuff.h"
 #include "Program.h"
 #include "Surface.h"
+#include "DropCutterTool.h"
 
 #include <sstream>
 #include <string>
@@ -1093,6 +1094,16 @@ TopoDS_Shape CTool::GetShape() const
    } // End catch
 } // End GetShape() method
 
+// DropCutterTool.cpp doesn't include CTool.h, so it has its own copy of the tool types
+typedef char DropCutterToolTypesMatch[(DropCutterBallEndMill == CToolParams::eBallEndMill && DropCutterChamfer == CToolParams::eChamfer && DropCutterEngravingTool == CToolParams::eEngravingTool) ? 1 : -1];
+
+// static
+DropCutterTool* DropCutterTool::New(const CTool* tool, double allowance)
+{
+	const CToolParams &params = tool->m_params;
+	return New(params.m_type, params.m_diameter, params.m_corner_radius, params.m_flat_radius, params.m_cutting_edge_angle, allowance);
+}
+
 Python CTool::OCLDefinition(CSurface* surface) const
 {
 	Python python;
@@ -19,6 +19,7 @@
 #include "stdafx.h"
 #include "DropCutter.h"
 #include "GTri.h"
+#include "GTriGrid.h"
 
 
 Cutter::Cutter(double Rset, double rset)
@@ -171,7 +172,7 @@ double DropCutter::FacetTest(const Cutter &cu, const double *e, const GTri &t)
 		return -10000000.0;
 }
 
-static bool isinrange(double start, double end, double x)
+static bool isinrange(double start, double end, double x, double tolerance)
 {
 	// order input
 	double s_tmp = start;
@@ -182,13 +183,21 @@ static bool isinrange(double start, double end, double x)
 		end = s_tmp;
 	}
 
-	if ((x >= start - heeksCAD->GetTolerance()) && (x <= end + heeksCAD->GetTolerance()))
+	if ((x >= start - tolerance) && (x <= end + tolerance))
 		return true;
 	else
 		return false;
 }
 
 double DropCutter::EdgeTest(const Cutter &cu, const double *e, const double *p1, const double *p2)
+{
+	const char* error = NULL;
+	double ze = EdgeTest(cu, e, p1, p2, heeksCAD->GetTolerance(), error);
+	if(error)wxMessageBox(Ctt(error));
+	return ze;
+}
+
+double DropCutter::EdgeTest(const Cutter &cu, const double *e, const double *p1, const double *p2, double tolerance, const char* &error)
 {
 	// contact cutter against edge from p1 to p2
 
@@ -230,23 +239,23 @@ double DropCutter::EdgeTest(const Cutter &cu, const double *e, const double *p1,
 
 	if (fabs(start[1]-end[1])>0.0000000001)
 	{
-		wxMessageBox(wxString::Format(_T("EdgeTest ERROR! (start.y - end.y) = %lf"), start[1]-end[1]));
+		error = "EdgeTest ERROR! (start.y - end.y) != 0";
 		return -10000000.0;
 	}
 
 	double l = -start[1]; // distance from cutter to edge
-	if (l < -heeksCAD->GetTolerance())
-		wxMessageBox(_T("EdgeTest ERROR! l<0 !"));
+	if (l < -tolerance)
+		error = "EdgeTest ERROR! l<0 !";
 
 	// System.Console.WriteLine("l=" + l+" start.y="+start.y+" end.y="+end.y);
 
 
 	// now we have two different algorithms depending on the cutter:
-	if (fabs(cu.r) < heeksCAD->GetTolerance())
+	if (fabs(cu.r) < tolerance)
 	{
 		// this is the flat endmill case
 		// it is easier and faster than the general case, so we handle it separately
-		if (l > cu.R + heeksCAD->GetTolerance()) // edge is outside of the cutter
+		if (l > cu.R + tolerance) // edge is outside of the cutter
 			return -10000000.0;
 		else // we are inside the cutter
 		{
@@ -272,9 +281,9 @@ double DropCutter::EdgeTest(const Cutter &cu, const double *e, const double *p1,
 			}
 
 			// now that we have a CC point, check if it's in the edge
-			if ((start[0] > xc + heeksCAD->GetTolerance()) && (xc + heeksCAD->GetTolerance()< end[0]))
+			if ((start[0] > xc + tolerance) && (xc + tolerance< end[0]))
 				return -10000000.0;
-			else if ((end[0] < xc - heeksCAD->GetTolerance()) && (xc + heeksCAD->GetTolerance() > start[0]))
+			else if ((end[0] < xc - tolerance) && (xc + tolerance > start[0]))
 				return -10000000.0;
 			else
 				return zc;
@@ -291,9 +300,9 @@ double DropCutter::EdgeTest(const Cutter &cu, const double *e, const double *p1,
 
 		double xd=0, w=0, h=0, xd1=0, xd2=0, xc=0 , ze=0, zc=0;
 
-		if (l > cu.R + heeksCAD->GetTolerance()) // edge is outside of the cutter
+		if (l > cu.R + tolerance) // edge is outside of the cutter
 			return -10000000.0;
-		else if (((cu.R-cu.r)<l - heeksCAD->GetTolerance())&&(l<=cu.R + heeksCAD->GetTolerance()))
+		else if (((cu.R-cu.r)<l - tolerance)&&(l<=cu.R + tolerance))
 		{    // toroidal case
 			xd=0; // center of ellipse
 			w=sqrt(pow(cu.R,2)-pow(l,2)); // width of ellipse
@@ -310,9 +319,9 @@ double DropCutter::EdgeTest(const Cutter &cu, const double *e, const double *p1,
 
 		// now there is a special case where the theta calculation will fail if
 		// the segment is horziontal, i.e. start.z==end.z  so we need to catch that here
-		if (fabs(start[2] - end[2]) < heeksCAD->GetTolerance())
+		if (fabs(start[2] - end[2]) < tolerance)
 		{
-			if ((cu.R-cu.r)<l - heeksCAD->GetTolerance())
+			if ((cu.R-cu.r)<l - tolerance)
 			{
 				// half-ellipse case
 				xc=0;
@@ -328,7 +337,7 @@ double DropCutter::EdgeTest(const Cutter &cu, const double *e, const double *p1,
 
 			// now we have a CC point
 			// so we need to check if the CC point is in the edge
-			if (isinrange(start[0], end[0], xc))
+			if (isinrange(start[0], end[0], xc, tolerance))
 				return ze;
 			else
 				return -10000000.0;
@@ -342,7 +351,7 @@ double DropCutter::EdgeTest(const Cutter &cu, const double *e, const double *p1,
 		if(fabs(end[0] - start[0]) < 0.000000001)return -10000000.0; // instead of maths error below
 
 		// based on this calculate the CC point
-		if (((cu.R - cu.r) < l - heeksCAD->GetTolerance()) && (cu.R <= l + heeksCAD->GetTolerance()))
+		if (((cu.R - cu.r) < l - tolerance) && (cu.R <= l + tolerance))
 		{
 			// half-ellipse case
 			double xc1 = xd + fabs(w * cos(theta));
@@ -386,7 +395,7 @@ double DropCutter::EdgeTest(const Cutter &cu, const double *e, const double *p1,
 		ze = zc + fabs(h * sin(theta)) - cu.r;
 
 		// finally, check that the CC point is in the edge
-		if (isinrange(start[0],end[0],xc))
+		if (isinrange(start[0],end[0],xc, tolerance))
 			return ze;
 		else
 			return -10000000.0;
@@ -398,7 +407,7 @@ double DropCutter::EdgeTest(const Cutter &cu, const double *e, const double *p1,
 
 
 	// if we ever get here it is probably a serious error!
-	wxMessageBox(_T("EdgeTest: ERROR: no case returned a valid ze!"));
+	error = "EdgeTest: ERROR: no case returned a valid ze!";
 	return -10000000.0;
 }
 
@@ -493,3 +502,41 @@ double DropCutter::TriTest(const Cutter &cu, const double *e, const std::list<GT
 	return z;
 }
 
+double DropCutter::TriTest(const Cutter &cu, const double *e, const std::vector<GTri> &tris, double minz)
+{
+	double z = minz;
+	for(std::vector<GTri>::const_iterator It = tris.begin(); It != tris.end(); It++)
+	{
+		const GTri& tri = *It;
+		double temp_z = TriTest(cu, e, tri, minz);
+		if(temp_z > z)z = temp_z;
+	}
+
+	return z;
+}
+
+double DropCutter::TriTest(const Cutter &cu, const double *e, const GTriGrid &grid, double minz)
+{
+	// the cutter's box
+	double box[4] = {e[0] - cu.R, e[1] - cu.R, e[0] + cu.R, e[1] + cu.R};
+	int x0, y0, x1, y1;
+	if(!grid.GetCells(box, x0, y0, x1, y1))return minz;
+
+	double z = minz;
+	for(int y = y0; y <= y1; y++)
+	{
+		for(int x = x0; x <= x1; x++)
+		{
+			for(const unsigned int* It = grid.CellBegin(x, y); It != grid.CellEnd(x, y); It++)
+			{
+				const GTri& tri = grid.m_tris[*It];
+				if(!grid.FirstCell(tri, box, x, y))continue; // it has been tested already
+				double temp_z = TriTest(cu, e, tri, minz);
+				if(temp_z > z)z = temp_z;
+			}
+		}
+	}
+
+	return z;
+}
+
@@ -17,6 +17,9 @@
 // Anders Wallin said:
 // yes, you are free to release this under the BSD license if you want. As someone pointed out on my blog the edge-test for the toroidal cutter is wrong, or at least only an approximation to the exact geometry
 
+#include <list>
+#include <vector>
+
 class Cutter{
 public:
 	double R; // shaft radius
@@ -25,6 +28,7 @@ public:
 };
 
 class GTri;
+class GTriGrid;
 
 class DropCutter
 {
@@ -32,6 +36,7 @@ public:
 	static double VertexTest(const Cutter &c, const double *e, const double *p);
     static double FacetTest(const Cutter &cu, const double *e, const GTri &t);
 	static double EdgeTest(const Cutter &cu, const double *e, const double *p1, const double *p2);
+	static double EdgeTest(const Cutter &cu, const double *e, const double *p1, const double *p2, double tolerance, const char* &error); // for other threads; error is set, instead of showing a message box
     static bool isinside(const GTri &t, const double *p);
     static bool isright(const double *p1, const double *p2, const double *p);
 
@@ -40,5 +45,9 @@ public:
 
 	// This one does TriTest for a whole load of triangles
     static double TriTest(const Cutter &cu, const double *e, const std::list<GTri> &tri_list, double minz);
+    static double TriTest(const Cutter &cu, const double *e, const std::vector<GTri> &tris, double minz);
+
+	// This one only does TriTest for the triangles in the grid cells under the cutter
+    static double TriTest(const Cutter &cu, const double *e, const GTriGrid &grid, double minz);
 };
 
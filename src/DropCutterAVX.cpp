@@ -0,0 +1,57 @@
+// DropCutterAVX.cpp
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+// DropCutterBatch's kernel for four locations at a time.
+// With gcc, this file is built with -mavx, so it must only be called after DropCutterBatch has checked the CPU.
+// It doesn't include stdafx.h, so nothing from the precompiled header is built with AVX instructions.
+
+#include "DropCutterKernel.h"
+
+#if defined(__AVX__) || (defined(_MSC_VER) && _MSC_VER >= 1600 && (defined(_M_X64) || defined(_M_IX86)))
+#define DROP_CUTTER_AVX
+#include <immintrin.h>
+#endif
+
+#ifdef DROP_CUTTER_AVX
+class AVXLanes
+{
+public:
+	typedef __m256d Real;
+	typedef __m256d Mask;
+	enum{width = 4};
+
+	static Real Set(double d){return _mm256_set1_pd(d);}
+	static Real Load(const double* p){return _mm256_loadu_pd(p);}
+	static void Store(double* p, Real v){_mm256_storeu_pd(p, v);}
+	static Real Add(Real a, Real b){return _mm256_add_pd(a, b);}
+	static Real Sub(Real a, Real b){return _mm256_sub_pd(a, b);}
+	static Real Mul(Real a, Real b){return _mm256_mul_pd(a, b);}
+	static Real Div(Real a, Real b){return _mm256_div_pd(a, b);}
+	static Real Sqrt(Real a){return _mm256_sqrt_pd(a);}
+	static Mask Greater(Real a, Real b){return _mm256_cmp_pd(a, b, _CMP_GT_OQ);}
+	static Mask GreaterEqual(Real a, Real b){return _mm256_cmp_pd(a, b, _CMP_GE_OQ);}
+	static Mask LessEqual(Real a, Real b){return _mm256_cmp_pd(a, b, _CMP_LE_OQ);}
+	static Mask And(Mask a, Mask b){return _mm256_and_pd(a, b);}
+	static Mask Or(Mask a, Mask b){return _mm256_or_pd(a, b);}
+	static Mask AndNot(Mask a, Mask b){return _mm256_andnot_pd(a, b);}
+	static Real Select(Mask m, Real a, Real b){return _mm256_blendv_pd(b, a, m);}
+	static int Bits(Mask m){return _mm256_movemask_pd(m);}
+};
+
+static void AVXDropCutterKernel(const Cutter &cu, const GTri &t, const DropCutterTriangle &dt, const double* x, const double* y, double* z, unsigned int n)
+{
+	DropCutterRun<AVXLanes>(cu, t, dt, x, y, z, n);
+	_mm256_zeroupper();
+}
+
+DropCutterKernel GetAVXDropCutterKernel()
+{
+	return AVXDropCutterKernel;
+}
+#else
+DropCutterKernel GetAVXDropCutterKernel()
+{
+	return NULL;
+}
+#endif
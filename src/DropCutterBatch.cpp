@@ -0,0 +1,193 @@
+// DropCutterBatch.cpp
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+#include "stdafx.h"
+#include "DropCutterKernel.h"
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DROP_CUTTER_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+DropCutterTriangle::DropCutterTriangle(const Cutter &cu, const GTri &t, double tolerance)
+{
+	// the facet, like in DropCutter::FacetTest
+	double n[3] = {t.m_n[0], t.m_n[1], t.m_n[2]};
+	if(fabs(n[2]) < 0.000000000001)
+	{
+		m_facet = 0;
+	}
+	else
+	{
+		if(n[2] < 0)
+		{
+			for(int i = 0; i<3; i++)n[i] = -1*n[i];
+		}
+		m_a = n[0];
+		m_b = n[1];
+		m_c = n[2];
+		double d = - n[0] * t.m_p[0] - n[1] * t.m_p[1] - n[2] * t.m_p[2];
+		m_nd_c = -d/m_c;
+
+		if((fabs(m_a) < tolerance) && (fabs(m_b) < tolerance))
+		{
+			m_facet = 1;
+		}
+		else
+		{
+			m_facet = 2;
+			double theta = asin(m_c);
+			m_k1 = (cu.R-cu.r)/tan(theta);
+			m_k2 = cu.r/sin(theta);
+			double k = (cu.R-cu.r)/cos(theta)+cu.r;
+			m_off[0] = k*n[0];
+			m_off[1] = k*n[1];
+		}
+	}
+
+	// the isright tests
+	const double* p1 = &t.m_p[0];
+	const double* p2 = &t.m_p[3];
+	const double* p3 = &t.m_p[6];
+	m_right[0] = p2[1] - p1[1];
+	m_right[1] = -(p2[0] - p1[0]);
+	m_right[2] = p1[1] - p3[1];
+	m_right[3] = -(p1[0] - p3[0]);
+	m_right[4] = p3[1] - p2[1];
+	m_right[5] = -(p3[0] - p2[0]);
+
+	// the edges; the distance limit is bigger than DropCutter::EdgeTest's, so the edges it would use are never skipped
+	for(int edge = 0; edge < 3; edge++)
+	{
+		const double* s = &t.m_p[edge * 3];
+		const double* e = &t.m_p[((edge + 1) % 3) * 3];
+		double dx = e[0] - s[0];
+		double dy = e[1] - s[1];
+		double length = sqrt(dx * dx + dy * dy);
+		m_edge_skip[edge] = (length > tolerance);
+		if(m_edge_skip[edge])
+		{
+			m_edge_normal[edge * 2] = -dy / length;
+			m_edge_normal[edge * 2 + 1] = dx / length;
+			m_edge_d[edge] = m_edge_normal[edge * 2] * s[0] + m_edge_normal[edge * 2 + 1] * s[1];
+			m_edge_dir[edge * 2] = dx / length;
+			m_edge_dir[edge * 2 + 1] = dy / length;
+			m_edge_t[edge * 2] = m_edge_dir[edge * 2] * s[0] + m_edge_dir[edge * 2 + 1] * s[1];
+			m_edge_t[edge * 2 + 1] = m_edge_t[edge * 2] + length;
+		}
+	}
+	m_edge_limit = cu.R + 2 * tolerance;
+
+	m_vertex_outside = cu.R + tolerance;
+	m_vertex_flat = (cu.R - cu.r) + tolerance;
+	m_tolerance = tolerance;
+	m_error = NULL;
+}
+
+static void ScalarDropCutterKernel(const Cutter &cu, const GTri &t, const DropCutterTriangle &dt, const double* x, const double* y, double* z, unsigned int n)
+{
+	DropCutterRun<ScalarLanes>(cu, t, dt, x, y, z, n);
+}
+
+#ifdef DROP_CUTTER_SSE2
+// two locations at a time
+class SSE2Lanes
+{
+public:
+	typedef __m128d Real;
+	typedef __m128d Mask;
+	enum{width = 2};
+
+	static Real Set(double d){return _mm_set1_pd(d);}
+	static Real Load(const double* p){return _mm_loadu_pd(p);}
+	static void Store(double* p, Real v){_mm_storeu_pd(p, v);}
+	static Real Add(Real a, Real b){return _mm_add_pd(a, b);}
+	static Real Sub(Real a, Real b){return _mm_sub_pd(a, b);}
+	static Real Mul(Real a, Real b){return _mm_mul_pd(a, b);}
+	static Real Div(Real a, Real b){return _mm_div_pd(a, b);}
+	static Real Sqrt(Real a){return _mm_sqrt_pd(a);}
+	static Mask Greater(Real a, Real b){return _mm_cmpgt_pd(a, b);}
+	static Mask GreaterEqual(Real a, Real b){return _mm_cmpge_pd(a, b);}
+	static Mask LessEqual(Real a, Real b){return _mm_cmple_pd(a, b);}
+	static Mask And(Mask a, Mask b){return _mm_and_pd(a, b);}
+	static Mask Or(Mask a, Mask b){return _mm_or_pd(a, b);}
+	static Mask AndNot(Mask a, Mask b){return _mm_andnot_pd(a, b);}
+	static Real Select(Mask m, Real a, Real b){return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b));}
+	static int Bits(Mask m){return _mm_movemask_pd(m);}
+};
+
+static void SSE2DropCutterKernel(const Cutter &cu, const GTri &t, const DropCutterTriangle &dt, const double* x, const double* y, double* z, unsigned int n)
+{
+	DropCutterRun<SSE2Lanes>(cu, t, dt, x, y, z, n);
+}
+#endif
+
+// true, if the CPU and the operating system can both do AVX
+static bool CPUHasAVX()
+{
+#if defined(_MSC_VER) && _MSC_VER >= 1600 && (defined(_M_X64) || defined(_M_IX86))
+	int info[4];
+	__cpuid(info, 1);
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	return avx && osxsave && ((_xgetbv(0) & 6) == 6);
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx") != 0;
+#else
+	return false;
+#endif
+}
+
+static DropCutterKernel kernel = NULL;
+static const char* kernel_name = NULL;
+
+static void ChooseKernel()
+{
+	if(kernel)return;
+
+	DropCutterKernel avx_kernel = GetAVXDropCutterKernel();
+	if(avx_kernel && CPUHasAVX())
+	{
+		kernel_name = "AVX";
+		kernel = avx_kernel;
+		return;
+	}
+
+#ifdef DROP_CUTTER_SSE2
+	kernel_name = "SSE2";
+	kernel = SSE2DropCutterKernel;
+#else
+	kernel_name = "none";
+	kernel = ScalarDropCutterKernel;
+#endif
+}
+
+// static
+void DropCutterBatch::TriTest(const Cutter &cu, const GTri &t, const double* x, const double* y, double* z, unsigned int n)
+{
+	DropCutterTriangle dt(cu, t, heeksCAD->GetTolerance());
+	TriTest(cu, t, dt, x, y, z, n);
+	if(dt.m_error)wxMessageBox(Ctt(dt.m_error));
+}
+
+// static
+void DropCutterBatch::TriTest(const Cutter &cu, const GTri &t, const DropCutterTriangle &dt, const double* x, const double* y, double* z, unsigned int n)
+{
+	ChooseKernel();
+	(*kernel)(cu, t, dt, x, y, z, n);
+}
+
+// static
+const char* DropCutterBatch::GetInstructionSet()
+{
+	ChooseKernel();
+	return kernel_name;
+}
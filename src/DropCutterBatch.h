@@ -0,0 +1,50 @@
+// DropCutterBatch.h
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+// Drops a cutter onto one triangle at many locations at once, for making height maps.
+// It gives the same heights as DropCutter::TriTest, but the terms which only depend on the triangle and the cutter are worked out once,
+// and the locations are tested several at a time, with AVX or SSE2, if the CPU has them.
+
+#pragma once
+
+class Cutter;
+class GTri;
+
+// the terms of DropCutter's tests which don't depend on where the cutter is
+class DropCutterTriangle
+{
+public:
+	int m_facet; // 0 - the facet can't touch the cutter, 1 - it is horizontal, 2 - it is sloping
+	double m_nd_c, m_a, m_b, m_c; // the facet's plane, with its normal pointing up; m_nd_c is -d/c
+	double m_k1, m_k2; // (R-r)/tan(theta) and r/sin(theta), for the facet's height
+	double m_off[2]; // from the cutter location to the facet contact point, in xy
+	double m_right[6]; // for each of the isright tests in DropCutter::isinside, a2 and -a1
+	double m_edge_normal[6]; // for each edge, a unit normal in xy, for skipping the edges which are too far away to touch
+	double m_edge_d[3]; // for each edge, its distance from the origin along its normal
+	double m_edge_dir[6]; // for each edge, a unit vector along it in xy
+	double m_edge_t[6]; // for each edge, the distances of its ends along m_edge_dir
+	bool m_edge_skip[3]; // false for edges too short to have a normal; these are always tested
+	double m_edge_limit; // edges further from the cutter location than this can't touch it
+	double m_vertex_outside; // R + tolerance
+	double m_vertex_flat; // (R-r) + tolerance
+	double m_tolerance; // for DropCutter::EdgeTest, which mustn't ask heeksCAD for it on other threads
+	mutable const char* m_error; // the last error from DropCutter::EdgeTest, to be shown on the main thread
+
+	DropCutterTriangle(const Cutter &cu, const GTri &t, double tolerance);
+};
+
+// one for each instruction set
+typedef void (*DropCutterKernel)(const Cutter &cu, const GTri &t, const DropCutterTriangle &dt, const double* x, const double* y, double* z, unsigned int n);
+
+class DropCutterBatch
+{
+public:
+	// for each of the n locations, z = DropCutter::TriTest(cu, location, t, z)
+	static void TriTest(const Cutter &cu, const GTri &t, const double* x, const double* y, double* z, unsigned int n);
+	static void TriTest(const Cutter &cu, const GTri &t, const DropCutterTriangle &dt, const double* x, const double* y, double* z, unsigned int n); // for when dt is kept for several calls
+
+	static const char* GetInstructionSet(); // the one chosen for this CPU
+};
+
+DropCutterKernel GetAVXDropCutterKernel(); // returns NULL, if AVX wasn't available to the compiler
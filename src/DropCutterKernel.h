@@ -0,0 +1,163 @@
+// DropCutterKernel.h
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+// The body of DropCutterBatch's kernels, written once for any number of lanes.
+// L is a class of static functions on L::Real, some cutter locations' values, and L::Mask, a flag for each of them.
+// Each operation is done in the same order as in DropCutter, so the heights come out the same.
+// Only include this in DropCutterBatch.cpp and the files for other instruction sets.
+
+#pragma once
+
+#include <math.h>
+
+#include "DropCutter.h"
+#include "GTri.h"
+#include "DropCutterBatch.h"
+
+// everything here is in an unnamed namespace, so the copies built for each instruction set are kept apart,
+// and the linker can't call an AVX one from a CPU without AVX
+namespace
+{
+
+// one location at a time; used for the locations left over at the end
+class ScalarLanes
+{
+public:
+	typedef double Real;
+	typedef bool Mask;
+	enum{width = 1};
+
+	static Real Set(double d){return d;}
+	static Real Load(const double* p){return *p;}
+	static void Store(double* p, Real v){*p = v;}
+	static Real Add(Real a, Real b){return a + b;}
+	static Real Sub(Real a, Real b){return a - b;}
+	static Real Mul(Real a, Real b){return a * b;}
+	static Real Div(Real a, Real b){return a / b;}
+	static Real Sqrt(Real a){return sqrt(a);}
+	static Mask Greater(Real a, Real b){return a > b;}
+	static Mask GreaterEqual(Real a, Real b){return a >= b;}
+	static Mask LessEqual(Real a, Real b){return a <= b;}
+	static Mask And(Mask a, Mask b){return a && b;}
+	static Mask Or(Mask a, Mask b){return a || b;}
+	static Mask AndNot(Mask a, Mask b){return !a && b;}
+	static Real Select(Mask m, Real a, Real b){return m ? a : b;}
+	static int Bits(Mask m){return m ? 1 : 0;}
+};
+
+// makes best into v, where v is higher, like "if(temp_z > z)z = temp_z;"
+template<class L> inline typename L::Real DropCutterRaise(typename L::Real best, typename L::Real v)
+{
+	return L::Select(L::Greater(v, best), v, best);
+}
+
+// DropCutter::isright
+template<class L> inline typename L::Mask DropCutterIsRight(const double* right, const double* p1, typename L::Real px, typename L::Real py)
+{
+	typename L::Real t = L::Add(L::Mul(L::Set(right[0]), L::Sub(px, L::Set(p1[0]))), L::Mul(L::Set(right[1]), L::Sub(py, L::Set(p1[1]))));
+	return L::Greater(t, L::Set(0.00000000000001));
+}
+
+// DropCutter::isinside; all is a mask with every location that matters
+template<class L> inline typename L::Mask DropCutterIsInside(const GTri &t, const DropCutterTriangle &dt, typename L::Real px, typename L::Real py, typename L::Mask all)
+{
+	typename L::Mask b1 = DropCutterIsRight<L>(&dt.m_right[0], &t.m_p[0], px, py);
+	typename L::Mask b2 = DropCutterIsRight<L>(&dt.m_right[2], &t.m_p[6], px, py);
+	typename L::Mask b3 = DropCutterIsRight<L>(&dt.m_right[4], &t.m_p[3], px, py);
+	return L::Or(L::And(b1, L::And(b2, b3)), L::AndNot(L::Or(b1, L::Or(b2, b3)), all));
+}
+
+// DropCutter::VertexTest
+template<class L> inline typename L::Real DropCutterVertex(const Cutter &cu, const DropCutterTriangle &dt, const double* p, typename L::Real ex, typename L::Real ey)
+{
+	typename L::Real dx = L::Sub(ex, L::Set(p[0]));
+	typename L::Real dy = L::Sub(ey, L::Set(p[1]));
+	typename L::Real q = L::Sqrt(L::Add(L::Mul(dx, dx), L::Mul(dy, dy)));
+
+	// the toroidal part of the cutter
+	typename L::Real R = L::Set(cu.R);
+	typename L::Real qr = L::Select(L::Greater(q, R), R, q);
+	typename L::Real s = L::Sub(qr, L::Set(cu.R - cu.r));
+	typename L::Real h2 = L::Sqrt(L::Sub(L::Set(cu.r * cu.r), L::Mul(s, s)));
+	typename L::Real h1 = L::Sub(L::Set(cu.r), h2);
+	typename L::Real z = L::Sub(L::Set(p[2]), h1);
+
+	z = L::Select(L::LessEqual(q, L::Set(dt.m_vertex_flat)), L::Set(p[2]), z);
+	return L::Select(L::Greater(q, L::Set(dt.m_vertex_outside)), L::Set(-10000000.0), z);
+}
+
+// does DropCutter::TriTest for L::width locations
+template<class L> inline void DropCutterLanes(const Cutter &cu, const GTri &t, const DropCutterTriangle &dt, const double* x, const double* y, double* z)
+{
+	typename L::Real ex = L::Load(x);
+	typename L::Real ey = L::Load(y);
+	typename L::Real R = L::Set(cu.R);
+
+	// the locations near enough to the triangle's box
+	typename L::Mask in = L::And(
+		L::And(L::GreaterEqual(L::Add(ex, R), L::Set(t.m_box[0])), L::GreaterEqual(L::Add(ey, R), L::Set(t.m_box[1]))),
+		L::And(L::LessEqual(L::Sub(ex, R), L::Set(t.m_box[2])), L::LessEqual(L::Sub(ey, R), L::Set(t.m_box[3]))));
+	if(L::Bits(in) == 0)return;
+
+	typename L::Real z0 = L::Load(z);
+	typename L::Real best = z0;
+	typename L::Real miss = L::Set(-10000000.0);
+
+	// FacetTest
+	if(dt.m_facet == 1)
+	{
+		best = DropCutterRaise<L>(best, L::Select(DropCutterIsInside<L>(t, dt, ex, ey, in), L::Set(t.m_p[2]), miss));
+	}
+	else if(dt.m_facet == 2)
+	{
+		typename L::Real s = L::Div(L::Add(L::Mul(L::Set(dt.m_a), ex), L::Mul(L::Set(dt.m_b), ey)), L::Set(dt.m_c));
+		typename L::Real zf = L::Sub(L::Add(L::Add(L::Sub(L::Set(dt.m_nd_c), s), L::Set(dt.m_k1)), L::Set(dt.m_k2)), L::Set(cu.r));
+		typename L::Real ccx = L::Sub(ex, L::Set(dt.m_off[0]));
+		typename L::Real ccy = L::Sub(ey, L::Set(dt.m_off[1]));
+		best = DropCutterRaise<L>(best, L::Select(DropCutterIsInside<L>(t, dt, ccx, ccy, in), zf, miss));
+	}
+
+	// VertexTest for each corner
+	best = DropCutterRaise<L>(best, DropCutterVertex<L>(cu, dt, &t.m_p[0], ex, ey));
+	best = DropCutterRaise<L>(best, DropCutterVertex<L>(cu, dt, &t.m_p[3], ex, ey));
+	best = DropCutterRaise<L>(best, DropCutterVertex<L>(cu, dt, &t.m_p[6], ex, ey));
+
+	L::Store(z, L::Select(in, best, z0));
+
+	// EdgeTest for each edge; these are done one location at a time, but only where the edge is near enough to touch
+	for(int edge = 0; edge < 3; edge++)
+	{
+		// the edge can only touch the cutter if the cutter is within its radius of the edge's line, and not beyond its ends
+		typename L::Mask near_edge = in;
+		if(dt.m_edge_skip[edge])
+		{
+			typename L::Real dist = L::Sub(L::Add(L::Mul(L::Set(dt.m_edge_normal[edge * 2]), ex), L::Mul(L::Set(dt.m_edge_normal[edge * 2 + 1]), ey)), L::Set(dt.m_edge_d[edge]));
+			near_edge = L::And(near_edge, L::And(L::LessEqual(dist, L::Set(dt.m_edge_limit)), L::GreaterEqual(dist, L::Set(-dt.m_edge_limit))));
+			typename L::Real along = L::Add(L::Mul(L::Set(dt.m_edge_dir[edge * 2]), ex), L::Mul(L::Set(dt.m_edge_dir[edge * 2 + 1]), ey));
+			near_edge = L::And(near_edge, L::And(L::GreaterEqual(along, L::Set(dt.m_edge_t[edge * 2] - dt.m_edge_limit)), L::LessEqual(along, L::Set(dt.m_edge_t[edge * 2 + 1] + dt.m_edge_limit))));
+		}
+		int bits = L::Bits(near_edge);
+		if(bits == 0)continue;
+
+		const double* p1 = &t.m_p[edge * 3];
+		const double* p2 = &t.m_p[((edge + 1) % 3) * 3];
+		for(int i = 0; i < L::width; i++)
+		{
+			if((bits & (1 << i)) == 0)continue;
+			double e[3] = {x[i], y[i], 0.0};
+			double temp_z = DropCutter::EdgeTest(cu, e, p1, p2, dt.m_tolerance, dt.m_error);
+			if(temp_z > z[i])z[i] = temp_z;
+		}
+	}
+}
+
+// does DropCutter::TriTest for n locations, L::width at a time
+template<class L> void DropCutterRun(const Cutter &cu, const GTri &t, const DropCutterTriangle &dt, const double* x, const double* y, double* z, unsigned int n)
+{
+	unsigned int i = 0;
+	for(; i + L::width <= n; i += L::width)DropCutterLanes<L>(cu, t, dt, x + i, y + i, z + i);
+	for(; i < n; i++)DropCutterLanes<ScalarLanes>(cu, t, dt, x + i, y + i, z + i);
+}
+
+} // namespace
@@ -0,0 +1,354 @@
+// DropCutterTool.cpp
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+// It is built into the nc_attach library too, so it only includes its own headers, not stdafx.h or CTool.h.
+
+#include "DropCutterTool.h"
+#include "GTri.h"
+#include "GTriGrid.h"
+
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Each shape class describes the tool's surface, with its tip at z = 0.
+// m_R is the tool's radius
+// Height(rho) is the height of the surface at a distance rho from the axis, which is no more than m_R; it only ever gets steeper going out
+// FacetRadius(g) is how far from the axis the tool touches a plane which rises g for each unit across
+// EdgeContact(m, l, lo, hi) is where the tool touches a line which rises m for each unit along it, l from the axis in xy;
+// it is the distance along the line, from the point nearest the axis, between lo and hi, where the line is highest above the tool
+
+class FlatShape
+{
+public:
+	double m_R;
+
+	FlatShape(double R):m_R(R){}
+
+	double Height(double rho)const{return 0.0;}
+	double FacetRadius(double g)const{return m_R;}
+	double EdgeContact(double m, double l, double lo, double hi)const
+	{
+		return (m > 0.0) ? hi : lo; // a flat line touches all along
+	}
+};
+
+class BallShape
+{
+public:
+	double m_R;
+
+	BallShape(double R):m_R(R){}
+
+	double Height(double rho)const
+	{
+		double h2 = m_R * m_R - rho * rho;
+		return m_R - ((h2 > 0.0) ? sqrt(h2) : 0.0);
+	}
+
+	double FacetRadius(double g)const{return m_R * g / sqrt(1.0 + g * g);}
+
+	double EdgeContact(double m, double l, double lo, double hi)const
+	{
+		// the line is in a plane which cuts the sphere in a circle, where the line touches it
+		double w2 = m_R * m_R - l * l;
+		double s = m * ((w2 > 0.0) ? sqrt(w2) : 0.0) / sqrt(1.0 + m * m);
+		if(s < lo)return lo;
+		if(s > hi)return hi;
+		return s;
+	}
+};
+
+class BullShape
+{
+	double m_r; // corner radius
+	double m_flat; // R - r
+
+	// how fast the tool's surface rises, along a line l from the axis, s along it
+	double Slope(double l, double s)const
+	{
+		double rho = sqrt(l * l + s * s);
+		double d = rho - m_flat;
+		if(d <= 0.0)return 0.0;
+		double q = m_r * m_r - d * d;
+		if(q <= 0.0)return (s > 0.0) ? 1.0e100 : -1.0e100;
+		return d / sqrt(q) * s / rho;
+	}
+
+public:
+	double m_R;
+
+	BullShape(double R, double r):m_r(r), m_flat(R - r), m_R(R){}
+
+	double Height(double rho)const
+	{
+		double d = rho - m_flat;
+		if(d <= 0.0)return 0.0;
+		double h2 = m_r * m_r - d * d;
+		return m_r - ((h2 > 0.0) ? sqrt(h2) : 0.0);
+	}
+
+	double FacetRadius(double g)const{return m_flat + m_r * g / sqrt(1.0 + g * g);}
+
+	double EdgeContact(double m, double l, double lo, double hi)const
+	{
+		if(m == 0.0)
+		{
+			if(lo > 0.0)return lo;
+			if(hi < 0.0)return hi;
+			return 0.0;
+		}
+
+		// the line rises as fast as the torus somewhere past the flat bottom, so search there
+		double f2 = m_flat * m_flat - l * l;
+		double s_flat = (f2 > 0.0) ? sqrt(f2) : 0.0;
+		double a, b;
+		if(m > 0.0)
+		{
+			a = (lo > s_flat) ? lo : s_flat;
+			b = hi;
+			if(a >= b)return hi;
+		}
+		else
+		{
+			a = lo;
+			b = (hi < -s_flat) ? hi : -s_flat;
+			if(a >= b)return lo;
+		}
+
+		// m - Slope only ever goes down as s goes up
+		if(m - Slope(l, a) <= 0.0)return a;
+		if(m - Slope(l, b) >= 0.0)return b;
+		double limit = m_R * 0.000000000001;
+		while(b - a > limit)
+		{
+			double mid = (a + b) * 0.5;
+			if(mid <= a || mid >= b)break;
+			if(m - Slope(l, mid) > 0.0)a = mid;
+			else b = mid;
+		}
+		return (a + b) * 0.5;
+	}
+};
+
+class ConeShape
+{
+	double m_flat; // the radius of the flat bottom
+	double m_tan; // tan of half of the angle at the tip
+
+public:
+	double m_R;
+
+	ConeShape(double R, double flat, double half_angle):m_flat(flat), m_tan(tan(half_angle)), m_R(R)
+	{
+		if(m_tan < 0.000001)m_tan = 0.000001;
+		if(m_flat > m_R)m_flat = m_R;
+	}
+
+	double Height(double rho)const{return (rho > m_flat) ? (rho - m_flat) / m_tan : 0.0;}
+
+	// touches at the edge of the flat bottom, unless the plane is steeper than the cone
+	double FacetRadius(double g)const{return (g * m_tan > 1.0) ? m_R : m_flat;}
+
+	double EdgeContact(double m, double l, double lo, double hi)const
+	{
+		double k = fabs(m) * m_tan;
+		if(k >= 1.0)return (m > 0.0) ? hi : lo; // the line is steeper than the cone
+
+		double s = 0.0;
+		if(m != 0.0)
+		{
+			// the cut of the cone by the line's plane is a hyperbola, where the line touches it
+			s = l * k / sqrt(1.0 - k * k);
+			double f2 = m_flat * m_flat - l * l;
+			if(s * s < f2)s = sqrt(f2); // or at the edge of the flat bottom
+			if(m < 0.0)s = -s;
+		}
+		if(s < lo)return lo;
+		if(s > hi)return hi;
+		return s;
+	}
+};
+
+// like DropCutter::isinside, which isn't used, so the nc_attach library doesn't need DropCutter.cpp
+static bool IsInside(const GTri &t, const double *p)
+{
+	int right = 0;
+	for(int i = 0; i < 3; i++)
+	{
+		const double* p1 = &t.m_p[i * 3];
+		const double* p2 = &t.m_p[((i + 1) % 3) * 3];
+		if((p2[1] - p1[1]) * (p[0] - p1[0]) - (p2[0] - p1[0]) * (p[1] - p1[1]) > 0.00000000000001)right++;
+	}
+	return right == 0 || right == 3;
+}
+
+template<class Shape> double ShapeVertexTest(const Shape &shape, const double *e, const double *p)
+{
+	double dx = p[0] - e[0];
+	double dy = p[1] - e[1];
+	double q = sqrt(dx * dx + dy * dy);
+	if(q > shape.m_R)return -10000000.0;
+	return p[2] - shape.Height(q);
+}
+
+template<class Shape> double ShapeFacetTest(const Shape &shape, const double *e, const GTri &t)
+{
+	double n[3] = {t.m_n[0], t.m_n[1], t.m_n[2]};
+	if(fabs(n[2]) < 0.000000000001)return -10000000.0; // vertical plane
+	if(n[2] < 0)
+	{
+		for(int i = 0; i<3; i++)n[i] = -1*n[i];
+	}
+
+	// the height of the plane at the cutter location
+	double z = t.m_p[2] - (n[0] * (e[0] - t.m_p[0]) + n[1] * (e[1] - t.m_p[1])) / n[2];
+
+	double cc[3] = {e[0], e[1], 0.0};
+	double ab = sqrt(n[0] * n[0] + n[1] * n[1]);
+	if(ab > 0.000000000001)
+	{
+		// the tool touches uphill of its axis
+		double g = ab / n[2];
+		double rho = shape.FacetRadius(g);
+		cc[0] -= rho * n[0] / ab;
+		cc[1] -= rho * n[1] / ab;
+		z += rho * g - shape.Height(rho);
+	}
+
+	if(IsInside(t, cc))return z;
+	return -10000000.0;
+}
+
+template<class Shape> double ShapeEdgeTest(const Shape &shape, const double *e, const double *p1, const double *p2)
+{
+	double dx = p2[0] - p1[0];
+	double dy = p2[1] - p1[1];
+	double length = sqrt(dx * dx + dy * dy);
+	if(length < 0.000000000001)return -10000000.0; // a vertical edge; the vertex tests find where it touches
+
+	double ux = dx / length;
+	double uy = dy / length;
+	double vx = p1[0] - e[0];
+	double vy = p1[1] - e[1];
+	double l = fabs(ux * vy - uy * vx); // distance from cutter to edge
+	if(l > shape.m_R)return -10000000.0;
+
+	// distances along the edge, from the point nearest the cutter
+	double w = sqrt(shape.m_R * shape.m_R - l * l);
+	double s1 = ux * vx + uy * vy;
+	double lo = (s1 > -w) ? s1 : -w;
+	double hi = (s1 + length < w) ? s1 + length : w;
+	if(lo > hi)return -10000000.0;
+
+	double m = (p2[2] - p1[2]) / length;
+	double s = shape.EdgeContact(m, l, lo, hi);
+	double rho = sqrt(l * l + s * s);
+	if(rho > shape.m_R)rho = shape.m_R;
+	return p1[2] + m * (s - s1) - shape.Height(rho);
+}
+
+template<class Shape> double ShapeTriTest(const Shape &shape, const double *e, const GTri &t, double minz)
+{
+	if(e[0] + shape.m_R < t.m_box[0])return minz;
+	if(e[1] + shape.m_R < t.m_box[1])return minz;
+	if(e[0] - shape.m_R > t.m_box[2])return minz;
+	if(e[1] - shape.m_R > t.m_box[3])return minz;
+
+	double z = minz;
+
+	double temp_z;
+	temp_z = ShapeFacetTest(shape, e, t);
+	if(temp_z > z)z = temp_z;
+	temp_z = ShapeEdgeTest(shape, e, &(t.m_p[0]), &(t.m_p[3]));
+	if(temp_z > z)z = temp_z;
+	temp_z = ShapeEdgeTest(shape, e, &(t.m_p[3]), &(t.m_p[6]));
+	if(temp_z > z)z = temp_z;
+	temp_z = ShapeEdgeTest(shape, e, &(t.m_p[6]), &(t.m_p[0]));
+	if(temp_z > z)z = temp_z;
+	temp_z = ShapeVertexTest(shape, e, &(t.m_p[0]));
+	if(temp_z > z)z = temp_z;
+	temp_z = ShapeVertexTest(shape, e, &(t.m_p[3]));
+	if(temp_z > z)z = temp_z;
+	temp_z = ShapeVertexTest(shape, e, &(t.m_p[6]));
+	if(temp_z > z)z = temp_z;
+
+	return z;
+}
+
+template<class Shape> class ShapeDropCutterTool : public DropCutterTool
+{
+	Shape m_shape;
+
+public:
+	ShapeDropCutterTool(const Shape &shape):m_shape(shape){}
+
+	double GetRadius()const{return m_shape.m_R;}
+
+	double TriTest(const double *e, const GTri &t, double minz)const
+	{
+		return ShapeTriTest(m_shape, e, t, minz);
+	}
+
+	double TriTest(const double *e, const GTriGrid &grid, double minz)const
+	{
+		double box[4] = {e[0] - m_shape.m_R, e[1] - m_shape.m_R, e[0] + m_shape.m_R, e[1] + m_shape.m_R};
+		int x0, y0, x1, y1;
+		if(!grid.GetCells(box, x0, y0, x1, y1))return minz;
+
+		double z = minz;
+		for(int y = y0; y <= y1; y++)
+		{
+			for(int x = x0; x <= x1; x++)
+			{
+				for(const unsigned int* It = grid.CellBegin(x, y); It != grid.CellEnd(x, y); It++)
+				{
+					const GTri& tri = grid.m_tris[*It];
+					if(!grid.FirstCell(tri, box, x, y))continue; // it has been tested already
+					z = ShapeTriTest(m_shape, e, tri, z);
+				}
+			}
+		}
+
+		return z;
+	}
+
+	void TriTest(const GTri &t, const double* x, const double* y, double* z, unsigned int n)const
+	{
+		for(unsigned int i = 0; i < n; i++)
+		{
+			double e[2] = {x[i], y[i]};
+			z[i] = ShapeTriTest(m_shape, e, t, z[i]);
+		}
+	}
+};
+
+// static
+DropCutterTool* DropCutterTool::New(int type, double diameter, double corner_radius, double flat_radius, double cutting_edge_angle, double allowance)
+{
+	// the same families as CTool::OCLDefinition
+	double R = diameter / 2 + allowance;
+	if(R <= 0.0)R = 0.000001;
+
+	switch(type)
+	{
+	case DropCutterBallEndMill:
+		return new ShapeDropCutterTool<BallShape>(BallShape(R));
+
+	case DropCutterChamfer:
+	case DropCutterEngravingTool:
+		return new ShapeDropCutterTool<ConeShape>(ConeShape(R, flat_radius + allowance, cutting_edge_angle * M_PI/180));
+
+	default:
+		if(corner_radius > 0.000000001)
+		{
+			double r = corner_radius + allowance;
+			if(r > R)r = R;
+			return new ShapeDropCutterTool<BullShape>(BullShape(R, r));
+		}
+		return new ShapeDropCutterTool<FlatShape>(FlatShape(R));
+	}
+}
@@ -0,0 +1,42 @@
+// DropCutterTool.h
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+// Drops the shape of a CTool onto triangles.
+// There is a version of the tests for each family of tool; flat end, ball end, bull nose, and cone ( chamfer and engraving tools ).
+// The family is chosen once, by New, so the tests don't have to keep checking which family the tool is.
+// Unlike DropCutter's edge test, which is only an approximation for a bull nose cutter, the tests are exact for every family.
+
+#pragma once
+
+class CTool;
+class GTri;
+class GTriGrid;
+
+// the CToolParams::eToolType values with their own shapes, for New; CTool.cpp checks they match
+enum
+{
+	DropCutterBallEndMill = 4,
+	DropCutterChamfer = 5,
+	DropCutterEngravingTool = 6
+};
+
+class DropCutterTool
+{
+public:
+	virtual ~DropCutterTool(){}
+
+	virtual double GetRadius()const = 0;
+
+	// the height of the tool's tip, where it touches, or minz, if that is higher
+	virtual double TriTest(const double *e, const GTri &t, double minz)const = 0;
+	virtual double TriTest(const double *e, const GTriGrid &grid, double minz)const = 0;
+
+	// for each of the n locations, z = TriTest(location, t, z)
+	virtual void TriTest(const GTri &t, const double* x, const double* y, double* z, unsigned int n)const = 0;
+
+	// makes one for the tool's shape, made bigger all round by allowance; delete it when finished with
+	static DropCutterTool* New(const CTool* tool, double allowance = 0.0); // in CTool.cpp, so the nc_attach library doesn't need CTool
+	// cutting_edge_angle is in degrees, between the tool's axis and its cutting edge, so it is half of the angle at the tip, like in CTool::GetShape
+	static DropCutterTool* New(int type, double diameter, double corner_radius, double flat_radius, double cutting_edge_angle, double allowance = 0.0); // type is a CToolParams::eToolType
+};
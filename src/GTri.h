@@ -1,5 +1,10 @@
 // GTri.h
 
+#pragma once
+
+#include <string.h>
+#include <math.h>
+
 // triangle used for Anders's DropCutter code
 // written by Dan Heeks starting on May 2nd 2008
 
@@ -42,18 +47,18 @@ public:
 		if(m_p[7] > m_box[3])m_box[3] = m_p[7];
 	}
 
-	static bool box_in_box(double *this_box, double *box){
-		if(this_box[0]<box[0]-heeksCAD->GetTolerance()){
+	static bool box_in_box(double *this_box, double *box, double tolerance){
+		if(this_box[0]<box[0]-tolerance){
 			// left of tri is left of box
-			if(this_box[2]<box[0]-heeksCAD->GetTolerance()){
+			if(this_box[2]<box[0]-tolerance){
 				// right of tri is left of box
 				return false;
 			}
-			else if(this_box[2]<box[2] + heeksCAD->GetTolerance()){
+			else if(this_box[2]<box[2] + tolerance){
 				// right of tri is in box
-				if(this_box[1]<box[1]-heeksCAD->GetTolerance()){
+				if(this_box[1]<box[1]-tolerance){
 					// bottom of tri is below box
-					if(this_box[3]<box[1]-heeksCAD->GetTolerance()){
+					if(this_box[3]<box[1]-tolerance){
 						// top of tri is below of box
 						return false;
 					}
@@ -62,7 +67,7 @@ public:
 						return true;
 					}
 				}
-				else if(this_box[1]<box[3]+heeksCAD->GetTolerance()){
+				else if(this_box[1]<box[3]+tolerance){
 					// bottom of tri is in box
 					return true;
 				}
@@ -73,7 +78,7 @@ public:
 			}
 			else{
 				// right of tri is right of box
-				if(this_box[1]>box[1]-heeksCAD->GetTolerance() && this_box[3]<box[3]+heeksCAD->GetTolerance()){
+				if(this_box[1]>box[1]-tolerance && this_box[3]<box[3]+tolerance){
 					// top and bottom within box
 					return true;
 				}
@@ -82,11 +87,11 @@ public:
 				}
 			}
 		}
-		else if(this_box[0]<box[2]+heeksCAD->GetTolerance()){
+		else if(this_box[0]<box[2]+tolerance){
 			// left of tri is within box
-			if(this_box[1]<box[1]-heeksCAD->GetTolerance()){
+			if(this_box[1]<box[1]-tolerance){
 				// bottom of tri is below box
-				if(this_box[3]<box[1]-heeksCAD->GetTolerance()){
+				if(this_box[3]<box[1]-tolerance){
 					// top of tri is below of box
 					return false;
 				}
@@ -95,7 +100,7 @@ public:
 					return true;
 				}
 			}
-			else if(this_box[1]<box[3]+heeksCAD->GetTolerance()){
+			else if(this_box[1]<box[3]+tolerance){
 				// bottom of tri is in box
 				return true;
 			}
@@ -0,0 +1,119 @@
+// GTriGrid.cpp
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+// It is built into the nc_attach library too, so it doesn't include stdafx.h.
+
+#include "GTriGrid.h"
+
+#include <math.h>
+
+// the grid isn't allowed more cells than this, however small the triangles are
+static const double max_cells = 16777216.0;
+
+GTriGrid::GTriGrid():m_cell_size(1.0), m_num_x(0), m_num_y(0)
+{
+	m_box[0] = m_box[1] = m_box[2] = m_box[3] = 0.0;
+}
+
+void GTriGrid::Clear()
+{
+	m_tris.clear();
+	m_cell_first.clear();
+	m_cell_tris.clear();
+	m_num_x = m_num_y = 0;
+}
+
+int GTriGrid::CellX(double x)const
+{
+	int i = (int)floor((x - m_box[0]) / m_cell_size);
+	if(i < 0)return 0;
+	if(i >= m_num_x)return m_num_x - 1;
+	return i;
+}
+
+int GTriGrid::CellY(double y)const
+{
+	int j = (int)floor((y - m_box[1]) / m_cell_size);
+	if(j < 0)return 0;
+	if(j >= m_num_y)return m_num_y - 1;
+	return j;
+}
+
+void GTriGrid::Build(double cell_size)
+{
+	m_cell_first.clear();
+	m_cell_tris.clear();
+	m_num_x = m_num_y = 0;
+	if(m_tris.size() == 0)return;
+
+	m_box[0] = m_box[2] = m_tris[0].m_box[0];
+	m_box[1] = m_box[3] = m_tris[0].m_box[1];
+	double total_size = 0.0;
+	for(std::vector<GTri>::iterator It = m_tris.begin(); It != m_tris.end(); It++)
+	{
+		GTri &t = *It;
+		if(t.m_box[0] < m_box[0])m_box[0] = t.m_box[0];
+		if(t.m_box[1] < m_box[1])m_box[1] = t.m_box[1];
+		if(t.m_box[2] > m_box[2])m_box[2] = t.m_box[2];
+		if(t.m_box[3] > m_box[3])m_box[3] = t.m_box[3];
+		total_size += (t.m_box[2] - t.m_box[0]) + (t.m_box[3] - t.m_box[1]);
+	}
+	double width = m_box[2] - m_box[0];
+	double height = m_box[3] - m_box[1];
+
+	if(cell_size <= 0.0)
+	{
+		// about the size of a triangle, so each triangle is in a few cells and each cell has a few triangles
+		cell_size = total_size / (2 * m_tris.size());
+	}
+	if(cell_size <= 0.0)cell_size = 1.0;
+	while((floor(width / cell_size) + 1) * (floor(height / cell_size) + 1) > max_cells)cell_size *= 2;
+	m_cell_size = cell_size;
+	m_num_x = (int)floor(width / cell_size) + 1;
+	m_num_y = (int)floor(height / cell_size) + 1;
+
+	// count the triangles in each cell, then put them in, like a counting sort
+	m_cell_first.resize(m_num_x * m_num_y + 1, 0);
+	for(std::vector<GTri>::iterator It = m_tris.begin(); It != m_tris.end(); It++)
+	{
+		GTri &t = *It;
+		int x0 = CellX(t.m_box[0]), y0 = CellY(t.m_box[1]), x1 = CellX(t.m_box[2]), y1 = CellY(t.m_box[3]);
+		for(int y = y0; y <= y1; y++)
+		{
+			for(int x = x0; x <= x1; x++)m_cell_first[y * m_num_x + x + 1]++;
+		}
+	}
+	for(unsigned int i = 1; i < m_cell_first.size(); i++)m_cell_first[i] += m_cell_first[i - 1];
+
+	m_cell_tris.resize(m_cell_first.back());
+	std::vector<unsigned int> next(m_cell_first.begin(), m_cell_first.end() - 1);
+	for(unsigned int i = 0; i < m_tris.size(); i++)
+	{
+		GTri &t = m_tris[i];
+		int x0 = CellX(t.m_box[0]), y0 = CellY(t.m_box[1]), x1 = CellX(t.m_box[2]), y1 = CellY(t.m_box[3]);
+		for(int y = y0; y <= y1; y++)
+		{
+			for(int x = x0; x <= x1; x++)m_cell_tris[next[y * m_num_x + x]++] = i;
+		}
+	}
+}
+
+bool GTriGrid::GetCells(const double* box, int &x0, int &y0, int &x1, int &y1)const
+{
+	if(m_num_x == 0 || m_cell_tris.size() == 0)return false;
+	if(box[2] < m_box[0] || box[3] < m_box[1] || box[0] > m_box[2] || box[1] > m_box[3])return false;
+	x0 = CellX(box[0]);
+	y0 = CellY(box[1]);
+	x1 = CellX(box[2]);
+	y1 = CellY(box[3]);
+	return true;
+}
+
+bool GTriGrid::FirstCell(const GTri &t, const double* box, int x, int y)const
+{
+	// the first cell is the one with the bottom left corner of the overlap of the boxes
+	double cx = (t.m_box[0] > box[0]) ? t.m_box[0] : box[0];
+	double cy = (t.m_box[1] > box[1]) ? t.m_box[1] : box[1];
+	return CellX(cx) == x && CellY(cy) == y;
+}
@@ -0,0 +1,41 @@
+// GTriGrid.h
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+// The triangles for DropCutter, in one vector, with a grid of buckets over their xy boxes.
+// Each cell of the grid has the triangles whose boxes overlap it, so a drop only has to test the triangles near the cutter.
+
+#pragma once
+
+#include "GTri.h"
+
+#include <vector>
+
+class GTriGrid
+{
+	double m_box[4]; // minx miny maxx maxy, of all the triangles
+	double m_cell_size;
+	int m_num_x, m_num_y;
+	std::vector<unsigned int> m_cell_first; // for each cell, the start of its triangles in m_cell_tris, and one more at the end
+	std::vector<unsigned int> m_cell_tris; // indexes into m_tris
+
+	int CellX(double x)const; // clamped to the grid
+	int CellY(double y)const;
+
+public:
+	std::vector<GTri> m_tris;
+
+	GTriGrid();
+
+	void Clear();
+	void Build(double cell_size = 0.0); // call after filling m_tris; a cell size of 0 chooses one from the triangles
+	bool Built()const{return m_num_x > 0;}
+
+	// finds the cells overlapping box ( minx miny maxx maxy ); returns false if there are none
+	bool GetCells(const double* box, int &x0, int &y0, int &x1, int &y1)const;
+	const unsigned int* CellBegin(int x, int y)const{return &m_cell_tris[0] + m_cell_first[y * m_num_x + x];}
+	const unsigned int* CellEnd(int x, int y)const{return &m_cell_tris[0] + m_cell_first[y * m_num_x + x + 1];}
+
+	// a triangle can be in several of the cells overlapping a box; this is only true for the first of them
+	bool FirstCell(const GTri &t, const double* box, int x, int y)const;
+};
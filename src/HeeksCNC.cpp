@@ -38,6 +38,7 @@
 #include "CNCPoint.h"
 #include "Excellon.h"
 #include "Tags.h"
+#include "MeshCache.h"
 #include "Tag.h"
 #include "ScriptOp.h"
 #include "Simulate.h"
@@ -80,6 +81,8 @@ void CHeeksCNCApp::OnDestroyDLL()
 	// save any settings
 	//config.Write("SolidSimWorkingDir", m_working_dir_for_solid_sim);
 
+	MeshCache::Clear();
+
 #if !defined WXUSINGDLL
 	wxUninitialize();
 #endif
@@ -450,19 +453,15 @@ void CHeeksCNCApp::RunPythonScript()
 	}
 
 	// Check to see if someone has modified the contents of the
-	// program canvas manually.  If so, replace the m_python_program
-	// with the edited program.  We don't want to do this without
-	// this check since the maximum size of m_textCtrl is sometimes
-	// a limitation to the size of the python program.  If the first 'n' characters
-	// of m_python_program matches the full contents of the m_textCtrl then
-	// it's likely that the text control holds as much of the python program
-	// as it can hold but more may still exist in m_python_program.
-	unsigned int text_control_length = m_program_canvas->m_textCtrl->GetLastPosition();
-	if (m_program->m_python_program.substr(0,text_control_length) != m_program_canvas->m_textCtrl->GetValue())
+	// program canvas manually.  If so, write the edited program
+	// over the one RewritePythonProgram wrote.
+	if (m_program_canvas->Edited())
 	{
-		// copy the contents of the program canvas to the string
-		m_program->m_python_program.clear();
-		m_program->m_python_program << theApp.m_program_canvas->m_textCtrl->GetValue();
+		if(!m_program_canvas->WriteProgram(m_program->GetPythonFilePath()))
+		{
+			wxMessageBox(wxString(_("couldn't write")) + _T(" ") + m_program->GetPythonFilePath());
+			return;
+		}
 	}
 
 #ifdef FREE_VERSION
@@ -480,7 +479,7 @@ static void RunScriptMenuCallback(wxCommandEvent &event)
 static void PostProcessMenuCallback(wxCommandEvent &event)
 {
 	// write the python program
-	theApp.m_program->RewritePythonProgram();
+	if(!theApp.m_program->RewritePythonProgram())return;
 
 	// run it
 	theApp.RunPythonScript();
@@ -530,7 +529,7 @@ static void OpenNcFileMenuCallback(wxCommandEvent& event)
 
 static void SendToMachineMenuCallback(wxCommandEvent& event)
 {
-	HeeksSendToMachine(theApp.m_output_canvas->m_textCtrl->GetValue());
+	HeeksSendToMachine(theApp.m_output_canvas->GetText());
 }
 
 static void SaveNcFileMenuCallback(wxCommandEvent& event)
@@ -570,20 +569,14 @@ static void SaveNcFileMenuCallback(wxCommandEvent& event)
 				return;
 			}
 
+			// the nc code, with any edits the user has made in the output window
+			wxString text = theApp.m_output_canvas->GetText();
 			if(theApp.m_use_DOS_not_Unix == true)   //DF -added to get DOS line endings HeeksCNC running on Unix 
 			{
-				long line_num= 0;
-				bool ok = true;
-				int nLines = theApp.m_output_canvas->m_textCtrl->GetNumberOfLines();
-				for ( int nLine = 0; ok && nLine < nLines; nLine ++)
-				{   
-					ok = ofs.Write(theApp.m_output_canvas->m_textCtrl->GetLineText(line_num) + _T("\r\n") );
-					line_num = line_num+1;
-				}
+				text.Replace(_T("\n"), _T("\r\n"));
 			}
 
-			else
-				ofs.Write(theApp.m_output_canvas->m_textCtrl->GetValue());
+			ofs.Write(text);
 		}
 		HeeksPyBackplot(theApp.m_program, theApp.m_program, nc_file_str);
 	}
@@ -911,6 +904,8 @@ class HeeksCADObserver: public Observer
 
 		void OnChanged(const std::list<HeeksObj*>* added, const std::list<HeeksObj*>* removed, const std::list<HeeksObj*>* modified)
 		{
+			MeshCache::OnChanged(removed, modified);
+
 			if(added)
 			{
 				for(std::list<HeeksObj*>::const_iterator It = added->begin(); It != added->end(); It++)
@@ -1161,6 +1156,11 @@ void CHeeksCNCApp::OnStartUp(CHeeksCADInterface* h, const wxString& dll_path)
 	CSendToMachine::ReadFromConfig();
 	config.Read(_T("UseClipperNotBoolean"), &m_use_Clipper_not_Boolean, false);
 	config.Read(_T("UseDOSNotUnix"), &m_use_DOS_not_Unix, false);
+	config.Read(_T("UseBuiltInNCReader"), &m_use_builtin_nc_reader, true);
+	config.Read(_T("UsePythonWorker"), &m_use_python_worker, true);
+	config.Read(_T("UseOpCache"), &m_use_op_cache, true);
+	config.Read(_T("KeepOpCacheWithFile"), &m_keep_op_cache_with_file, false);
+	config.Read(_T("OpCacheParallel"), &m_op_cache_parallel, false);
 	aui_manager->GetPane(m_program_canvas).Show(program_visible);
 	aui_manager->GetPane(m_output_canvas).Show(output_visible);
 	aui_manager->GetPane(m_print_canvas).Show(print_visible);
@@ -1282,6 +1282,8 @@ std::list<wxString> CHeeksCNCApp::GetFileNames( const char *p_szRoot ) const
 
 void CHeeksCNCApp::OnNewOrOpen(bool open, int res)
 {
+	MeshCache::Clear();
+
 	// check for existance of a program
 
 	bool program_found = false;
@@ -1319,6 +1321,32 @@ void on_set_use_DOS(bool value, HeeksObj* object)
 	theApp.m_use_DOS_not_Unix = value;
 }
 
+void on_set_use_builtin_nc_reader(bool value, HeeksObj* object)
+{
+	theApp.m_use_builtin_nc_reader = value;
+}
+
+void on_set_use_python_worker(bool value, HeeksObj* object)
+{
+	theApp.m_use_python_worker = value;
+	if(!value)HeeksPyStopWorker();
+}
+
+void on_set_use_op_cache(bool value, HeeksObj* object)
+{
+	theApp.m_use_op_cache = value;
+}
+
+void on_set_keep_op_cache_with_file(bool value, HeeksObj* object)
+{
+	theApp.m_keep_op_cache_with_file = value;
+}
+
+void on_set_op_cache_parallel(bool value, HeeksObj* object)
+{
+	theApp.m_op_cache_parallel = value;
+}
+
 void CHeeksCNCApp::GetOptions(std::list<Property *> *list){
 	PropertyList* machining_options = new PropertyList(_("machining options"));
 	CNCCode::GetOptions(&(machining_options->m_list));
@@ -1328,6 +1356,11 @@ void CHeeksCNCApp::GetOptions(std::list<Property *> *list){
 	CSendToMachine::GetOptions(&(machining_options->m_list));
 	machining_options->m_list.push_back ( new PropertyCheck ( _("Use Clipper not Boolean"), m_use_Clipper_not_Boolean, NULL, on_set_use_clipper ) );
 	machining_options->m_list.push_back ( new PropertyCheck ( _("Use DOS Line Endings"), m_use_DOS_not_Unix, NULL, on_set_use_DOS ) );
+	machining_options->m_list.push_back ( new PropertyCheck ( _("Use built-in ISO NC code reader"), m_use_builtin_nc_reader, NULL, on_set_use_builtin_nc_reader ) );
+	machining_options->m_list.push_back ( new PropertyCheck ( _("Keep python running between post-processes"), m_use_python_worker, NULL, on_set_use_python_worker ) );
+	machining_options->m_list.push_back ( new PropertyCheck ( _("Only post-process the operations which have changed"), m_use_op_cache, NULL, on_set_use_op_cache ) );
+	machining_options->m_list.push_back ( new PropertyCheck ( _("Keep the operations' NC code with the file"), m_keep_op_cache_with_file, NULL, on_set_keep_op_cache_with_file ) );
+	machining_options->m_list.push_back ( new PropertyCheck ( _("Post-process the changed operations at the same time"), m_op_cache_parallel, NULL, on_set_op_cache_parallel ) );
 
 	list->push_back(machining_options);
 
@@ -1352,6 +1385,13 @@ void CHeeksCNCApp::OnFrameDelete()
 	CSendToMachine::WriteToConfig();
 	config.Write(_T("UseClipperNotBoolean"), m_use_Clipper_not_Boolean);
 	config.Write(_T("UseDOSNotUnix"), m_use_DOS_not_Unix);
+	config.Write(_T("UseBuiltInNCReader"), m_use_builtin_nc_reader);
+	config.Write(_T("UsePythonWorker"), m_use_python_worker);
+	config.Write(_T("UseOpCache"), m_use_op_cache);
+	config.Write(_T("KeepOpCacheWithFile"), m_keep_op_cache_with_file);
+	config.Write(_T("OpCacheParallel"), m_op_cache_parallel);
+
+	HeeksPyStopWorker();
 }
 
 Python CHeeksCNCApp::SetTool( const int new_tool )
@@ -1370,7 +1410,7 @@ Python CHeeksCNCApp::SetTool( const int new_tool )
 
 		if(m_attached_to_surface)
 		{
-			python << _T("nc.creator.set_ocl_cutter(") << pTool->OCLDefinition(m_attached_to_surface) << _T(")\n");
+			python << _T("nc.creator.set_tool(") << (int)(pTool->m_params.m_type) << _T(", ") << pTool->m_params.m_diameter << _T(", ") << pTool->m_params.m_corner_radius << _T(", ") << pTool->m_params.m_flat_radius << _T(", ") << pTool->m_params.m_cutting_edge_angle << _T(")\n");
 		}
 	} // End if - then
 
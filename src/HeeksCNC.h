@@ -39,6 +39,11 @@ public:
 	std::set<int> m_external_op_types;
 	bool m_use_Clipper_not_Boolean;
 	bool m_use_DOS_not_Unix;
+	bool m_use_builtin_nc_reader; // use CNCReader, not the python reader, for ISO NC code
+	bool m_use_python_worker; // keep python running, to run the post-processing scripts, see CPyWorker
+	bool m_use_op_cache; // only run the operations which have changed, see OpCache
+	bool m_keep_op_cache_with_file; // keep the operations' NC code next to the .heeks file, so it is there when the file is opened again
+	bool m_op_cache_parallel; // run the operations at the same time, in their own pythons, before the program, see OpCache::Job
 
 	CSurface* m_attached_to_surface;
     int         m_tool_number;
@@ -90,7 +90,7 @@ void CHeeksCNCInterface::SetProcessRedirect(bool redirect)
 void CHeeksCNCInterface::PostProcess()
 {
 	// write the python program
-	theApp.m_program->RewritePythonProgram();
+	if(!theApp.m_program->RewritePythonProgram())return;
 
 	// run it
 	theApp.RunPythonScript();
@@ -0,0 +1,27 @@
+// MappedFile.h
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+// Maps a whole file into memory, read only, for as long as the object exists.
+
+#pragma once
+
+class CMappedFile
+{
+	const char* m_data;
+	size_t m_size;
+#ifdef WIN32
+	void* m_file;
+	void* m_mapping;
+#else
+	int m_file;
+#endif
+
+public:
+	CMappedFile(const wxString& file_path);
+	~CMappedFile();
+
+	bool IsOpened()const{return m_data != NULL;}
+	const char* GetData()const{return m_data;}
+	size_t GetSize()const{return m_size;}
+};
@@ -0,0 +1,229 @@
+// MeshCache.cpp
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+#include "stdafx.h"
+#include "MeshCache.h"
+#include "OpCache.h"
+#include "GTri.h"
+
+#include <wx/stdpaths.h>
+#include <wx/filename.h>
+#include <wx/file.h>
+
+class CachedMesh
+{
+public:
+	std::list<int> m_solids;
+	std::vector<HeeksObj*> m_objects; // the solids, when the mesh was made
+	double m_tolerance;
+	std::vector<GTri> m_tris;
+	wxUint64 m_hash;
+	wxString m_stl_filepath; // empty until it is written
+	bool m_stl_binary;
+
+	CachedMesh():m_tolerance(0.0), m_hash(0), m_stl_binary(false){}
+
+	~CachedMesh()
+	{
+		if(m_stl_filepath.Len() > 0)wxRemoveFile(m_stl_filepath);
+	}
+
+	bool Uses(int id)const
+	{
+		for(std::list<int>::const_iterator It = m_solids.begin(); It != m_solids.end(); It++)
+		{
+			if(*It == id)return true;
+		}
+		return false;
+	}
+};
+
+static std::list<CachedMesh*> meshes;
+static int number_for_stl_file = 1;
+
+static void GetSolids(const std::list<int> &solids, std::vector<HeeksObj*> &objects)
+{
+	for(std::list<int>::const_iterator It = solids.begin(); It != solids.end(); It++)
+	{
+		HeeksObj* object = heeksCAD->GetIDObject(SolidType, *It);
+		if(object != NULL)objects.push_back(object);
+	}
+}
+
+static std::vector<GTri>* tris_for_callback = NULL;
+
+static void callback_for_triangles(const double* x, const double* n)
+{
+	tris_for_callback->push_back(GTri(x));
+}
+
+static CachedMesh* GetMesh(const std::list<int> &solids, double tolerance)
+{
+	std::vector<HeeksObj*> objects;
+	GetSolids(solids, objects);
+
+	for(std::list<CachedMesh*>::iterator It = meshes.begin(); It != meshes.end();)
+	{
+		CachedMesh* mesh = *It;
+		if(mesh->m_solids == solids)
+		{
+			if(mesh->m_tolerance == tolerance && mesh->m_objects == objects)return mesh;
+
+			// the surface's tolerance has changed, or its solids have been replaced, so the mesh won't be used again
+			delete mesh;
+			It = meshes.erase(It);
+		}
+		else It++;
+	}
+
+	CachedMesh* mesh = new CachedMesh;
+	mesh->m_solids = solids;
+	mesh->m_objects = objects;
+	mesh->m_tolerance = tolerance;
+	tris_for_callback = &mesh->m_tris;
+	for(std::vector<HeeksObj*>::iterator It = objects.begin(); It != objects.end(); It++)
+	{
+		HeeksObj* object = *It;
+		object->GetTriangles(callback_for_triangles, tolerance);
+	}
+	tris_for_callback = NULL;
+	mesh->m_hash = OpCache::Hash(NULL, 0);
+	for(std::vector<GTri>::const_iterator It = mesh->m_tris.begin(); It != mesh->m_tris.end(); It++)
+	{
+		mesh->m_hash = OpCache::Hash(It->m_p, sizeof(It->m_p), mesh->m_hash);
+	}
+	meshes.push_back(mesh);
+	return mesh;
+}
+
+// static
+wxUint64 MeshCache::GetHash(const std::list<int> &solids, double tolerance)
+{
+	return GetMesh(solids, tolerance)->m_hash;
+}
+
+static void AddSTLLong(std::vector<unsigned char> &buffer, unsigned int i)
+{
+	// STL files are little endian
+	buffer.push_back((unsigned char)(i & 0xff));
+	buffer.push_back((unsigned char)((i >> 8) & 0xff));
+	buffer.push_back((unsigned char)((i >> 16) & 0xff));
+	buffer.push_back((unsigned char)((i >> 24) & 0xff));
+}
+
+static void AddSTLFloat(std::vector<unsigned char> &buffer, double d)
+{
+	float f = (float)d;
+	unsigned int i;
+	memcpy(&i, &f, 4);
+	AddSTLLong(buffer, i);
+}
+
+static void AddSTLText(std::vector<unsigned char> &buffer, const char* format, const double* values)
+{
+	char text[128];
+	sprintf(text, format, values[0], values[1], values[2]);
+	buffer.insert(buffer.end(), text, text + strlen(text));
+}
+
+static void MakeBinarySTL(const std::vector<GTri> &tris, std::vector<unsigned char> &buffer)
+{
+	buffer.resize(80, 0); // the header
+	buffer.reserve(84 + tris.size() * 50);
+	AddSTLLong(buffer, (unsigned int)tris.size());
+	for(std::vector<GTri>::const_iterator It = tris.begin(); It != tris.end(); It++)
+	{
+		const GTri &t = *It;
+		for(int i = 0; i < 3; i++)AddSTLFloat(buffer, t.m_n[i]);
+		for(int i = 0; i < 9; i++)AddSTLFloat(buffer, t.m_p[i]);
+		buffer.push_back(0);
+		buffer.push_back(0);
+	}
+}
+
+static void MakeASCIISTL(const std::vector<GTri> &tris, std::vector<unsigned char> &buffer)
+{
+	const char* solid = "solid\n";
+	buffer.insert(buffer.end(), solid, solid + strlen(solid));
+	for(std::vector<GTri>::const_iterator It = tris.begin(); It != tris.end(); It++)
+	{
+		const GTri &t = *It;
+		AddSTLText(buffer, " facet normal %.9g %.9g %.9g\n  outer loop\n", t.m_n);
+		for(int i = 0; i < 3; i++)AddSTLText(buffer, "   vertex %.9g %.9g %.9g\n", &t.m_p[i * 3]);
+		const char* end = "  endloop\n endfacet\n";
+		buffer.insert(buffer.end(), end, end + strlen(end));
+	}
+	const char* end = "endsolid\n";
+	buffer.insert(buffer.end(), end, end + strlen(end));
+}
+
+// static
+wxString MeshCache::GetSTLFile(const std::list<int> &solids, double tolerance, bool binary)
+{
+	CachedMesh* mesh = GetMesh(solids, tolerance);
+	if(mesh->m_stl_filepath.Len() > 0)
+	{
+		if(mesh->m_stl_binary == binary && wxFileExists(mesh->m_stl_filepath))return mesh->m_stl_filepath;
+		wxRemoveFile(mesh->m_stl_filepath);
+		mesh->m_stl_filepath.Clear();
+	}
+
+#if wxCHECK_VERSION(3, 0, 0)
+	wxStandardPaths& standard_paths = wxStandardPaths::Get();
+#else
+	wxStandardPaths standard_paths;
+#endif
+	wxFileName filepath(standard_paths.GetTempDir().c_str(), wxString::Format(_T("surface%d.stl"), number_for_stl_file).c_str());
+	number_for_stl_file++;
+
+	// the whole file is made in memory, then written at once
+	std::vector<unsigned char> buffer;
+	if(binary)MakeBinarySTL(mesh->m_tris, buffer);
+	else MakeASCIISTL(mesh->m_tris, buffer);
+
+	wxFile file(filepath.GetFullPath(), wxFile::write);
+	if(file.IsOpened() && file.Write(&buffer[0], buffer.size()) == buffer.size())
+	{
+		mesh->m_stl_filepath = filepath.GetFullPath();
+		mesh->m_stl_binary = binary;
+	}
+
+	return filepath.GetFullPath();
+}
+
+// static
+void MeshCache::OnChanged(const std::list<HeeksObj*>* removed, const std::list<HeeksObj*>* modified)
+{
+	const std::list<HeeksObj*>* lists[2] = {removed, modified};
+	for(int i = 0; i < 2; i++)
+	{
+		if(lists[i] == NULL)continue;
+		for(std::list<HeeksObj*>::const_iterator It = lists[i]->begin(); It != lists[i]->end(); It++)
+		{
+			HeeksObj* object = *It;
+			if(object->GetType() != SolidType)continue;
+
+			for(std::list<CachedMesh*>::iterator MeshIt = meshes.begin(); MeshIt != meshes.end();)
+			{
+				CachedMesh* mesh = *MeshIt;
+				if(mesh->Uses(object->GetID()))
+				{
+					delete mesh;
+					MeshIt = meshes.erase(MeshIt);
+				}
+				else MeshIt++;
+			}
+		}
+	}
+}
+
+// static
+void MeshCache::Clear()
+{
+	for(std::list<CachedMesh*>::iterator It = meshes.begin(); It != meshes.end(); It++)
+	{
+		delete *It;
+	}
+	meshes.clear();
+}
@@ -0,0 +1,21 @@
+// MeshCache.h
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+// The triangles of the solids of surfaces, kept from one post-process to the next.
+// A mesh is found by its solids' ids and its tolerance. It is thrown away when one of its solids is changed or removed,
+// when the id finds a different object, or when the same solids are asked for with a different tolerance,
+// so the triangles are only made again when they need to be. For the python, they are written once to an STL file; a binary one for
+// the nc_attach library, or an ASCII one, which is all OpenCAMLib's STLReader can read, for when nc/attach.py has to use OpenCAMLib.
+
+#pragma once
+
+class MeshCache
+{
+public:
+	static wxString GetSTLFile(const std::list<int> &solids, double tolerance, bool binary); // the file is kept until the mesh is thrown away
+	static wxUint64 GetHash(const std::list<int> &solids, double tolerance); // of the triangles, for the keys of OpCache
+
+	static void OnChanged(const std::list<HeeksObj*>* removed, const std::list<HeeksObj*>* modified);
+	static void Clear();
+};
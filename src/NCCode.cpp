@@ -14,10 +14,14 @@
 #include "interface/PropertyColor.h"
 #include "interface/PropertyList.h"
 #include "interface/PropertyInt.h"
+#include "interface/PropertyDouble.h"
 #include "interface/Tool.h"
 #include "CNCConfig.h"
 #include "CTool.h"
 #include "Program.h"
+#include "PathRenderer.h"
+#include "PathTree.h"
+#include "MappedFile.h"
 
 #include <TopoDS_Shape.hxx>
 #include <TopoDS_Solid.hxx>
@@ -31,102 +35,142 @@
 #include "tinyxml/tinyxml.h"
 
 #include <wx/progdlg.h>
+#include <wx/thread.h>
 
 #include <memory>
 #include <sstream>
 
+double CNCCode::s_arc_chord_tolerance = 0.5;
 int CNCCode::s_arc_interpolation_count = 20;
 
-void ColouredText::WriteXML(TiXmlNode *root)
+void TextStore::Clear()
 {
-	TiXmlElement * element;
-	element = heeksCAD->NewXMLElement( "text" );
-	heeksCAD->LinkXMLEndChild( root,  element );
+	m_arena.clear();
+	m_offset.clear();
+	m_length.clear();
+	m_color.clear();
+}
 
-	// add actual text as a child object
-   	TiXmlText* text = heeksCAD->NewXMLText(m_str.utf8_str());
-   	element->LinkEndChild(text);
+void TextStore::Add(const char* s, unsigned int length, ColorEnum color)
+{
+	m_offset.push_back((unsigned int)m_arena.size());
+	m_length.push_back(length);
+	m_color.push_back((unsigned char)color);
+	m_arena.insert(m_arena.end(), s, s + length);
+}
 
-	if(m_color_type != ColorDefaultType)element->SetAttribute( "col", CNCCode::GetColor(m_color_type));
+void TextStore::Append(const TextStore &store)
+{
+	unsigned int arena_offset = (unsigned int)m_arena.size();
+	m_arena.insert(m_arena.end(), store.m_arena.begin(), store.m_arena.end());
+	m_offset.reserve(m_offset.size() + store.size());
+	for(std::vector<unsigned int>::const_iterator It = store.m_offset.begin(); It != store.m_offset.end(); It++)
+	{
+		m_offset.push_back(*It + arena_offset);
+	}
+	m_length.insert(m_length.end(), store.m_length.begin(), store.m_length.end());
+	m_color.insert(m_color.end(), store.m_color.begin(), store.m_color.end());
 }
 
-void ColouredText::ReadFromXMLElement(TiXmlElement* element)
+wxString TextStore::GetString(unsigned int i)const
 {
-	m_color_type = CNCCode::GetColor(element->Attribute("col"));
+	return wxString(GetText(i), wxConvUTF8, m_length[i]);
+}
 
-	// get the text
-	const char* text = element->GetText();
-	if(text)m_str = wxString(Ctt(text));
+void TextStore::AppendString(unsigned int first, unsigned int count, wxString& str)const
+{
+	// the tokens are put together before converting, so there is only one conversion
+	std::string bytes;
+	for(unsigned int i = first; i < first + count; i++)bytes.append(GetText(i), m_length[i]);
+	str.append(wxString(bytes.c_str(), wxConvUTF8, bytes.size()));
 }
 
-// static
-double PathObject::m_current_x[3] = {0, 0, 0};
-double PathObject::m_prev_x[3] = {0, 0, 0};
+long TextStore::GetNumChars(unsigned int first, unsigned int count)const
+{
+	long num_chars = 0;
+	for(unsigned int i = first; i < first + count; i++)
+	{
+		const char* s = GetText(i);
+		for(unsigned int j = 0; j < m_length[i]; j++)
+		{
+			// count every byte, except UTF-8 continuation bytes
+			if((s[j] & 0xc0) != 0x80)num_chars++;
+		}
+	}
+	return num_chars;
+}
 
-void PathObject::WriteBaseXML(TiXmlElement *pElem)
+void TextStore::WriteXML(TiXmlNode *root, unsigned int first, unsigned int count)const
 {
-	pElem->SetAttribute("tool_number", m_tool_number);
+	for(unsigned int i = first; i < first + count; i++)
+	{
+		TiXmlElement * element;
+		element = heeksCAD->NewXMLElement( "text" );
+		heeksCAD->LinkXMLEndChild( root,  element );
 
-	pElem->SetDoubleAttribute("x", m_x[0]);
-	pElem->SetDoubleAttribute("y", m_x[1]);
-	pElem->SetDoubleAttribute("z", m_x[2]);
+		// add actual text as a child object
+		std::string str(GetText(i), m_length[i]);
+		TiXmlText* text = heeksCAD->NewXMLText(str.c_str());
+		element->LinkEndChild(text);
 
-} // End WriteXML() method
+		if(GetColor(i) != ColorDefaultType)element->SetAttribute( "col", CNCCode::GetColor(GetColor(i)));
+	}
+}
 
-void PathObject::ReadFromXMLElement(TiXmlElement* pElem)
+void TextStore::ReadTextFromXMLElement(TiXmlElement* element)
 {
-	memcpy(m_prev_x, m_current_x, 3*sizeof(double));
+	ColorEnum color = CNCCode::GetColor(element->Attribute("col"));
 
-	double x;
-	if(pElem->Attribute("x", &x))m_current_x[0] = x * CNCCodeBlock::multiplier;
-	if(pElem->Attribute("y", &x))m_current_x[1] = x * CNCCodeBlock::multiplier;
-	if(pElem->Attribute("z", &x))m_current_x[2] = x * CNCCodeBlock::multiplier;
+	// get the text; tinyxml keeps it as UTF-8
+	const char* text = element->GetText();
+	Add(text ? text : "", text ? (unsigned int)strlen(text) : 0, color);
+}
+
+// static
+void PathObject::ReadFromXMLElement(TiXmlElement* pElem, int &tool_number, CNCReadContext &context)
+{
+	memcpy(context.m_prev_x, context.m_current_x, 3*sizeof(double));
 
-	memcpy(m_x, m_current_x, 3*sizeof(double));
+	double x;
+	if(pElem->Attribute("x", &x))context.m_current_x[0] = x * context.m_multiplier;
+	if(pElem->Attribute("y", &x))context.m_current_x[1] = x * context.m_multiplier;
+	if(pElem->Attribute("z", &x))context.m_current_x[2] = x * context.m_multiplier;
 
 	if (pElem->Attribute("tool_number"))
 	{
-		pElem->Attribute("tool_number", &m_tool_number);
+		pElem->Attribute("tool_number", &tool_number);
 	} // End if - then
 	else
 	{
-		m_tool_number = 0;	// No tool selected.
+		tool_number = 0;	// No tool selected.
 	} // End if - else
 }
 
-void PathLine::WriteXML(TiXmlNode *root)
-{
-	TiXmlElement * element;
-	element = heeksCAD->NewXMLElement( "line" );
-	heeksCAD->LinkXMLEndChild( root,  element );
-
-	PathObject::WriteBaseXML(element);
-}
-
-void PathLine::ReadFromXMLElement(TiXmlElement* pElem)
-{
-	PathObject::ReadFromXMLElement(pElem);
-}
-
-void PathLine::glVertices(const PathObject* prev_po)
-{
-	if(prev_po)glVertex3dv(prev_po->m_x);
-	glVertex3dv(m_x);
-}
-
 void PathArc::GetBox(CBox &box,const PathObject* prev_po)
 {
-	PathObject::GetBox(box,prev_po);
+	box.Insert(m_x);
 
-	if(IsIncluded(gp_Pnt(0,1,0),prev_po))
-		box.Insert(prev_po->m_x[0]+m_c[0],prev_po->m_x[1]+m_c[1]+m_radius,0);
-	if(IsIncluded(gp_Pnt(0,-1,0),prev_po))
-		box.Insert(prev_po->m_x[0]+m_c[0],prev_po->m_x[1]+m_c[1]-m_radius,0);
-	if(IsIncluded(gp_Pnt(1,0,0),prev_po))
-		box.Insert(prev_po->m_x[0]+m_c[0]+m_radius,prev_po->m_x[1]+m_c[1],0);
-	if(IsIncluded(gp_Pnt(-1,0,0),prev_po))
-		box.Insert(prev_po->m_x[0]+m_c[0]-m_radius,prev_po->m_x[1]+m_c[1],0);
+	// the angles are worked out once, for all four of the arc's possible extreme points
+	double start_angle, end_angle, rs, re;
+	GetAngles(prev_po, start_angle, end_angle, rs, re);
+	m_radius = rs;
+	bool full_circle = (start_angle == end_angle);
+	if(m_dir != 1)
+	{
+		double a = start_angle;
+		start_angle = end_angle;
+		end_angle = a;
+	}
 
+	double cx = prev_po->m_x[0] + m_c[0];
+	double cy = prev_po->m_x[1] + m_c[1];
+	for(int i = 0; i < 4; i++)
+	{
+		double the_angle = i * M_PI / 2 - 2 * M_PI;
+		while(the_angle < start_angle)the_angle += 2 * M_PI;
+		if(!full_circle && the_angle > end_angle)continue;
+		box.Insert(cx + ((i == 0) ? m_radius : ((i == 2) ? -m_radius : 0.0)), cy + ((i == 1) ? m_radius : ((i == 3) ? -m_radius : 0.0)), m_x[2]);
+	}
 }
 
 bool PathArc::IsIncluded(gp_Pnt pnt,const PathObject* prev_po)
@@ -161,54 +205,10 @@ bool PathArc::IsIncluded(gp_Pnt pnt,const PathObject* prev_po)
 	return (the_angle >= start_angle && the_angle <= end_angle) || (the_angle2 >= start_angle && the_angle2 <= end_angle);
 }
 
-void PathArc::WriteXML(TiXmlNode *root)
-{
-	TiXmlElement * element = heeksCAD->NewXMLElement( "arc" );
-	heeksCAD->LinkXMLEndChild( root,  element );
-
-	element->SetDoubleAttribute( "i", m_c[0]);
-	element->SetDoubleAttribute( "j", m_c[1]);
-	element->SetDoubleAttribute( "k", m_c[2]);
-	element->SetDoubleAttribute( "d", m_dir);
-
-	PathObject::WriteBaseXML(element);
-}
-
-void PathArc::ReadFromXMLElement(TiXmlElement* pElem)
-{
-	// get the attributes
-	bool radius_set = false;
-	if (pElem->Attribute("r"))
-	{
-		pElem->Attribute("r", &m_radius);
-		m_radius *= CNCCodeBlock::multiplier;
-		radius_set = true;
-	}
-	else
-	{
-		if (pElem->Attribute("i")) pElem->Attribute("i", &m_c[0]);
-		if (pElem->Attribute("j")) pElem->Attribute("j", &m_c[1]);
-		if (pElem->Attribute("k")) pElem->Attribute("k", &m_c[2]);
-		if (pElem->Attribute("d")) pElem->Attribute("d", &m_dir);
-
-		m_c[0] *= CNCCodeBlock::multiplier;
-		m_c[1] *= CNCCodeBlock::multiplier;
-		m_c[2] *= CNCCodeBlock::multiplier;
-	}
-
-	PathObject::ReadFromXMLElement(pElem);
-
-	if(radius_set)
-	{
-		// set ij and direction from radius
-		SetFromRadius();
-	}
-}
-
-void PathArc::SetFromRadius()
+void PathArc::SetFromRadius(const double* start)
 {
 	// make a circle at start point and end point
-	gp_Pnt ps(m_prev_x[0], m_prev_x[1], m_prev_x[2]);
+	gp_Pnt ps(start[0], start[1], start[2]);
 	gp_Pnt pe(m_x[0], m_x[1], m_x[2]);
 	double r = fabs(m_radius);
 	gp_Circ c1(gp_Ax2(ps, gp_Dir(0, 0, 1)), r);
@@ -237,32 +237,18 @@ void PathArc::SetFromRadius()
 	}
 }
 
-void PathArc::glVertices(const PathObject* prev_po)
+void PathArc::GetAngles(const PathObject *prev_po, double &start_angle, double &end_angle, double &rs, double &re) const
 {
-	if (prev_po == NULL) return;
-
-	std::list<gp_Pnt> vertices = Interpolate( prev_po, CNCCode::s_arc_interpolation_count );
-	glVertex3dv(prev_po->m_x);
-	for (std::list<gp_Pnt>::const_iterator l_itVertex = vertices.begin(); l_itVertex != vertices.end(); l_itVertex++)
-	{
-		glVertex3d(l_itVertex->X(), l_itVertex->Y(), l_itVertex->Z());
-	} // End for
-}
-
-std::list<gp_Pnt> PathArc::Interpolate( const PathObject *prev_po, const unsigned int number_of_points ) const
-{
-	std::list<gp_Pnt> points;
-
 	double sx = -m_c[0];
 	double sy = -m_c[1];
 	// e = cs + se = -c + e - s
 	double ex = -m_c[0] + m_x[0] - prev_po->m_x[0];
 	double ey = -m_c[1] + m_x[1] - prev_po->m_x[1];
-	double rs = sqrt(sx * sx + sy * sy);
-	double re = sqrt(ex * ex + ey * ey);
+	rs = sqrt(sx * sx + sy * sy);
+	re = sqrt(ex * ex + ey * ey);
 
-	double start_angle = atan2(sy, sx);
-	double end_angle = atan2(ey, ex);
+	start_angle = atan2(sy, sx);
+	end_angle = atan2(ey, ex);
 
 	if(m_dir == 1){
 		if(end_angle < start_angle)end_angle += 6.283185307179;
@@ -270,6 +256,33 @@ std::list<gp_Pnt> PathArc::Interpolate( const PathObject *prev_po, const unsigne
 	else{
 		if(start_angle < end_angle)start_angle += 6.283185307179;
 	}
+}
+
+unsigned int PathArc::GetNumberOfSegments( const PathObject *prev_po, double tolerance ) const
+{
+	double start_angle, end_angle, rs, re;
+	GetAngles(prev_po, start_angle, end_angle, rs, re);
+	double sweep = (start_angle == end_angle) ? (2 * M_PI) : fabs(end_angle - start_angle);
+	double r = (rs > re) ? rs : re;
+
+	if(tolerance <= 0.0)return (CNCCode::s_arc_interpolation_count > 0) ? CNCCode::s_arc_interpolation_count : 1;
+
+	// the largest angle for which the middle of the chord is within tolerance of the arc
+	if(r <= tolerance)return (start_angle == end_angle) ? 4 : 1;
+	double max_angle = 2 * acos(1 - tolerance / r);
+	double number_of_segments = ceil(sweep / max_angle);
+	if(number_of_segments < 1)number_of_segments = 1;
+	if(start_angle == end_angle && number_of_segments < 4)number_of_segments = 4;
+	if(number_of_segments > 4096)number_of_segments = 4096;
+	return (unsigned int)number_of_segments;
+}
+
+std::list<gp_Pnt> PathArc::Interpolate( const PathObject *prev_po, const unsigned int number_of_points ) const
+{
+	std::list<gp_Pnt> points;
+
+	double start_angle, end_angle, rs, re;
+	GetAngles(prev_po, start_angle, end_angle, rs, re);
 
 	double angle_step = 0;
 
@@ -304,75 +317,209 @@ std::list<gp_Pnt> PathArc::Interpolate( const PathObject *prev_po, const unsigne
 	return(points);
 }
 
-ColouredPath::ColouredPath(const ColouredPath& c)
+void PathStore::Clear()
 {
-	operator=(c);
+	m_type.clear();
+	m_color.clear();
+	m_tool_number.clear();
+	m_block.clear();
+	m_arc.clear();
+	m_x.clear();
+	m_arc_c.clear();
+	m_arc_dir.clear();
+	ClearArcVertices();
 }
 
-const ColouredPath &ColouredPath::operator=(const ColouredPath& c)
+void PathStore::ClearArcVertices()const
 {
-	Clear();
-	m_color_type = c.m_color_type;
-	for(std::list< PathObject* >::const_iterator It = c.m_points.begin(); It != c.m_points.end(); It++)
+	m_arc_first_vertex.clear();
+	m_arc_num_vertices.clear();
+	m_arc_vertices.clear();
+}
+
+bool PathStore::SetArcTolerance(double tolerance)const
+{
+	if(tolerance == m_arc_tolerance)return false;
+	m_arc_tolerance = tolerance;
+	ClearArcVertices();
+	return true;
+}
+
+unsigned int PathStore::GetArcVertices(unsigned int i, const double** vertices)const
+{
+	unsigned int a = m_arc[i];
+	if(a >= m_arc_first_vertex.size())
 	{
-		PathObject* object = *It;
-		m_points.push_back(object->MakeACopy());
+		m_arc_first_vertex.resize(m_arc_dir.size(), 0);
+		m_arc_num_vertices.resize(m_arc_dir.size(), 0);
 	}
-	return *this;
+
+	// tessellate the arc the first time it is needed
+	if(m_arc_num_vertices[a] == 0)
+	{
+		PathObject prev_po;
+		GetPathObject(i - 1, prev_po);
+		PathArc arc;
+		GetArc(i, arc);
+		std::list<gp_Pnt> points = arc.Interpolate( &prev_po, arc.GetNumberOfSegments( &prev_po, m_arc_tolerance ) );
+		points.pop_front(); // the start point
+		m_arc_first_vertex[a] = (unsigned int)(m_arc_vertices.size() / 3);
+		m_arc_num_vertices[a] = (unsigned int)points.size();
+		for(std::list<gp_Pnt>::const_iterator It = points.begin(); It != points.end(); It++)
+		{
+			m_arc_vertices.push_back(It->X());
+			m_arc_vertices.push_back(It->Y());
+			m_arc_vertices.push_back(It->Z());
+		}
+	}
+
+	*vertices = &m_arc_vertices[m_arc_first_vertex[a] * 3];
+	return m_arc_num_vertices[a];
+}
+
+void PathStore::AddLine(const double* x, int tool_number, ColorEnum color, unsigned int block)
+{
+	m_type.push_back((unsigned char)PathObject::eLine);
+	m_color.push_back((unsigned char)color);
+	m_tool_number.push_back(tool_number);
+	m_block.push_back(block);
+	m_arc.push_back(0);
+	m_x.insert(m_x.end(), x, x + 3);
+}
+
+void PathStore::AddArc(const double* x, const double* c, int dir, int tool_number, ColorEnum color, unsigned int block)
+{
+	m_type.push_back((unsigned char)PathObject::eArc);
+	m_color.push_back((unsigned char)color);
+	m_tool_number.push_back(tool_number);
+	m_block.push_back(block);
+	m_arc.push_back((unsigned int)m_arc_dir.size());
+	m_x.insert(m_x.end(), x, x + 3);
+	m_arc_c.insert(m_arc_c.end(), c, c + 3);
+	m_arc_dir.push_back((signed char)dir);
+}
+
+void PathStore::GetPathObject(unsigned int i, PathObject &po)const
+{
+	memcpy(po.m_x, GetEnd(i), 3*sizeof(double));
+	po.m_tool_number = m_tool_number[i];
 }
 
-void ColouredPath::Clear()
+void PathStore::GetLine(unsigned int i, PathLine &line)const
 {
-	for(std::list< PathObject* >::iterator It = m_points.begin(); It != m_points.end(); It++)
+	GetPathObject(i, line);
+}
+
+void PathStore::GetArc(unsigned int i, PathArc &arc)const
+{
+	GetPathObject(i, arc);
+	unsigned int a = m_arc[i];
+	memcpy(arc.m_c, &m_arc_c[a*3], 3*sizeof(double));
+	arc.m_dir = m_arc_dir[a];
+	arc.m_radius = sqrt(arc.m_c[0] * arc.m_c[0] + arc.m_c[1] * arc.m_c[1]);
+}
+
+void PathStore::GetBox(unsigned int first, unsigned int count, CBox &box)const
+{
+	for(unsigned int i = first; i < first + count; i++)
 	{
-		PathObject* object = *It;
-		delete object;
+		if(m_type[i] == PathObject::eArc && i > 0)
+		{
+			PathObject prev_po;
+			GetPathObject(i - 1, prev_po);
+			PathArc arc;
+			GetArc(i, arc);
+			arc.GetBox(box, &prev_po);
+		}
+		else
+		{
+			box.Insert(GetEnd(i));
+		}
 	}
-	m_points.clear();
 }
 
-void ColouredPath::glCommands()
+void PathStore::glVertices(unsigned int i)const
 {
-	CNCCode::Color(m_color_type).glColor();
-	glBegin(GL_LINE_STRIP);
-	for(std::list< PathObject* >::iterator It = m_points.begin(); It != m_points.end(); It++)
+	const double* s = GetStart(i);
+
+	if(m_type[i] == PathObject::eArc)
 	{
-		PathObject* po = *It;
-		po->glVertices(CNCCode::prev_po);
-		CNCCode::prev_po = po;
-	}
-	glEnd();
+		if (s == NULL) return;
 
+		const double* vertices;
+		unsigned int num_vertices = GetArcVertices(i, &vertices);
+		glVertex3dv(s);
+		for(unsigned int v = 0; v < num_vertices; v++)
+		{
+			glVertex3dv(&vertices[v * 3]);
+		}
+	}
+	else
+	{
+		if(s)glVertex3dv(s);
+		glVertex3dv(GetEnd(i));
+	}
 }
 
-void ColouredPath::GetBox(CBox &box)
+void PathStore::glCommands(unsigned int first, unsigned int count)const
 {
-	for(std::list< PathObject* >::iterator It = m_points.begin(); It != m_points.end(); It++)
+	// one line strip for each run of moves of the same colour
+	unsigned int i = first;
+	while(i < first + count)
 	{
-		PathObject* po= *It;
-		po->GetBox(box,CNCCode::prev_po);
-		CNCCode::prev_po = po;
+		ColorEnum color = GetColor(i);
+		CNCCode::Color(color).glColor();
+		glBegin(GL_LINE_STRIP);
+		for(; i < first + count && GetColor(i) == color; i++)
+		{
+			glVertices(i);
+		}
+		glEnd();
 	}
 }
 
-void ColouredPath::WriteXML(TiXmlNode *root)
+void PathStore::WriteXML(TiXmlNode *root, unsigned int first, unsigned int count)const
 {
-	TiXmlElement * element;
-	element = heeksCAD->NewXMLElement( "path" );
-	heeksCAD->LinkXMLEndChild( root,  element );
-
-	element->SetAttribute( "col", CNCCode::GetColor(m_color_type));
-	for(std::list< PathObject* >::iterator It = m_points.begin(); It != m_points.end(); It++)
+	TiXmlElement * path_element = NULL;
+	for(unsigned int i = first; i < first + count; i++)
 	{
-		PathObject* po = *It;
-		po->WriteXML(element);
+		if(path_element == NULL || GetColor(i) != GetColor(i - 1))
+		{
+			path_element = heeksCAD->NewXMLElement( "path" );
+			heeksCAD->LinkXMLEndChild( root,  path_element );
+			path_element->SetAttribute( "col", CNCCode::GetColor(GetColor(i)));
+		}
+
+		TiXmlElement * element;
+		if(m_type[i] == PathObject::eArc)
+		{
+			element = heeksCAD->NewXMLElement( "arc" );
+			heeksCAD->LinkXMLEndChild( path_element,  element );
+
+			unsigned int a = m_arc[i];
+			element->SetDoubleAttribute( "i", m_arc_c[a*3]);
+			element->SetDoubleAttribute( "j", m_arc_c[a*3 + 1]);
+			element->SetDoubleAttribute( "k", m_arc_c[a*3 + 2]);
+			element->SetDoubleAttribute( "d", m_arc_dir[a]);
+		}
+		else
+		{
+			element = heeksCAD->NewXMLElement( "line" );
+			heeksCAD->LinkXMLEndChild( path_element,  element );
+		}
+
+		const double* x = GetEnd(i);
+		element->SetAttribute("tool_number", m_tool_number[i]);
+		element->SetDoubleAttribute("x", x[0]);
+		element->SetDoubleAttribute("y", x[1]);
+		element->SetDoubleAttribute("z", x[2]);
 	}
 }
 
-void ColouredPath::ReadFromXMLElement(TiXmlElement* element)
+void PathStore::ReadPathFromXMLElement(TiXmlElement* element, unsigned int block, CNCReadContext &context)
 {
 	// get the attributes
-	m_color_type = CNCCode::GetColor(element->Attribute("col"), ColorRapidType);
+	ColorEnum color = CNCCode::GetColor(element->Attribute("col"), ColorRapidType);
 
 	// loop through all the objects
 	for(TiXmlElement* pElem = heeksCAD->FirstXMLChildElement( element ) ; pElem; pElem = pElem->NextSiblingElement())
@@ -380,21 +527,46 @@ void ColouredPath::ReadFromXMLElement(TiXmlElement* element)
 		std::string name(pElem->Value());
 		if(name == "line")
 		{
-			PathLine *new_object = new PathLine;
-			new_object->ReadFromXMLElement(pElem);
-			m_points.push_back(new_object);
+			int tool_number;
+			PathObject::ReadFromXMLElement(pElem, tool_number, context);
+			AddLine(context.m_current_x, tool_number, color, block);
 		}
 		else if(name == "arc")
 		{
-			PathArc *new_object = new PathArc;
-			new_object->ReadFromXMLElement(pElem);
-			m_points.push_back(new_object);
+			PathArc arc;
+			bool radius_set = false;
+			if (pElem->Attribute("r"))
+			{
+				pElem->Attribute("r", &arc.m_radius);
+				arc.m_radius *= context.m_multiplier;
+				radius_set = true;
+			}
+			else
+			{
+				if (pElem->Attribute("i")) pElem->Attribute("i", &arc.m_c[0]);
+				if (pElem->Attribute("j")) pElem->Attribute("j", &arc.m_c[1]);
+				if (pElem->Attribute("k")) pElem->Attribute("k", &arc.m_c[2]);
+				if (pElem->Attribute("d")) pElem->Attribute("d", &arc.m_dir);
+
+				arc.m_c[0] *= context.m_multiplier;
+				arc.m_c[1] *= context.m_multiplier;
+				arc.m_c[2] *= context.m_multiplier;
+			}
+
+			PathObject::ReadFromXMLElement(pElem, arc.m_tool_number, context);
+			memcpy(arc.m_x, context.m_current_x, 3*sizeof(double));
+
+			if(radius_set)
+			{
+				// set ij and direction from radius
+				arc.SetFromRadius(context.m_prev_x);
+			}
+
+			AddArc(arc.m_x, arc.m_c, arc.m_dir, arc.m_tool_number, color, block);
 		}
 	}
 }
 
-double CNCCodeBlock::multiplier = 1.0;
-
 HeeksObj *CNCCodeBlock::MakeACopy(void)const{return new CNCCodeBlock(*this);}
 
 void CNCCodeBlock::WriteNCCode(wxTextFile &f, double ox, double oy)
@@ -402,25 +574,24 @@ void CNCCodeBlock::WriteNCCode(wxTextFile &f, double ox, double oy)
 	//TODO: offset is always in millimeters, but this gcode block could be in anything
 	//I used inches, so I hacked it into working.
 	wxString movement;
-	std::list<ColouredText>::iterator it;
-	for(it = m_text.begin(); it != m_text.end(); it++)
+	for(unsigned int i = m_first_token; i < m_first_token + m_num_tokens; i++)
 	{
-		ColouredText ct = *it;
-		switch(ct.m_color_type)
+		switch(m_text_store->GetColor(i))
 		{
 			case ColorPrepType:
-				f.AddLine(ct.m_str);
+				f.AddLine(m_text_store->GetString(i));
 				break;
 			case ColorRapidType:
 			case ColorFeedType:
-				movement = ct.m_str;
+				movement = m_text_store->GetString(i);
 				break;
 			case ColorAxisType:
 				{
-					wxString str = ct.m_str;
-					wxChar axis = ct.m_str[0];
-					double pos=0;
-					ct.m_str.SubString(1,ct.m_str.size()-1).ToDouble(&pos);
+					const char* text = m_text_store->GetText(i);
+					if(m_text_store->GetLength(i) == 0)break;
+					wxString str = m_text_store->GetString(i);
+					wxChar axis = text[0];
+					double pos = atof(std::string(text + 1, m_text_store->GetLength(i) - 1).c_str());
 					if(axis == 'X' || axis == 'x')
 					{
 						str = wxString::Format(_T("%c%f"),axis,pos+ox/25.4);
@@ -445,11 +616,7 @@ void CNCCodeBlock::glCommands(bool select, bool marked, bool no_color)
 {
 	if(marked)glLineWidth(3);
 
-	for(std::list<ColouredPath>::iterator It = m_line_strips.begin(); It != m_line_strips.end(); It++)
-	{
-		ColouredPath& line_strip = *It;
-		line_strip.glCommands();
-	}
+	m_path_store->glCommands(m_first_move, m_num_moves);
 
 	if(marked)glLineWidth(1);
 
@@ -457,11 +624,14 @@ void CNCCodeBlock::glCommands(bool select, bool marked, bool no_color)
 
 void CNCCodeBlock::GetBox(CBox &box)
 {
-	for(std::list<ColouredPath>::iterator It = m_line_strips.begin(); It != m_line_strips.end(); It++)
-	{
-		ColouredPath& line_strip = *It;
-		line_strip.GetBox(box);
-	}
+	if(!m_box.m_valid)CalculateBox();
+	box.Insert(m_box);
+}
+
+void CNCCodeBlock::CalculateBox()
+{
+	m_box = CBox();
+	m_path_store->GetBox(m_first_move, m_num_moves, m_box);
 }
 
 void CNCCodeBlock::WriteXML(TiXmlNode *root)
@@ -470,26 +640,18 @@ void CNCCodeBlock::WriteXML(TiXmlNode *root)
 	element = heeksCAD->NewXMLElement( "ncblock" );
 	heeksCAD->LinkXMLEndChild( root,  element );
 
-	for(std::list<ColouredText>::iterator It = m_text.begin(); It != m_text.end(); It++)
-	{
-		ColouredText &text = *It;
-		text.WriteXML(element);
-	}
-
-	for(std::list<ColouredPath>::iterator It = m_line_strips.begin(); It != m_line_strips.end(); It++)
-	{
-		ColouredPath &line_strip = *It;
-		line_strip.WriteXML(element);
-	}
+	m_text_store->WriteXML(element, m_first_token, m_num_tokens);
+	m_path_store->WriteXML(element, m_first_move, m_num_moves);
 
 	WriteBaseXML(element);
 }
 
 // static
-HeeksObj* CNCCodeBlock::ReadFromXMLElement(TiXmlElement* element)
+CNCCodeBlock* CNCCodeBlock::ReadFromXMLElement(TiXmlElement* element, TextStore* text_store, PathStore* path_store, unsigned int block_index, CNCReadContext &context)
 {
-	CNCCodeBlock* new_object = new CNCCodeBlock;
-	new_object->m_from_pos = CNCCode::pos;
+	CNCCodeBlock* new_object = new CNCCodeBlock(text_store, path_store);
+	new_object->m_first_token = text_store->size();
+	new_object->m_first_move = path_store->size();
 
 	// loop through all the objects
 	for(TiXmlElement* pElem = heeksCAD->FirstXMLChildElement( element ) ; pElem; pElem = pElem->NextSiblingElement())
@@ -497,27 +659,21 @@ HeeksObj* CNCCodeBlock::ReadFromXMLElement(TiXmlElement* element)
 		std::string name(pElem->Value());
 		if(name == "text")
 		{
-			ColouredText t;
-			t.ReadFromXMLElement(pElem);
-			new_object->m_text.push_back(t);
-			CNCCode::pos += t.m_str.Len();
+			text_store->ReadTextFromXMLElement(pElem);
 		}
 		else if(name == "path")
 		{
-			ColouredPath l;
-			l.ReadFromXMLElement(pElem);
-			new_object->m_line_strips.push_back(l);
+			path_store->ReadPathFromXMLElement(pElem, block_index, context);
 		}
 		else if(name == "mode")
 		{
 			const char* units = pElem->Attribute("units");
-			if(units)pElem->Attribute("units", &CNCCodeBlock::multiplier);
+			if(units)pElem->Attribute("units", &context.m_multiplier);
 		}
 	}
 
-	if(new_object->m_text.size() > 0)CNCCode::pos++;
-
-	new_object->m_to_pos = CNCCode::pos;
+	new_object->m_num_tokens = text_store->size() - new_object->m_first_token;
+	new_object->m_num_moves = path_store->size() - new_object->m_first_move;
 
 	new_object->ReadBaseXML(element);
 
@@ -526,42 +682,17 @@ HeeksObj* CNCCodeBlock::ReadFromXMLElement(TiXmlElement* element)
 
 void CNCCodeBlock::AppendText(wxString& str)
 {
-	if(m_text.size() == 0)return;
+	if(m_num_tokens == 0)return;
 
-	for(std::list<ColouredText>::iterator It = m_text.begin(); It != m_text.end(); It++)
-	{
-		ColouredText &text = *It;
-		str.append(text.m_str);
-	}
+	m_text_store->AppendString(m_first_token, m_num_tokens, str);
 	str.append(_T("\n"));
 }
 
-void CNCCodeBlock::FormatText(wxTextCtrl *textCtrl, bool highlighted, bool force_format)
+long CNCCodeBlock::GetTextLength()const
 {
-	if (m_formatted && !force_format) return;
-	int i = m_from_pos;
-	for(std::list<ColouredText>::iterator It = m_text.begin(); It != m_text.end(); It++)
-	{
-		ColouredText &text = *It;
-		HeeksColor &col = CNCCode::Color(text.m_color_type);
-		wxColour c(col.red, col.green, col.blue);
-		int len = text.m_str.size();
-
-		wxFont font(10, wxFONTFAMILY_DEFAULT, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false, _T("Lucida Console"), wxFONTENCODING_SYSTEM);
-		wxTextAttr ta(c);
-		ta.SetFont(font);
-		if(highlighted)ta.SetBackgroundColour(wxColour(218, 242, 142));
-		else ta.SetBackgroundColour(wxColour(255, 255, 255));
-		textCtrl->SetStyle(i, i+len, ta);
-		i += len;
-	}
-	m_formatted = true;
+	return m_text_store->GetNumChars(m_first_token, m_num_tokens);
 }
 
-long CNCCode::pos = 0;
-// static
-PathObject* CNCCode::prev_po = NULL;
-
 std::map<std::string,ColorEnum> CNCCode::m_colors_s_i;
 std::map<ColorEnum,std::string> CNCCode::m_colors_i_s;
 std::vector<HeeksColor> CNCCode::m_colors;
@@ -674,46 +805,135 @@ void CNCCode::GetOptions(std::list<Property *> *list)
 	list->push_back(nc_options);
 }
 
-CNCCode::CNCCode():m_highlighted_block(NULL), m_gl_list(0), m_user_edited(false)
+CNCCodeData::~CNCCodeData()
+{
+	for(std::vector<CNCCodeBlock*>::iterator It = m_blocks.begin(); It != m_blocks.end(); It++)
+	{
+		CNCCodeBlock* block = *It;
+		delete block;
+	}
+}
+
+void CNCCodeData::Release()
+{
+	m_ref_count--;
+	if(m_ref_count == 0)delete this;
+}
+
+CNCCode::CNCCode():m_highlighted_block(NULL), m_data(new CNCCodeData), m_gl_list(0), m_pixel_size(0.0), m_renderer(NULL), m_tree(NULL), m_user_edited(false)
 {
 	CNCConfig config;
 	config.Read(_T("CNCCode_ArcInterpolationCount"), &CNCCode::s_arc_interpolation_count, 20);
+
+	// if the user changed the interpolation count from 20, before there was a chord tolerance, the count is kept, until a chord tolerance is set
+	// the key may have been written with its default value, so it being there isn't enough
+	config.Read(_T("CNCCode_ArcChordTolerance"), &CNCCode::s_arc_chord_tolerance, (CNCCode::s_arc_interpolation_count != 20) ? 0.0 : 0.5);
 }
 
 CNCCode::~CNCCode()
 {
-	Clear();
+	DestroyGLLists();
+	m_data->Release();
+	delete m_renderer;
+	delete m_tree;
 }
 
 const CNCCode &CNCCode::operator=(const CNCCode &rhs)
 {
 	HeeksObj::operator =(rhs);
-	Clear();
-	for(std::list<CNCCodeBlock*>::const_iterator It = rhs.m_blocks.begin(); It != rhs.m_blocks.end(); It++)
-	{
-		CNCCodeBlock* block = *It;
-		CNCCodeBlock* new_block = new CNCCodeBlock(*block);
-		m_blocks.push_back(new_block);
-	}
+	if(rhs.m_data == m_data)return *this;
+
+	// share the other nc code's blocks, rather than copying them
+	DestroyGLLists();
+	if(m_tree)m_tree->Clear();
+	rhs.m_data->AddRef();
+	m_data->Release();
+	m_data = rhs.m_data;
+	m_highlighted_block = NULL;
+	m_user_edited = rhs.m_user_edited;
 	return *this;
 }
 
 void CNCCode::Clear()
 {
-	for(std::list<CNCCodeBlock*>::iterator It = m_blocks.begin(); It != m_blocks.end(); It++)
+	DestroyGLLists();
+	if(m_tree)m_tree->Clear();
+	m_highlighted_block = NULL;
+	if(m_data->Shared())
+	{
+		m_data->Release();
+		m_data = new CNCCodeData;
+		return;
+	}
+
+	for(std::vector<CNCCodeBlock*>::iterator It = m_data->m_blocks.begin(); It != m_data->m_blocks.end(); It++)
 	{
 		CNCCodeBlock* block = *It;
 		delete block;
 	}
-	m_blocks.clear();
-	DestroyGLLists();
-	m_box = CBox();
-	m_highlighted_block = NULL;
+	m_data->m_blocks.clear();
+	m_data->m_text_store.Clear();
+	m_data->m_path_store.Clear();
+	m_data->m_box = CBox();
+	m_data->m_line_blocks.clear();
+	m_data->m_max_line_length = 0;
+}
+
+// the size of a pixel, in mm, at the given point, for the current view
+static double GetPixelSize(const double* p)
+{
+	GLdouble modelview[16], projection[16];
+	GLint viewport[4];
+	glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+	glGetDoublev(GL_PROJECTION_MATRIX, projection);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	// project the point into the window, then back from one pixel across
+	GLdouble wx, wy, wz;
+	if(!gluProject(p[0], p[1], p[2], modelview, projection, viewport, &wx, &wy, &wz))return 0.0;
+	GLdouble x, y, z;
+	if(!gluUnProject(wx + 1.0, wy, wz, modelview, projection, viewport, &x, &y, &z))return 0.0;
+	return sqrt((x - p[0]) * (x - p[0]) + (y - p[1]) * (y - p[1]) + (z - p[2]) * (z - p[2]));
+}
+
+double CNCCode::GetArcTolerance(bool select)
+{
+	// the pick matrix makes everything look bigger, so keep the arcs as they are drawn
+	if(select && m_data->m_path_store.m_arc_tolerance > 0.0)return m_data->m_path_store.m_arc_tolerance;
+
+	CBox box;
+	GetBox(box);
+	double c[3] = {0.0, 0.0, 0.0};
+	if(box.m_valid)box.Centre(c);
+	double pixel_size = GetPixelSize(c);
+	if(pixel_size <= 0.0)return m_data->m_path_store.m_arc_tolerance;
+	m_pixel_size = pixel_size;
+	if(s_arc_chord_tolerance <= 0.0)return 0.0;
+	double tolerance = pixel_size * ((s_arc_chord_tolerance > 0.01) ? s_arc_chord_tolerance : 0.01);
+
+	// round down to a power of two, so the arcs aren't made again for every small zoom
+	return pow(2.0, floor(log(tolerance) / log(2.0)));
 }
 
 void CNCCode::glCommands(bool select, bool marked, bool no_color)
 {
-	if(m_gl_list)
+	// the PathStore's arcs are for the display list, and picking; the renderer makes each tile's arcs for itself, so it is kept
+	if(m_data->m_path_store.SetArcTolerance(GetArcTolerance(select)))
+	{
+		if(m_gl_list)
+		{
+			glDeleteLists(m_gl_list, 1);
+			m_gl_list = 0;
+		}
+	}
+
+	if(PathRenderer::Available())
+	{
+		if(m_renderer == NULL)m_renderer = new PathRenderer;
+		if(!m_renderer->Built())m_renderer->Build(m_data->m_path_store);
+		m_renderer->glCommands(m_data->m_path_store, select);
+	}
+	else if(m_gl_list)
 	{
 		glCallList(m_gl_list);
 	}
@@ -721,33 +941,90 @@ void CNCCode::glCommands(bool select, bool marked, bool no_color)
 		m_gl_list = glGenLists(1);
 		glNewList(m_gl_list, GL_COMPILE_AND_EXECUTE);
 
-		// render all the blocks
-		CNCCode::prev_po = NULL;
-
-		for(std::list<CNCCodeBlock*>::iterator It = m_blocks.begin(); It != m_blocks.end(); It++)
-		{
-			CNCCodeBlock* block = *It;
-			glPushName(block->GetIndex());
-			block->glCommands(true, block == m_highlighted_block, false);
-			glPopName();
-		}
+		// render all the blocks; the block picked is found with m_tree, so they don't need names
+		m_data->m_path_store.glCommands(0, m_data->m_path_store.size());
 
 		glEndList();
 	}
+
+	// the highlighted block is drawn again on top, so changing the highlight doesn't need the program redrawing into the lists
+	if(m_highlighted_block && !select)
+	{
+		glPushAttrib(GL_DEPTH_BUFFER_BIT);
+		glDepthFunc(GL_LEQUAL);
+		m_highlighted_block->glCommands(false, true, false);
+		glPopAttrib();
+	}
 }
 
-void CNCCode::GetBox(CBox &box)
+class CBlockBoxThread : public wxThread
 {
-	if(!m_box.m_valid)
+	std::vector<CNCCodeBlock*>::iterator m_begin, m_end;
+
+public:
+	CBox m_box;
+
+	CBlockBoxThread(std::vector<CNCCodeBlock*>::iterator begin, std::vector<CNCCodeBlock*>::iterator end):wxThread(wxTHREAD_JOINABLE), m_begin(begin), m_end(end){}
+
+	ExitCode Entry()
 	{
-		for(std::list<CNCCodeBlock*>::iterator It = m_blocks.begin(); It != m_blocks.end(); It++)
+		for(std::vector<CNCCodeBlock*>::iterator It = m_begin; It != m_end; It++)
 		{
 			CNCCodeBlock* block = *It;
-			block->GetBox(m_box);
+			block->CalculateBox();
+			m_box.Insert(block->m_box);
 		}
+		return 0;
 	}
+};
 
-	box.Insert(m_box);
+void CNCCode::CalculateBoxes()
+{
+	// each thread works out the boxes of a range of blocks and the box around them, then those are put together
+	m_data->m_box = CBox();
+	size_t num_threads = m_data->m_blocks.size() / 10000 + 1;
+	int cpu_count = wxThread::GetCPUCount();
+	if(cpu_count < 1)cpu_count = 1;
+	if(num_threads > (size_t)cpu_count)num_threads = cpu_count;
+
+	std::vector<CBlockBoxThread*> threads;
+	for(size_t i = 0; i < num_threads; i++)
+	{
+		CBlockBoxThread* thread = new CBlockBoxThread(m_data->m_blocks.begin() + m_data->m_blocks.size() * i / num_threads, m_data->m_blocks.begin() + m_data->m_blocks.size() * (i + 1) / num_threads);
+		if(i > 0 && thread->Create() == wxTHREAD_NO_ERROR && thread->Run() == wxTHREAD_NO_ERROR)
+		{
+			threads.push_back(thread);
+		}
+		else
+		{
+			thread->Entry();
+			m_data->m_box.Insert(thread->m_box);
+			delete thread;
+		}
+	}
+	for(std::vector<CBlockBoxThread*>::iterator It = threads.begin(); It != threads.end(); It++)
+	{
+		CBlockBoxThread* thread = *It;
+		thread->Wait();
+		m_data->m_box.Insert(thread->m_box);
+		delete thread;
+	}
+}
+
+void CNCCode::GetBox(CBox &box)
+{
+	if(!m_data->m_box.m_valid)CalculateBoxes();
+
+	box.Insert(m_data->m_box);
+}
+
+void on_set_arc_chord_tolerance(double value, HeeksObj*object)
+{
+	CNCCode::s_arc_chord_tolerance = value;
+	CNCConfig config;
+	config.Write(_T("CNCCode_ArcChordTolerance"), CNCCode::s_arc_chord_tolerance);
+	((CNCCode*)object)->DestroyGLLists();
+	heeksCAD->Repaint();
 }
 
 void on_set_arc_interpolation_count(int value, HeeksObj*object)
@@ -755,11 +1032,14 @@ void on_set_arc_interpolation_count(int value, HeeksObj*object)
 	CNCCode::s_arc_interpolation_count = value;
 	CNCConfig config;
 	config.Write(_T("CNCCode_ArcInterpolationCount"), CNCCode::s_arc_interpolation_count);
+	((CNCCode*)object)->DestroyGLLists();
+	heeksCAD->Repaint();
 }
 
 void CNCCode::GetProperties(std::list<Property *> *list)
 {
-	list->push_back( new PropertyInt(_("Arc Interpolation Count"), CNCCode::s_arc_interpolation_count, this, on_set_arc_interpolation_count) );
+	list->push_back( new PropertyDouble(_("Arc Chord Tolerance ( pixels )"), CNCCode::s_arc_chord_tolerance, this, on_set_arc_chord_tolerance) );
+	list->push_back( new PropertyInt(_("Arc Interpolation Count ( if chord tolerance is 0 )"), CNCCode::s_arc_interpolation_count, this, on_set_arc_interpolation_count) );
 	HeeksObj::GetProperties(list);
 }
 
@@ -772,19 +1052,34 @@ HeeksObj *CNCCode::MakeACopy(void)const{return new CNCCode(*this);}
 
 void CNCCode::CopyFrom(const HeeksObj* object){operator=(*((CNCCode*)object));}
 
+bool CNCCode::IsDifferent(HeeksObj* other)
+{
+	// copies share their blocks until one of them is changed
+	CNCCode* nc_code = (CNCCode*)other;
+	return (m_data != nc_code->m_data) || (m_user_edited != nc_code->m_user_edited);
+}
+
 void CNCCode::WriteXML(TiXmlNode *root)
 {
 	TiXmlElement * element;
 	element = heeksCAD->NewXMLElement( "nccode" );
 	heeksCAD->LinkXMLEndChild( root,  element );
 
-	for(std::list<CNCCodeBlock*>::iterator It = m_blocks.begin(); It != m_blocks.end(); It++)
+	for(std::vector<CNCCodeBlock*>::iterator It = m_data->m_blocks.begin(); It != m_data->m_blocks.end(); It++)
 	{
 		CNCCodeBlock* block = *It;
 		block->WriteXML(element);
 	}
 
 	element->SetAttribute( "edited", m_user_edited ? 1:0);
+	if(m_user_edited && theApp.m_output_canvas->IsEditing())
+	{
+		// the user's edits are only in the output window
+		TiXmlElement * text_element = heeksCAD->NewXMLElement( "edited_text" );
+		heeksCAD->LinkXMLEndChild( element,  text_element );
+		TiXmlText* text = heeksCAD->NewXMLText(theApp.m_output_canvas->GetText().utf8_str());
+		text_element->LinkEndChild(text);
+	}
 
 	WriteBaseXML(element);
 }
@@ -799,27 +1094,35 @@ bool CNCCode::CanAddTo(HeeksObj* owner)
 	return ((owner != NULL) && (owner->GetType() == ProgramType));
 }
 
+CNCCodeBlock* CNCCode::Pick(const double* ray_start, const double* ray_direction, unsigned int* move, double* t)
+{
+	if(m_tree == NULL || !m_tree->Built())MakePickTree(); // copies share the blocks, but not the tree
+
+	// within a few pixels of the ray, as last drawn
+	double tolerance = m_pixel_size * 4;
+	if(tolerance <= 0.0)
+	{
+		CBox box;
+		GetBox(box);
+		if(box.m_valid)tolerance = sqrt(box.Width() * box.Width() + box.Height() * box.Height() + box.Depth() * box.Depth()) / 200;
+	}
+
+	unsigned int picked_move;
+	double picked_t;
+	if(!m_tree->Pick(ray_start, ray_direction, tolerance, picked_move, picked_t))return NULL;
+
+	if(move)*move = picked_move;
+	if(t)*t = picked_t;
+	return m_data->m_blocks[m_data->m_path_store.m_block[picked_move]];
+}
+
 void CNCCode::SetClickMarkPoint(MarkedObject* marked_object, const double* ray_start, const double* ray_direction)
 {
-	if(marked_object->m_map.size() > 0)
+	CNCCodeBlock* block = Pick(ray_start, ray_direction);
+	if(block)
 	{
-		MarkedObject* sub_marked_object = marked_object->m_map.begin()->second;
-		if(sub_marked_object)
-		{
-			if(sub_marked_object->m_map.size() > 0)
-			{
-				HeeksObj* object = sub_marked_object->m_map.begin()->first;
-				if(object && object->GetType() == NCCodeBlockType)
-				{
-					SetHighlightedBlock((CNCCodeBlock*)object);
-					int from_pos = m_highlighted_block->m_from_pos;
-					int to_pos = m_highlighted_block->m_to_pos;
-					DestroyGLLists();
-					theApp.m_output_canvas->m_textCtrl->ShowPosition(from_pos);
-					theApp.m_output_canvas->m_textCtrl->SetSelection(from_pos, to_pos);
-				}
-			}
-		}
+		SetHighlightedBlock(block);
+		if(block->m_line >= 0)theApp.m_output_canvas->ShowLine(block->m_line);
 	}
 }
 
@@ -827,10 +1130,8 @@ void CNCCode::SetClickMarkPoint(MarkedObject* marked_object, const double* ray_s
 HeeksObj* CNCCode::ReadFromXMLElement(TiXmlElement* element)
 {
 	CNCCode* new_object = new CNCCode;
-	pos = 0;
-
-	CNCCodeBlock::multiplier = 1.0;
-	PathObject::m_current_x[0] = PathObject::m_current_x[1] = PathObject::m_current_x[2]  = 0.0;
+	CNCReadContext context;
+	wxString edited_text;
 
 	// loop through all the objects
 	for(TiXmlElement* pElem = heeksCAD->FirstXMLChildElement( element ) ; pElem;	pElem = pElem->NextSiblingElement())
@@ -838,8 +1139,13 @@ HeeksObj* CNCCode::ReadFromXMLElement(TiXmlElement* element)
 		std::string name(pElem->Value());
 		if(name == "ncblock")
 		{
-			HeeksObj* object = CNCCodeBlock::ReadFromXMLElement(pElem);
-			new_object->m_blocks.push_back((CNCCodeBlock*)object);
+			CNCCodeBlock* block = CNCCodeBlock::ReadFromXMLElement(pElem, &new_object->m_data->m_text_store, &new_object->m_data->m_path_store, new_object->m_data->m_blocks.size(), context);
+			new_object->m_data->m_blocks.push_back(block);
+		}
+		else if(name == "edited_text")
+		{
+			const char* text = pElem->GetText();
+			if(text)edited_text = wxString(text, wxConvUTF8);
 		}
 	}
 
@@ -850,79 +1156,185 @@ HeeksObj* CNCCode::ReadFromXMLElement(TiXmlElement* element)
 
 	new_object->ReadBaseXML(element);
 
-	new_object->SetTextCtrl(theApp.m_output_canvas->m_textCtrl);
+	new_object->SetListing(theApp.m_output_canvas->m_listing);
+	new_object->MakePickTree();
+	if(new_object->m_user_edited && edited_text.Len() > 0)theApp.m_output_canvas->SetEditedText(edited_text);
 
 	return new_object;
 }
 
-void CNCCode::DestroyGLLists(void)
+// the start of the file written by nc/hbin_writer.py
+struct BinaryBackplotHeader
 {
-	if (m_gl_list)
-	{
-		glDeleteLists(m_gl_list, 1);
-		m_gl_list = 0;
-	}
+	char m_magic[4];
+	unsigned int m_version;
+	unsigned int m_num_colors;
+	unsigned int m_num_blocks;
+	unsigned int m_num_texts;
+	unsigned int m_text_bytes;
+	unsigned int m_num_moves;
+	unsigned int m_num_arcs;
+};
+
+// returns the next section of the file, of count items of item_size bytes, and moves past it
+// returns NULL if the file is too short, or if the counts from the header are too big to be a size
+static const char* NextBinarySection(const char* &p, const char* end, size_t count, size_t item_size)
+{
+	if(count > ((size_t)-1 - 7) / item_size)return NULL;
+	size_t padded_size = (count * item_size + 7) & ~((size_t)7);
+	if((size_t)(end - p) < padded_size)return NULL;
+	const char* section = p;
+	p += padded_size;
+	return section;
 }
 
-void CNCCode::SetTextCtrl(wxTextCtrl *textCtrl)
+bool CNCCode::ReadFromBinaryFile(const wxString& file_path)
 {
-	textCtrl->Clear();
+	CMappedFile file(file_path);
+	if(!file.IsOpened() || file.GetSize() < sizeof(BinaryBackplotHeader))return false;
+
+	const BinaryBackplotHeader* header = (const BinaryBackplotHeader*)file.GetData();
+	if(strncmp(header->m_magic, "HNCB", 4) != 0 || header->m_version != 1 || header->m_num_colors > 256)return false;
+
+	const char* p = file.GetData() + sizeof(BinaryBackplotHeader);
+	const char* end = file.GetData() + file.GetSize();
+	size_t num_moves = header->m_num_moves;
+	size_t num_arcs = header->m_num_arcs;
+
+	// each section is checked, as a NULL one would move p to nowhere for the next
+	const char* color_names = NextBinarySection(p, end, header->m_num_colors, 16);
+	const unsigned int* blocks = color_names ? (const unsigned int*)NextBinarySection(p, end, header->m_num_blocks, 2 * sizeof(unsigned int)) : NULL;
+	const unsigned int* texts = blocks ? (const unsigned int*)NextBinarySection(p, end, header->m_num_texts, 3 * sizeof(unsigned int)) : NULL;
+	const char* text_arena = texts ? NextBinarySection(p, end, header->m_text_bytes, 1) : NULL;
+	const unsigned char* types = text_arena ? (const unsigned char*)NextBinarySection(p, end, num_moves, 1) : NULL;
+	const unsigned char* colors = types ? (const unsigned char*)NextBinarySection(p, end, num_moves, 1) : NULL;
+	const int* tool_numbers = colors ? (const int*)NextBinarySection(p, end, num_moves, sizeof(int)) : NULL;
+	const double* x = tool_numbers ? (const double*)NextBinarySection(p, end, num_moves, 3 * sizeof(double)) : NULL;
+	const double* arc_c = x ? (const double*)NextBinarySection(p, end, num_arcs, 3 * sizeof(double)) : NULL;
+	const signed char* arc_dir = arc_c ? (const signed char*)NextBinarySection(p, end, num_arcs, 1) : NULL;
+	if(arc_dir == NULL)return false;
+
+	// the file's colours are names, like in the xml file
+	ColorEnum color_map[256];
+	for(unsigned int i = 0; i < header->m_num_colors; i++)
+	{
+		std::string name(color_names + i * 16, strnlen(color_names + i * 16, 16));
+		color_map[i] = GetColor(name.c_str());
+	}
 
-	textCtrl->Freeze();
+	Clear();
+	m_user_edited = false;
+
+	// the file's text is already UTF-8, in one arena
+	m_data->m_text_store.m_arena.assign(text_arena, text_arena + header->m_text_bytes);
+	m_data->m_text_store.m_offset.resize(header->m_num_texts);
+	m_data->m_text_store.m_length.resize(header->m_num_texts);
+	m_data->m_text_store.m_color.resize(header->m_num_texts);
+
+	m_data->m_path_store.m_type.assign(types, types + num_moves);
+	m_data->m_path_store.m_tool_number.assign(tool_numbers, tool_numbers + num_moves);
+	m_data->m_path_store.m_x.assign(x, x + num_moves * 3);
+	m_data->m_path_store.m_arc_c.assign(arc_c, arc_c + num_arcs * 3);
+	m_data->m_path_store.m_arc_dir.assign(arc_dir, arc_dir + num_arcs);
+	m_data->m_path_store.m_color.resize(num_moves);
+	m_data->m_path_store.m_block.resize(num_moves);
+	m_data->m_path_store.m_arc.resize(num_moves);
+
+	bool valid = true;
+	unsigned int text = 0, move = 0, arc = 0;
+	m_data->m_blocks.reserve(header->m_num_blocks);
+	for(unsigned int b = 0; b < header->m_num_blocks && valid; b++)
+	{
+		unsigned int block_texts = blocks[b*2];
+		unsigned int block_moves = blocks[b*2 + 1];
+		if(block_texts > header->m_num_texts - text || block_moves > num_moves - move)
+		{
+			valid = false;
+			break;
+		}
 
-	wxFont font(10, wxFONTFAMILY_DEFAULT, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false, _T("Lucida Console"), wxFONTENCODING_SYSTEM);
-	wxTextAttr ta;
-	ta.SetFont(font);
-	textCtrl->SetDefaultStyle(ta);
+		CNCCodeBlock* block = new CNCCodeBlock(&m_data->m_text_store, &m_data->m_path_store);
+		block->m_first_token = text;
+		block->m_num_tokens = block_texts;
+		block->m_first_move = move;
+		block->m_num_moves = block_moves;
+		m_data->m_blocks.push_back(block);
 
-	wxString str;
-	for(std::list<CNCCodeBlock*>::iterator It = m_blocks.begin(); It != m_blocks.end(); It++)
-	{
-		CNCCodeBlock* block = *It;
-		block->AppendText(str);
+		for(unsigned int t = text; t < text + block_texts; t++)
+		{
+			unsigned int offset = texts[t*3], length = texts[t*3 + 1], color = texts[t*3 + 2];
+			if(offset > header->m_text_bytes || length > header->m_text_bytes - offset || color >= header->m_num_colors)
+			{
+				valid = false;
+				break;
+			}
+			m_data->m_text_store.m_offset[t] = offset;
+			m_data->m_text_store.m_length[t] = length;
+			m_data->m_text_store.m_color[t] = (unsigned char)color_map[color];
+		}
+		text += block_texts;
+
+		for(unsigned int i = move; i < move + block_moves; i++)
+		{
+			if(colors[i] >= header->m_num_colors || types[i] > PathObject::eArc || (types[i] == PathObject::eArc && arc >= num_arcs))
+			{
+				valid = false;
+				break;
+			}
+			m_data->m_path_store.m_color[i] = (unsigned char)color_map[colors[i]];
+			m_data->m_path_store.m_block[i] = b;
+			m_data->m_path_store.m_arc[i] = (types[i] == PathObject::eArc) ? arc++ : 0;
+		}
+		move += block_moves;
 	}
-	textCtrl->SetValue(str);
 
-#ifndef WIN32
-	// for Windows, this is done in COutputTextCtrl::OnPaint
-	for(std::list<CNCCodeBlock*>::iterator It = m_blocks.begin(); It != m_blocks.end(); It++)
+	if(!valid || text != header->m_num_texts || move != num_moves || arc != num_arcs)
 	{
-		CNCCodeBlock* block = *It;
-		block->FormatText(textCtrl, block == m_highlighted_block, false);
+		Clear();
+		return false;
 	}
-#endif
 
-	textCtrl->Thaw();
+	SetListing(theApp.m_output_canvas->m_listing);
+	MakePickTree();
+
+	return true;
 }
 
-void CNCCode::FormatBlocks(wxTextCtrl *textCtrl, int i0, int i1)
+void CNCCode::DestroyGLLists(void)
 {
-	textCtrl->Freeze();
-	for(std::list<CNCCodeBlock*>::iterator It = m_blocks.begin(); It != m_blocks.end(); It++)
+	if (m_gl_list)
 	{
-		CNCCodeBlock* block = *It;
-		if (i0 <= block->m_from_pos && block->m_from_pos <= i1)
-			block->FormatText(textCtrl, block == m_highlighted_block, false);
+		glDeleteLists(m_gl_list, 1);
+		m_gl_list = 0;
 	}
-	textCtrl->Thaw();
+	if(m_renderer)m_renderer->Destroy();
 }
 
-void CNCCode::HighlightBlock(long pos)
+void CNCCode::MakePickTree()
 {
-	SetHighlightedBlock(NULL);
+	if(m_tree == NULL)m_tree = new PathTree;
+	m_tree->Build(m_data->m_path_store);
+}
 
-	for(std::list<CNCCodeBlock*>::iterator It = m_blocks.begin(); It != m_blocks.end(); It++)
+void CNCCode::SetListing(COutputListing *listing)
+{
+	m_data->m_line_blocks.clear();
+	m_data->m_max_line_length = 0;
+	for(unsigned int i = 0; i < m_data->m_blocks.size(); i++)
 	{
-		CNCCodeBlock* block = *It;
-		if(pos < block->m_to_pos)
+		CNCCodeBlock* block = m_data->m_blocks[i];
+		if(block->m_num_tokens > 0)
 		{
-			SetHighlightedBlock(block);
-			break;
+			block->m_line = (long)m_data->m_line_blocks.size();
+			m_data->m_line_blocks.push_back(i);
+			long length = block->GetTextLength();
+			if(length > m_data->m_max_line_length)m_data->m_max_line_length = length;
 		}
+		else block->m_line = -1;
 	}
-	DestroyGLLists();
-}
 
+	listing->ShowNCCode(this);
+}
 
 
 static double Distance( const gp_Pnt start, const gp_Pnt end )
@@ -998,25 +1410,17 @@ std::list<gp_Pnt> PathArc::Interpolate(
 } // End Interpolate() method
 
 
-std::list< std::pair<PathObject *, CTool *> > CNCCode::GetPaths() const
+std::list< std::pair<unsigned int, CTool *> > CNCCode::GetPaths() const
 {
-	std::list< std::pair<PathObject *, CTool *> > paths;
+	std::list< std::pair<unsigned int, CTool *> > paths;
 
-	for(std::list<CNCCodeBlock*>::const_iterator l_itCodeBlock = m_blocks.begin(); l_itCodeBlock != m_blocks.end(); l_itCodeBlock++)
+	for(unsigned int i = 0; i < m_data->m_path_store.size(); i++)
 	{
-		for (std::list<ColouredPath>::const_iterator l_itColouredPath = (*l_itCodeBlock)->m_line_strips.begin();
-			l_itColouredPath != (*l_itCodeBlock)->m_line_strips.end(); l_itColouredPath++)
+		CTool *pTool = CTool::Find( m_data->m_path_store.m_tool_number[i] );
+		if (pTool != NULL)
 		{
-			for (std::list< PathObject* >::const_iterator l_itPoint = l_itColouredPath->m_points.begin();
-				l_itPoint != l_itColouredPath->m_points.end(); l_itPoint++)
-			{
-				CTool *pTool = CTool::Find( (*l_itPoint)->m_tool_number );
-				if (pTool != NULL)
-				{
-					paths.push_back( std::make_pair( *l_itPoint, pTool ) );
-				} // End if - then
-			} // End for
-		} // End for
+			paths.push_back( std::make_pair( i, pTool ) );
+		} // End if - then
 	} // End for
 
 	return(paths);
@@ -1024,7 +1428,6 @@ std::list< std::pair<PathObject *, CTool *> > CNCCode::GetPaths() const
 
 void CNCCode::SetHighlightedBlock(CNCCodeBlock* block)
 {
-	if(m_highlighted_block)m_highlighted_block->FormatText(theApp.m_output_canvas->m_textCtrl, false, true);
 	m_highlighted_block = block;
-	if(m_highlighted_block)m_highlighted_block->FormatText(theApp.m_output_canvas->m_textCtrl, true, true);
+	theApp.m_output_canvas->m_listing->Refresh();
 }
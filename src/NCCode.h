@@ -20,6 +20,7 @@
 #include <gp_Pnt.hxx>
 
 #include <list>
+#include <vector>
 
 enum ColorEnum{
 	ColorDefaultType,
@@ -36,17 +37,24 @@ enum ColorEnum{
 	MaxColorTypes
 };
 
-class ColouredText
+// The state carried from one block to the next while reading nc code.
+// It is kept here, rather than in statics, so more than one file can be read at once.
+class CNCReadContext
 {
 public:
-	wxString m_str;
-	ColorEnum m_color_type;
-	ColouredText():m_color_type(ColorDefaultType){}
-
-	void WriteXML(TiXmlNode *root);
-	void ReadFromXMLElement(TiXmlElement* pElem);
+	double m_current_x[3];
+	double m_prev_x[3];
+	double m_multiplier;
+
+	CNCReadContext():m_multiplier(1.0)
+	{
+		m_current_x[0] = m_current_x[1] = m_current_x[2] = 0.0;
+		m_prev_x[0] = m_prev_x[1] = m_prev_x[2] = 0.0;
+	}
 };
 
+// PathLine and PathArc are lightweight views of one move in a PathStore.
+// They are filled in on demand by PathStore::GetLine and PathStore::GetArc.
 class PathObject{
 public:
 	typedef enum {
@@ -55,31 +63,16 @@ public:
 	} eType_t;
 
 public:
-	virtual ~PathObject() {}
-
-	static double m_current_x[3];
-	static double m_prev_x[3];
 	double m_x[3];
 	int m_tool_number;
-	PathObject(){m_x[0] = m_x[1] = m_x[2] = 0.0;}
-	virtual int GetType() = 0; // 0 - line, 1 - arc
-	virtual void GetBox(CBox &box,const PathObject* prev_po){box.Insert(m_x);}
-
-	void WriteBaseXML(TiXmlElement *element);
+	PathObject():m_tool_number(0){m_x[0] = m_x[1] = m_x[2] = 0.0;}
 
-	virtual void WriteXML(TiXmlNode *root) = 0;
-	virtual void ReadFromXMLElement(TiXmlElement* pElem) = 0;
-	virtual void glVertices(const PathObject* prev_po){}
-	virtual PathObject *MakeACopy(void)const = 0;
+	static void ReadFromXMLElement(TiXmlElement* pElem, int &tool_number, CNCReadContext &context);
 };
 
 class PathLine : public PathObject{
 public:
-	int GetType(){return int(PathObject::eLine);}
-	void WriteXML(TiXmlNode *root);
-	void ReadFromXMLElement(TiXmlElement* pElem);
-	void glVertices(const PathObject* prev_po);
-	PathObject *MakeACopy(void)const{return new PathLine(*this);}
+	int GetType()const{return int(PathObject::eLine);}
 
 	std::list<gp_Pnt> Interpolate( const gp_Pnt & start_point,
 					const gp_Pnt & end_point,
@@ -94,14 +87,11 @@ public:
 	double m_c[3]; // defined relative to previous point ( span start point )
 	double m_radius;
 	int m_dir; // 1 - anti-clockwise, -1 - clockwise
-	PathArc(){m_c[0] = m_c[1] = m_c[2] = 0.0; m_dir = 1;}
-	int GetType(){return int(PathObject::eArc);}
-	void WriteXML(TiXmlNode *root);
-	void ReadFromXMLElement(TiXmlElement* pElem);
-	void glVertices(const PathObject* prev_po);
+	PathArc(){m_c[0] = m_c[1] = m_c[2] = 0.0; m_radius = 0.0; m_dir = 1;}
+	int GetType()const{return int(PathObject::eArc);}
 	std::list<gp_Pnt> Interpolate( const PathObject *prev_po, const unsigned int number_of_points ) const;
-
-	PathObject *MakeACopy(void)const{return new PathArc(*this);}
+	unsigned int GetNumberOfSegments( const PathObject *prev_po, double tolerance ) const; // enough for each chord to be within tolerance of the arc
+	void GetAngles(const PathObject *prev_po, double &start_angle, double &end_angle, double &rs, double &re) const;
 
 	void GetBox(CBox &box,const PathObject* prev_po);
 	bool IsIncluded(gp_Pnt pnt,const PathObject* prev_po);
@@ -110,36 +100,93 @@ public:
 					const double feed_rate,
 					const double spindle_rpm,
 					const unsigned int number_of_cutting_edges) const;
-	void SetFromRadius();
+	void SetFromRadius(const double* start);
 };
 
-class ColouredPath
+// All the moves of a CNCCode, in program order, in parallel arrays.
+// Each move goes from the end of the previous move to its own end point.
+class PathStore
 {
 public:
-	ColorEnum m_color_type;
-	std::list< PathObject* > m_points;
-	ColouredPath():m_color_type(ColorRapidType){}
-	ColouredPath(const ColouredPath& c);
-	~ColouredPath(){Clear();}
+	std::vector<unsigned char> m_type; // PathObject::eType_t
+	std::vector<unsigned char> m_color; // ColorEnum
+	std::vector<int> m_tool_number;
+	std::vector<unsigned int> m_block; // index of the owning block in CNCCode::m_blocks
+	std::vector<unsigned int> m_arc; // for arcs, index into the arc arrays below
+	std::vector<double> m_x; // end points, three per move
+
+	std::vector<double> m_arc_c; // arc centres relative to the start point, three per arc
+	std::vector<signed char> m_arc_dir; // 1 - anti-clockwise, -1 - clockwise
 
-	const ColouredPath &operator=(const ColouredPath& c);
+	// the lines drawn for each arc, made when the arc is first drawn, for m_arc_tolerance
+	mutable double m_arc_tolerance;
+	mutable std::vector<unsigned int> m_arc_first_vertex; // for each arc, index into m_arc_vertices
+	mutable std::vector<unsigned int> m_arc_num_vertices; // for each arc, 0 until it has been made
+	mutable std::vector<double> m_arc_vertices; // three per vertex; the points after each arc's start point
 
+	PathStore():m_arc_tolerance(0.0){}
+
+	unsigned int size()const{return (unsigned int)m_type.size();}
 	void Clear();
-	void glCommands();
-	void GetBox(CBox &box);
-	void WriteXML(TiXmlNode *root);
-	void ReadFromXMLElement(TiXmlElement* pElem);
+	void ClearArcVertices()const;
+	bool SetArcTolerance(double tolerance)const; // returns true, if the arcs will be drawn differently
+	unsigned int GetArcVertices(unsigned int i, const double** vertices)const; // returns the number of vertices after the start point
+
+	void AddLine(const double* x, int tool_number, ColorEnum color, unsigned int block);
+	void AddArc(const double* x, const double* c, int dir, int tool_number, ColorEnum color, unsigned int block);
+
+	int GetType(unsigned int i)const{return m_type[i];}
+	ColorEnum GetColor(unsigned int i)const{return (ColorEnum)m_color[i];}
+	const double* GetEnd(unsigned int i)const{return &m_x[i*3];}
+	const double* GetStart(unsigned int i)const{return (i == 0) ? NULL : &m_x[(i-1)*3];}
+	void GetPathObject(unsigned int i, PathObject &po)const;
+	void GetLine(unsigned int i, PathLine &line)const;
+	void GetArc(unsigned int i, PathArc &arc)const;
+
+	void GetBox(unsigned int first, unsigned int count, CBox &box)const;
+	void glVertices(unsigned int i)const;
+	void glCommands(unsigned int first, unsigned int count)const;
+	void WriteXML(TiXmlNode *root, unsigned int first, unsigned int count)const;
+	void ReadPathFromXMLElement(TiXmlElement* pElem, unsigned int block, CNCReadContext &context);
+};
+
+// All the text of a CNCCode, in program order, as coloured tokens in one UTF-8 arena.
+// Each block's text is a range of tokens, like its moves are a range of a PathStore's moves.
+class TextStore
+{
+public:
+	std::vector<char> m_arena; // UTF-8, without terminators
+	std::vector<unsigned int> m_offset; // start of each token in m_arena
+	std::vector<unsigned int> m_length; // in bytes
+	std::vector<unsigned char> m_color; // ColorEnum
+
+	unsigned int size()const{return (unsigned int)m_offset.size();}
+	void Clear();
+	void Add(const char* s, unsigned int length, ColorEnum color);
+	void Append(const TextStore &store); // adds all of another store's tokens
+
+	const char* GetText(unsigned int i)const{return (m_length[i] == 0) ? "" : &m_arena[m_offset[i]];}
+	unsigned int GetLength(unsigned int i)const{return m_length[i];}
+	ColorEnum GetColor(unsigned int i)const{return (ColorEnum)m_color[i];}
+	wxString GetString(unsigned int i)const;
+	void AppendString(unsigned int first, unsigned int count, wxString& str)const;
+	long GetNumChars(unsigned int first, unsigned int count)const; // characters, rather than bytes
+
+	void WriteXML(TiXmlNode *root, unsigned int first, unsigned int count)const;
+	void ReadTextFromXMLElement(TiXmlElement* pElem);
 };
 
 class CNCCodeBlock:public HeeksObj
 {
 public:
-	std::list<ColouredText> m_text;
-	std::list<ColouredPath> m_line_strips;
-	long m_from_pos, m_to_pos; // position of block in text ctrl
-	static double multiplier;
+	TextStore* m_text_store; // this block's text is m_text_store's tokens from m_first_token
+	unsigned int m_first_token, m_num_tokens;
+	PathStore* m_path_store; // this block's moves are m_path_store's moves from m_first_move
+	unsigned int m_first_move, m_num_moves;
+	long m_line; // line in the output listing; -1 if the block has no text
+	CBox m_box; // of the block's moves; worked out once, by CNCCode::CalculateBoxes, when the block is read, as its moves don't change after that
 
-	CNCCodeBlock():m_from_pos(-1), m_to_pos(-1), m_formatted(false) {}
+	CNCCodeBlock(TextStore* text_store = NULL, PathStore* path_store = NULL):m_text_store(text_store), m_first_token(0), m_num_tokens(0), m_path_store(path_store), m_first_move(0), m_num_moves(0), m_line(-1) {}
 
 	void WriteNCCode(wxTextFile &f, double ox, double oy);
 
@@ -150,17 +197,43 @@ public:
 	void GetBox(CBox &box);
 	void WriteXML(TiXmlNode *root);
 
-	static HeeksObj* ReadFromXMLElement(TiXmlElement* pElem);
+	void CalculateBox();
+	static CNCCodeBlock* ReadFromXMLElement(TiXmlElement* pElem, TextStore* text_store, PathStore* path_store, unsigned int block_index, CNCReadContext &context);
 	void AppendText(wxString& str);
-	void FormatText(wxTextCtrl *textCtrl, bool highlighted, bool force_format);
-private:
-	bool m_formatted;
+	long GetTextLength()const;
 };
 
-class CNCCode:public HeeksObj
+// The blocks and moves of a CNCCode.
+// They aren't changed once they have been read, so copies of a CNCCode, like the ones kept for undo, share them.
+// Reading new nc code into a CNCCode starts with Clear, which gives it its own new CNCCodeData, if the old one is shared.
+class CNCCodeData
 {
+	int m_ref_count;
+	~CNCCodeData();
+	CNCCodeData(const CNCCodeData &d); // not defined
+	CNCCodeData &operator=(const CNCCodeData &d); // not defined
+
 public:
-	static long pos; // used for setting the CNCCodeBlock objects' m_from_pos and m_to_pos
+	std::vector<CNCCodeBlock*> m_blocks;
+	TextStore m_text_store;
+	PathStore m_path_store;
+	std::vector<unsigned int> m_line_blocks; // for each line of the output listing, the index of its block in m_blocks
+	long m_max_line_length;
+	CBox m_box;
+
+	CNCCodeData():m_ref_count(1), m_max_line_length(0){}
+
+	void AddRef(){m_ref_count++;}
+	void Release(); // deletes this, when it isn't used any more
+	bool Shared()const{return m_ref_count > 1;}
+};
+
+class PathRenderer;
+class PathTree;
+class COutputListing;
+
+class CNCCode:public HeeksObj
+{
 private:
 	static std::map<std::string,ColorEnum> m_colors_s_i;
 	static std::map<ColorEnum,std::string> m_colors_i_s;
@@ -175,15 +248,17 @@ public:
 	static int ColorCount(void) { return m_colors.size(); }
 	static HeeksColor& Color(ColorEnum i) { return m_colors[i]; }
 
-	std::list<CNCCodeBlock*> m_blocks;
-	int m_gl_list;
-	CBox m_box;
+	CNCCodeData* m_data; // maybe shared with other copies; call Clear before reading into it
+	int m_gl_list; // only used if vertex buffer objects aren't available
+	double m_pixel_size; // in mm, at the middle of the toolpath, when it was last drawn
+	PathRenderer* m_renderer;
+	PathTree* m_tree; // for picking; made when the nc code is loaded, and kept while the view changes
 	bool m_user_edited; // set, if the user has edited the nc code
-	static PathObject* prev_po;
-	static int s_arc_interpolation_count;	// How many lines to represent an arc for the glCommands() method?
+	static double s_arc_chord_tolerance; // in pixels; how far the lines drawn for an arc may be from it, or 0 to use s_arc_interpolation_count
+	static int s_arc_interpolation_count; // lines for each arc, if there isn't a chord tolerance
 
 	CNCCode();
-	CNCCode(const CNCCode &p):m_highlighted_block(NULL), m_gl_list(0) {operator=(p);}
+	CNCCode(const CNCCode &p):m_highlighted_block(NULL), m_data(new CNCCodeData), m_gl_list(0), m_pixel_size(0.0), m_renderer(NULL), m_tree(NULL), m_user_edited(false) {operator=(p);}
 	virtual ~CNCCode();
 
 	const CNCCode &operator=(const CNCCode &p);
@@ -199,6 +274,7 @@ public:
 	void GetTools(std::list<Tool*>* t_list, const wxPoint* p);
 	HeeksObj *MakeACopy(void)const;
 	void CopyFrom(const HeeksObj* object);
+	bool IsDifferent(HeeksObj* other);
 	void WriteXML(TiXmlNode *root);
 	bool CanAdd(HeeksObj* object);
 	bool CanAddTo(HeeksObj* owner);
@@ -206,15 +282,22 @@ public:
 	void SetClickMarkPoint(MarkedObject* marked_object, const double* ray_start, const double* ray_direction);
 
 	static HeeksObj* ReadFromXMLElement(TiXmlElement* pElem);
+	bool ReadFromBinaryFile(const wxString& file_path); // reads the file written by nc/hbin_writer.py; returns false if it isn't one
 	static void ReadColorsFromConfig();
 	static void WriteColorsToConfig();
 	static void GetOptions(std::list<Property *> *list);
 
+	void CalculateBoxes(); // works out each block's box, and m_box, on several threads
+	double GetArcTolerance(bool select); // in mm, for the current view
+	CNCCodeBlock* Pick(const double* ray_start, const double* ray_direction, unsigned int* move = NULL, double* t = NULL); // returns the block of the move under the mouse, or NULL
 	void DestroyGLLists(void); // not void KillGLLists(void), because I don't want the display list recreated on the Redraw button
-	void SetTextCtrl(wxTextCtrl *textCtrl);
-	void FormatBlocks(wxTextCtrl *textCtrl, int i0, int i1);
-	void HighlightBlock(long pos);
+	void SetListing(COutputListing *listing); // gives each block with text its line, and shows them in the listing
+	void MakePickTree(); // makes m_tree from the moves; call after they have been read
+	long GetNumLines()const{return (long)m_data->m_line_blocks.size();}
+	CNCCodeBlock* GetLineBlock(long line)const{return m_data->m_blocks[m_data->m_line_blocks[line]];}
+	long GetMaxLineLength()const{return m_data->m_max_line_length;}
+	CNCCodeBlock* GetHighlightedBlock()const{return m_highlighted_block;}
 	void SetHighlightedBlock(CNCCodeBlock* block);
 
-	std::list< std::pair<PathObject *, CTool *> > GetPaths() const;
+	std::list< std::pair<unsigned int, CTool *> > GetPaths() const; // indexes into m_path_store
 };
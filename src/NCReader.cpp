@@ -0,0 +1,526 @@
+// NCReader.cpp
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+#include "stdafx.h"
+#include "NCReader.h"
+#include "MappedFile.h"
+#include "OutputCanvas.h"
+
+#include <wx/thread.h>
+
+#include <ctype.h>
+#include <math.h>
+
+// reads a number the way nc/iso_read.py's regular expression does; an optional sign, digits, an optional point and more digits
+// returns p, if there isn't a number there
+static const char* ReadNumber(const char* p, const char* e, double &d)
+{
+	const char* s = p;
+	bool negative = false;
+	if(p < e && (*p == '+' || *p == '-'))
+	{
+		negative = (*p == '-');
+		p++;
+	}
+
+	double v = 0.0;
+	bool digits = false;
+	while(p < e && *p >= '0' && *p <= '9')
+	{
+		v = v * 10.0 + (*p - '0');
+		p++;
+		digits = true;
+	}
+	if(p < e && *p == '.')
+	{
+		p++;
+		double fraction = 0.0;
+		double scale = 1.0;
+		while(p < e && *p >= '0' && *p <= '9')
+		{
+			fraction = fraction * 10.0 + (*p - '0');
+			scale *= 10.0;
+			p++;
+			digits = true;
+		}
+		v += fraction / scale;
+	}
+
+	if(!digits)return s;
+	d = negative ? -v : v;
+	return p;
+}
+
+// ASCII only; isalpha depends on the locale, and a word's letter indexes an array of 26
+static bool IsLetter(char c)
+{
+	return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+}
+
+static bool IsOtherChar(char c)
+{
+	return !IsLetter(c) && c != ' ' && c != '\t' && c != '(' && c != ';' && c != '!' && c != '#' && c != ':';
+}
+
+// files smaller than this are read on one thread
+static const size_t min_chunk_size = 1024 * 1024;
+
+void CNCChunk::AddText(CNCLine &line, const char* s, const char* e, ColorEnum color)
+{
+	m_text_store.Add(s, (unsigned int)(e - s), color);
+	line.m_num_tokens++;
+}
+
+void CNCChunk::AddWord(CNCLine &line, char letter, double value)
+{
+	CNCWord word;
+	word.m_letter = letter;
+	word.m_value = value;
+	m_words.push_back(word);
+	line.m_num_words++;
+}
+
+void CNCChunk::ReadLine(const char* s, const char* e)
+{
+	m_lines.push_back(CNCLine());
+	CNCLine &line = m_lines.back();
+	line.m_first_token = m_text_store.size();
+	line.m_first_word = (unsigned int)m_words.size();
+
+	// split the line into coloured words, like nc/iso_read.py
+	const char* p = s;
+	while(p < e)
+	{
+		const char* start = p;
+		char c = *p;
+		if(c == '(')
+		{
+			while(p < e && *p != ')')p++;
+			if(p < e)p++;
+			AddText(line, start, p, ColorCommentType);
+		}
+		else if(c == ';' || c == '!')
+		{
+			p = e;
+			AddText(line, start, p, ColorCommentType);
+		}
+		else if(c == ' ' || c == '\t')
+		{
+			while(p < e && (*p == ' ' || *p == '\t'))p++;
+			AddText(line, start, p, ColorDefaultType);
+		}
+		else if(c == '#')
+		{
+			p++;
+			while(p < e && isdigit((unsigned char)*p))p++;
+			if(p < e && *p == '=')
+			{
+				double d;
+				p = ReadNumber(p + 1, e, d);
+			}
+			AddText(line, start, p, ColorVariableType);
+		}
+		else if(c == ':')
+		{
+			double d;
+			p = ReadNumber(p + 1, e, d);
+			AddText(line, start, p, ColorBlockType);
+		}
+		else if(IsLetter(c))
+		{
+			char letter = (c >= 'a') ? (char)(c - 'a' + 'A') : c;
+			double d = 0.0;
+			const char* number_end = ReadNumber(p + 1, e, d);
+			if(number_end == p + 1)
+			{
+				// a letter on its own, or a letter followed by a variable
+				p++;
+				if(p < e && *p == '#')
+				{
+					p++;
+					while(p < e && isdigit((unsigned char)*p))p++;
+					AddText(line, start, p, ColorVariableType);
+				}
+				else AddText(line, start, p, ColorDefaultType);
+				continue;
+			}
+			p = number_end;
+
+			ColorEnum color = ColorDefaultType;
+			switch(letter)
+			{
+			case 'G':
+				switch((int)floor(d * 10.0 + 0.5))
+				{
+				case 0:
+					color = ColorRapidType;
+					break;
+				case 10:
+				case 20:
+				case 30:
+				case 120:
+				case 130:
+				case 810:
+				case 820:
+				case 830:
+					color = ColorFeedType;
+					break;
+				default:
+					color = ColorPrepType;
+					break;
+				}
+				break;
+			case 'M':
+				color = ColorMiscType;
+				break;
+			case 'N':
+				color = ColorBlockType;
+				break;
+			case 'O':
+				color = ColorProgramType;
+				break;
+			case 'T':
+				color = ColorToolType;
+				break;
+			case 'A':
+			case 'B':
+			case 'C':
+			case 'F':
+			case 'H':
+			case 'I':
+			case 'J':
+			case 'K':
+			case 'P':
+			case 'Q':
+			case 'R':
+			case 'S':
+			case 'X':
+			case 'Y':
+			case 'Z':
+				color = ColorAxisType;
+				break;
+			}
+
+			AddWord(line, letter, d);
+			AddText(line, start, p, color);
+		}
+		else
+		{
+			while(p < e && IsOtherChar(*p))p++;
+			AddText(line, start, p, ColorDefaultType);
+		}
+	}
+}
+
+void CNCChunk::Read()
+{
+	// the text is all of the chunk, except the line ends
+	m_text_store.m_arena.reserve(m_end - m_begin);
+
+	const char* p = m_begin;
+	while(p < m_end)
+	{
+		const char* line_end = (const char*)memchr(p, '\n', m_end - p);
+		if(line_end == NULL)line_end = m_end;
+		const char* e = line_end;
+		if(e > p && e[-1] == '\r')e--;
+
+		if(e > p)ReadLine(p, e);
+
+		p = line_end + 1;
+	}
+}
+
+class CNCChunkThread : public wxThread
+{
+	CNCChunk* m_chunk;
+
+public:
+	CNCChunkThread(CNCChunk* chunk):wxThread(wxTHREAD_JOINABLE), m_chunk(chunk){}
+
+	ExitCode Entry()
+	{
+		m_chunk->Read();
+		return 0;
+	}
+};
+
+CNCReader::CNCReader():m_motion(0), m_cycle(0), m_absolute(true), m_units(1.0), m_tool_number(0), m_retract_to_initial_z(false), m_initial_z(0.0), m_cycle_r(0.0), m_cycle_z(0.0), m_nc_code(NULL), m_block_index(0)
+{
+	m_x[0] = m_x[1] = m_x[2] = 0.0;
+}
+
+// static
+bool CNCReader::CanRead(const wxString& reader)
+{
+	return reader == _T("iso_read");
+}
+
+void CNCReader::AddLine(const double* x, ColorEnum color)
+{
+	m_nc_code->m_data->m_path_store.AddLine(x, m_tool_number, color, m_block_index);
+	memcpy(m_x, x, 3*sizeof(double));
+}
+
+void CNCReader::AddArc(const double* x, const double* c, int dir)
+{
+	m_nc_code->m_data->m_path_store.AddArc(x, c, dir, m_tool_number, ColorFeedType, m_block_index);
+	memcpy(m_x, x, 3*sizeof(double));
+}
+
+void CNCReader::Drill(const double* x, const bool* got, const double* value)
+{
+	if(got['R' - 'A'])m_cycle_r = m_absolute ? value['R' - 'A'] * m_units : m_initial_z + value['R' - 'A'] * m_units;
+	if(got['Z' - 'A'])m_cycle_z = m_absolute ? value['Z' - 'A'] * m_units : m_cycle_r + value['Z' - 'A'] * m_units;
+	double retract_z = (m_retract_to_initial_z && m_initial_z > m_cycle_r) ? m_initial_z : m_cycle_r;
+
+	// up to the r plane, if below it, across to the hole, down to the r plane, drill, then back up
+	double p[3] = {m_x[0], m_x[1], m_cycle_r};
+	if(m_x[2] < m_cycle_r)AddLine(p, ColorRapidType);
+	p[0] = x[0];
+	p[1] = x[1];
+	p[2] = m_x[2];
+	AddLine(p, ColorRapidType);
+	p[2] = m_cycle_r;
+	if(m_x[2] != m_cycle_r)AddLine(p, ColorRapidType);
+	p[2] = m_cycle_z;
+	AddLine(p, ColorFeedType);
+	p[2] = retract_z;
+	AddLine(p, ColorRapidType);
+}
+
+void CNCReader::DoLine(const CNCWord* words, unsigned int num_words)
+{
+	bool got[26];
+	double value[26];
+	memset(got, 0, sizeof(got));
+	int g_codes[16]; // G codes times ten, so G61.1 is 611
+	int num_g_codes = 0;
+
+	for(unsigned int i = 0; i < num_words; i++)
+	{
+		int letter = words[i].m_letter - 'A';
+		if(letter < 0 || letter >= 26)continue;
+		got[letter] = true;
+		value[letter] = words[i].m_value;
+		if(words[i].m_letter == 'G' && num_g_codes < 16)g_codes[num_g_codes++] = (int)floor(words[i].m_value * 10.0 + 0.5);
+		else if(words[i].m_letter == 'T')m_tool_number = (int)words[i].m_value;
+	}
+
+	// modal G codes
+	bool no_move = false;
+	bool cycle_started = false;
+	for(int i = 0; i < num_g_codes; i++)
+	{
+		switch(g_codes[i])
+		{
+		case 0:
+			m_motion = 0;
+			m_cycle = 0;
+			break;
+		case 10:
+			m_motion = 1;
+			m_cycle = 0;
+			break;
+		case 20:
+		case 120:
+			m_motion = 2;
+			m_cycle = 0;
+			break;
+		case 30:
+		case 130:
+			m_motion = 3;
+			m_cycle = 0;
+			break;
+		case 200:
+		case 700:
+			m_units = 25.4;
+			break;
+		case 210:
+		case 710:
+			m_units = 1.0;
+			break;
+		case 800:
+			m_cycle = 0;
+			break;
+		case 810:
+		case 820:
+		case 830:
+			if(m_cycle == 0)m_initial_z = m_x[2];
+			m_cycle = g_codes[i] / 10;
+			cycle_started = true;
+			break;
+		case 900:
+			m_absolute = true;
+			break;
+		case 910:
+			m_absolute = false;
+			break;
+		case 980:
+			m_retract_to_initial_z = true;
+			break;
+		case 990:
+			m_retract_to_initial_z = false;
+			break;
+		case 40: // dwell
+		case 100: // set offsets
+		case 280: // home
+		case 300:
+		case 530: // machine coordinates
+		case 920: // set position
+			no_move = true;
+			break;
+		}
+	}
+
+	if(no_move)return;
+
+	// where this line moves to
+	double x[3];
+	bool got_axis = false;
+	for(int i = 0; i < 3; i++)
+	{
+		int letter = 'X' - 'A' + i;
+		x[i] = m_x[i];
+		if(got[letter])
+		{
+			got_axis = true;
+			double v = value[letter] * m_units;
+			x[i] = m_absolute ? v : m_x[i] + v;
+		}
+	}
+
+	if(m_cycle)
+	{
+		if(cycle_started || got_axis || got['R' - 'A'])Drill(x, got, value);
+		return;
+	}
+
+	bool got_centre = got['I' - 'A'] || got['J' - 'A'] || got['K' - 'A'] || got['R' - 'A'];
+
+	switch(m_motion)
+	{
+	case 0:
+	case 1:
+		if(got_axis)AddLine(x, (m_motion == 0) ? ColorRapidType : ColorFeedType);
+		break;
+	case 2:
+	case 3:
+		if(got_axis || got_centre)
+		{
+			int dir = (m_motion == 3) ? 1 : -1;
+			double c[3] = {0.0, 0.0, 0.0};
+			if(got['R' - 'A'])
+			{
+				// a positive radius means the shorter way round, a negative one the longer way round
+				double r = value['R' - 'A'] * m_units;
+				double vx = x[0] - m_x[0];
+				double vy = x[1] - m_x[1];
+				double l = sqrt(vx * vx + vy * vy);
+				if(l > 0.0)
+				{
+					double h = r * r - l * l / 4;
+					h = (h > 0.0) ? sqrt(h) : 0.0;
+					if((r < 0) != (dir < 0))h = -h;
+					c[0] = vx / 2 - vy * h / l;
+					c[1] = vy / 2 + vx * h / l;
+				}
+			}
+			else
+			{
+				// the centre is relative to the start point
+				if(got['I' - 'A'])c[0] = value['I' - 'A'] * m_units;
+				if(got['J' - 'A'])c[1] = value['J' - 'A'] * m_units;
+				if(got['K' - 'A'])c[2] = value['K' - 'A'] * m_units;
+			}
+			AddArc(x, c, dir);
+		}
+		break;
+	}
+}
+
+bool CNCReader::Read(const wxString& file_path, CNCCode* nc_code)
+{
+	CMappedFile file(file_path);
+	if(!file.IsOpened())return false;
+
+	// split the file into a chunk for each processor, at line ends
+	const char* data = file.GetData();
+	const char* end = data + file.GetSize();
+	size_t num_chunks = file.GetSize() / min_chunk_size + 1;
+	int cpu_count = wxThread::GetCPUCount();
+	if(cpu_count < 1)cpu_count = 1;
+	if(num_chunks > (size_t)cpu_count)num_chunks = cpu_count;
+
+	std::vector<CNCChunk*> chunks;
+	const char* p = data;
+	for(size_t i = 0; i < num_chunks && p < end; i++)
+	{
+		const char* chunk_end = end;
+		if(i < num_chunks - 1)
+		{
+			chunk_end = data + (end - data) * (i + 1) / num_chunks;
+			if(chunk_end < p)chunk_end = p;
+			const char* line_end = (const char*)memchr(chunk_end, '\n', end - chunk_end);
+			chunk_end = (line_end == NULL) ? end : line_end + 1;
+		}
+		chunks.push_back(new CNCChunk(p, chunk_end));
+		p = chunk_end;
+	}
+
+	// read the first chunk on this thread and the others on their own threads
+	std::vector<CNCChunkThread*> threads;
+	for(size_t i = 1; i < chunks.size(); i++)
+	{
+		CNCChunkThread* thread = new CNCChunkThread(chunks[i]);
+		if(thread->Create() == wxTHREAD_NO_ERROR && thread->Run() == wxTHREAD_NO_ERROR)
+		{
+			threads.push_back(thread);
+		}
+		else
+		{
+			delete thread;
+			chunks[i]->Read();
+		}
+	}
+	if(chunks.size() > 0)chunks[0]->Read();
+	for(std::vector<CNCChunkThread*>::iterator It = threads.begin(); It != threads.end(); It++)
+	{
+		CNCChunkThread* thread = *It;
+		thread->Wait();
+		delete thread;
+	}
+
+	// run the words through the modal state, in order
+	m_nc_code = nc_code;
+	nc_code->Clear();
+	nc_code->m_user_edited = false;
+
+	for(std::vector<CNCChunk*>::iterator It = chunks.begin(); It != chunks.end(); It++)
+	{
+		CNCChunk* chunk = *It;
+		unsigned int first_token = nc_code->m_data->m_text_store.size();
+		nc_code->m_data->m_text_store.Append(chunk->m_text_store);
+		for(std::deque<CNCLine>::iterator LineIt = chunk->m_lines.begin(); LineIt != chunk->m_lines.end(); LineIt++)
+		{
+			CNCLine &line = *LineIt;
+			m_block_index = (unsigned int)nc_code->m_data->m_blocks.size();
+			CNCCodeBlock* block = new CNCCodeBlock(&nc_code->m_data->m_text_store, &nc_code->m_data->m_path_store);
+			block->m_first_token = first_token + line.m_first_token;
+			block->m_num_tokens = line.m_num_tokens;
+			block->m_first_move = nc_code->m_data->m_path_store.size();
+
+			if(line.m_num_words > 0)DoLine(&chunk->m_words[line.m_first_word], line.m_num_words);
+
+			block->m_num_moves = nc_code->m_data->m_path_store.size() - block->m_first_move;
+			nc_code->m_data->m_blocks.push_back(block);
+		}
+		delete chunk;
+	}
+
+	nc_code->SetListing(theApp.m_output_canvas->m_listing);
+	nc_code->MakePickTree();
+
+	return true;
+}
@@ -0,0 +1,84 @@
+// NCReader.h
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+// A built-in reader for ISO ( and EMC2 ) style NC code, which fills in a CNCCode directly.
+// It does the same job as nc/iso_read.py with nc/hxml_writer.py, but without running python.
+//
+// The file is read in two passes.
+// First the file is split into line aligned chunks, which are split into coloured words on separate threads.
+// The words don't depend on the modal state, so the chunks can be read in any order.
+// Then the words are run through the modal state, in order, on one thread, to make the blocks and the moves.
+
+#pragma once
+
+#include "NCCode.h"
+
+#include <deque>
+
+// a letter and its number, for example X12.5
+class CNCWord
+{
+public:
+	char m_letter;
+	double m_value;
+};
+
+// one line of nc code
+class CNCLine
+{
+public:
+	unsigned int m_first_token, m_num_tokens; // range in CNCChunk::m_text_store
+	unsigned int m_first_word, m_num_words; // range in CNCChunk::m_words
+
+	CNCLine():m_first_token(0), m_num_tokens(0), m_first_word(0), m_num_words(0){}
+};
+
+// a line aligned part of the file
+class CNCChunk
+{
+	void ReadLine(const char* s, const char* e);
+	void AddText(CNCLine &line, const char* s, const char* e, ColorEnum color);
+	void AddWord(CNCLine &line, char letter, double value);
+
+public:
+	const char* m_begin;
+	const char* m_end;
+	std::deque<CNCLine> m_lines;
+	TextStore m_text_store;
+	std::vector<CNCWord> m_words;
+
+	CNCChunk(const char* begin, const char* end):m_begin(begin), m_end(end){}
+
+	void Read(); // splits the lines into words; can be called on any thread
+};
+
+class CNCReader
+{
+	// modal state
+	double m_x[3]; // current position, in mm
+	int m_motion; // 0, 1, 2, or 3 for G0, G1, G2, G3
+	int m_cycle; // 81, 82, or 83 while a drilling cycle is active, else 0
+	bool m_absolute;
+	double m_units; // 1.0 for mm, 25.4 for inches
+	int m_tool_number;
+	bool m_retract_to_initial_z; // G98, else G99
+	double m_initial_z; // the z when the drilling cycle started
+	double m_cycle_r; // the drilling cycle's r plane, in mm
+	double m_cycle_z; // the drilling cycle's bottom, in mm
+
+	CNCCode* m_nc_code;
+	unsigned int m_block_index;
+
+	void DoLine(const CNCWord* words, unsigned int num_words);
+	void AddLine(const double* x, ColorEnum color);
+	void AddArc(const double* x, const double* c, int dir);
+	void Drill(const double* x, const bool* got, const double* value);
+
+public:
+	CNCReader();
+
+	static bool CanRead(const wxString& reader); // true, if this can be used instead of the python reader
+
+	bool Read(const wxString& file_path, CNCCode* nc_code); // returns false if the file couldn't be read
+};
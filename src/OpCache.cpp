@@ -0,0 +1,237 @@
+// OpCache.cpp
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+#include "stdafx.h"
+#include "OpCache.h"
+#include "PythonString.h"
+
+#include <wx/stdpaths.h>
+#include <wx/filename.h>
+#include <wx/file.h>
+
+// static
+wxUint64 OpCache::Hash(const void* data, size_t size, wxUint64 hash)
+{
+	const unsigned char* c = (const unsigned char*)data;
+	for(size_t i = 0; i < size; i++)
+	{
+		hash ^= c[i];
+		hash *= wxULL(1099511628211);
+	}
+	return hash;
+}
+
+// static
+wxUint64 OpCache::Hash(const wxString &s, wxUint64 hash)
+{
+	const wxCharBuffer buffer = s.mb_str(wxConvUTF8);
+	return Hash(buffer.data(), strlen(buffer.data()), hash);
+}
+
+// the folders the program's python looks for modules in; see CProgram::RewritePythonProgram
+static void GetPythonFolders(std::list<wxString> &folders)
+{
+#ifdef CMAKE_UNIX
+	#ifdef RUNINPLACE
+	folders.push_back(theApp.GetResFolder() + _T("/"));
+	#else
+	folders.push_back(_T("/usr/lib/heekscnc/"));
+	#endif
+#else
+	folders.push_back(theApp.GetResFolder() + _T("/"));
+#ifndef WIN32
+#ifndef RUNINPLACE
+	folders.push_back(_T("/usr/local/lib/heekscnc/"));
+#endif
+#endif
+#endif
+}
+
+static bool FindModule(const std::list<wxString> &folders, const wxString &name, wxString &path)
+{
+	wxString relative = name;
+	relative.Replace(_T("."), _T("/"));
+	for(std::list<wxString>::const_iterator It = folders.begin(); It != folders.end(); It++)
+	{
+		path = *It + relative + _T(".py");
+		if(wxFileExists(path))return true;
+		path = *It + relative + _T("/__init__.py");
+		if(wxFileExists(path))return true;
+	}
+	return false;
+}
+
+static void HashModules(const std::list<wxString> &folders, const wxString &package, const wxString &python, std::set<wxString> &done, wxUint64 &hash)
+{
+	size_t start = 0;
+	while(start < python.Len())
+	{
+		size_t end = python.find(_T('\n'), start);
+		if(end == wxString::npos)end = python.Len();
+		wxString line = python.Mid(start, end - start);
+		start = end + 1;
+
+		wxString names;
+		line.Trim(false);
+		if(line.StartsWith(_T("import "), &names)){}
+		else if(line.StartsWith(_T("from "), &names))names = names.BeforeFirst(_T(' '));
+		else continue;
+
+		while(names.Len() > 0)
+		{
+			wxString name = names.BeforeFirst(_T(','));
+			names = names.AfterFirst(_T(','));
+			name.Trim(false);
+			name = name.BeforeFirst(_T(' ')); // without " as ..."
+			name.Trim();
+			if(name.Len() == 0)continue;
+
+			// python 2 looks in the importing module's package first
+			wxString full_name = package.Len() > 0 ? (package + _T(".") + name) : name;
+			wxString path;
+			if(!FindModule(folders, full_name, path))
+			{
+				full_name = name;
+				if(!FindModule(folders, full_name, path))continue; // not a python file, like math or area
+			}
+			if(done.find(full_name) != done.end())continue;
+			done.insert(full_name);
+
+			wxFile file(path);
+			if(!file.IsOpened())continue;
+			wxFileOffset length = file.Length();
+			std::string contents;
+			if(length > 0)
+			{
+				contents.resize((size_t)length);
+				if(file.Read(&contents[0], (size_t)length) != length)contents.clear();
+			}
+			hash = OpCache::Hash(full_name, hash);
+			hash = OpCache::Hash(contents.c_str(), contents.size(), hash);
+
+			wxString module_package = path.EndsWith(_T("__init__.py")) ? full_name : full_name.BeforeLast(_T('.'));
+			HashModules(folders, module_package, wxString::From8BitData(contents.c_str(), contents.size()), done, hash);
+		}
+	}
+}
+
+// static
+wxUint64 OpCache::HashImports(const wxString &python, wxUint64 hash)
+{
+	// so the NC code isn't used again when the post module, or one of the helpers, has been edited
+	std::list<wxString> folders;
+	GetPythonFolders(folders);
+	std::set<wxString> done;
+	HashModules(folders, wxEmptyString, python, done, hash);
+	return hash;
+}
+
+// static
+wxString OpCache::GetFolder()
+{
+	if(theApp.m_keep_op_cache_with_file && heeksCAD->GetProjectFileName().IsOk())
+	{
+		return heeksCAD->GetProjectFileName().GetPath(wxPATH_GET_SEPARATOR) + heeksCAD->GetProjectFileName().GetName() + _T(".nccache");
+	}
+
+#if wxCHECK_VERSION(3, 0, 0)
+	wxStandardPaths& standard_paths = wxStandardPaths::Get();
+#else
+	wxStandardPaths standard_paths;
+#endif
+	return wxFileName(standard_paths.GetTempDir(), _T("heekscnc_nccache")).GetFullPath();
+}
+
+// static
+void OpCache::WriteBegin(Python &python)
+{
+	python << _T("import nc.opcache as opcache\n");
+	python << _T("opcache.folder = ") << PythonString(GetFolder()) << _T("\n");
+}
+
+// static
+wxString OpCache::KeyString(wxUint64 key)
+{
+	return wxString::Format(_T("%08x%08x"), (unsigned int)(key >> 32), (unsigned int)(key & 0xffffffff));
+}
+
+// static
+bool OpCache::WriteBlock(Python &python, const Python &op_python, wxUint64 key)
+{
+	// the python is indented, which would change any strings over more than one line, so those are left as they are
+	if(op_python.Find(_T("'''")) != wxNOT_FOUND || op_python.Find(_T("\"\"\"")) != wxNOT_FOUND)
+	{
+		python << op_python;
+		return false;
+	}
+
+	python << _T("if not opcache.begin('") << KeyString(key) << _T("'):\n");
+	size_t start = 0;
+	while(start < op_python.Len())
+	{
+		size_t end = op_python.find(_T('\n'), start);
+		if(end == wxString::npos)end = op_python.Len();
+		python << _T("    ") << op_python.Mid(start, end - start) << _T("\n");
+		start = end + 1;
+	}
+	python << _T("    opcache.end()\n");
+	return true;
+}
+
+// static
+wxString OpCache::GetJobFilePath(int i)
+{
+#if wxCHECK_VERSION(3, 0, 0)
+	wxStandardPaths& standard_paths = wxStandardPaths::Get();
+#else
+	wxStandardPaths standard_paths;
+#endif
+	return wxFileName(standard_paths.GetTempDir(), wxString::Format(_T("post_op%d.py"), i + 1)).GetFullPath();
+}
+
+// static
+wxString OpCache::GetJobListFilePath()
+{
+#if wxCHECK_VERSION(3, 0, 0)
+	wxStandardPaths& standard_paths = wxStandardPaths::Get();
+#else
+	wxStandardPaths standard_paths;
+#endif
+	return wxFileName(standard_paths.GetTempDir(), _T("post_ops.txt")).GetFullPath();
+}
+
+// static
+void OpCache::WriteJob(int i, const Python &header, const PythonRope &definitions, const Python &op_python, wxUint64 key)
+{
+	PythonWriter writer(GetJobFilePath(i));
+	writer << header;
+	writer << definitions;
+	writer << _T("opcache.record_begin()\n");
+	writer << op_python;
+	writer << _T("opcache.record_end('") << KeyString(key) << _T("')\n");
+}
+
+// static
+void OpCache::WriteRunJobs(Python &python)
+{
+	python << _T("opcache.run_jobs(opcache.read_jobs(") << PythonString(GetJobListFilePath()) << _T("))\n");
+}
+
+// static
+void OpCache::WriteJobList(const std::list<wxString> &keys)
+{
+	// a line for each job; its key, then its file path
+	PythonWriter writer(GetJobListFilePath());
+	int i = 0;
+	for(std::list<wxString>::const_iterator It = keys.begin(); It != keys.end(); It++, i++)
+	{
+		writer << *It << _T("\t") << GetJobFilePath(i) << _T("\n");
+	}
+}
+
+// static
+void OpCache::WriteEnd(Python &python)
+{
+	python << _T("opcache.finish()\n");
+}
@@ -0,0 +1,38 @@
+// OpCache.h
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+// Writes the python which lets nc/opcache.py keep the NC code made by each operation, so when the program is post-processed again,
+// only the operations which have changed are run, and the NC code of the others is used again.
+// Each operation's python is put in a block, which is only run if there's no NC code kept for its key.
+// The key is a hash of the python before the operations, the patterns and surfaces the operation uses, and the operation's own python,
+// with the python files they import, like the post module, iso.py and kurve_funcs.py; opcache.py adds the state the operation starts from.
+// With m_op_cache_parallel, each changed operation, without a surface or a pattern, is also run first, at the same time as the others, in its own python, from the state at the
+// start of the operations. Its calls to the creator are kept, then the program gives them to its own creator, which writes the NC code
+// as if the operation had been run there, with the modal words and tool changes for where the program is. If the operation looked at the creator,
+// and the program's creator doesn't give the same answers, the operation is run again by the program.
+
+#pragma once
+
+class Python;
+class PythonRope;
+
+class OpCache
+{
+public:
+	static wxUint64 Hash(const void* data, size_t size, wxUint64 hash = wxULL(14695981039346656037)); // FNV-1a
+	static wxUint64 Hash(const wxString &s, wxUint64 hash = wxULL(14695981039346656037));
+	static wxUint64 HashImports(const wxString &python, wxUint64 hash); // the contents of the python files python imports, and the ones they import
+
+	static wxString GetFolder(); // where the NC code is kept; with the .heeks file, if m_keep_op_cache_with_file, otherwise in the temp folder
+	static void WriteBegin(Python &python); // after the imports
+	static bool WriteBlock(Python &python, const Python &op_python, wxUint64 key); // returns false if op_python couldn't be put in a block
+	static wxString KeyString(wxUint64 key);
+
+	static wxString GetJobFilePath(int i);
+	static wxString GetJobListFilePath();
+	static void WriteJob(int i, const Python &header, const PythonRope &definitions, const Python &op_python, wxUint64 key); // header is the program's python before the operations
+	static void WriteRunJobs(Python &python); // before the operations
+	static void WriteJobList(const std::list<wxString> &keys); // the keys of the jobs written, for WriteRunJobs's python to read
+	static void WriteEnd(Python &python); // after program_end
+};
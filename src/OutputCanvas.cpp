@@ -10,54 +10,491 @@
 #include "Program.h"
 #include "NCCode.h"
 
-BEGIN_EVENT_TABLE(COutputTextCtrl, wxTextCtrl)
-    EVT_MOUSE_EVENTS(COutputTextCtrl::OnMouse)
-	EVT_PAINT(COutputTextCtrl::OnPaint)
+#include <wx/clipbrd.h>
+#include <wx/gauge.h>
+#include <wx/numdlg.h>
+
+enum
+{
+	ID_LISTING_GOTO_LINE = wxID_HIGHEST + 1,
+	ID_LISTING_FIND_NEXT,
+	ID_LISTING_EDIT
+};
+
+BEGIN_EVENT_TABLE(COutputListing, wxScrolledWindow)
+	EVT_MOUSE_EVENTS(COutputListing::OnMouse)
+	EVT_KEY_DOWN(COutputListing::OnKeyDown)
+	EVT_MENU(ID_LISTING_GOTO_LINE, COutputListing::OnMenuGotoLine)
+	EVT_MENU(wxID_FIND, COutputListing::OnMenuFind)
+	EVT_MENU(ID_LISTING_FIND_NEXT, COutputListing::OnMenuFindNext)
+	EVT_MENU(wxID_COPY, COutputListing::OnMenuCopy)
+	EVT_MENU(ID_LISTING_EDIT, COutputListing::OnMenuEdit)
 END_EVENT_TABLE()
 
-void COutputTextCtrl::OnMouse( wxMouseEvent& event )
+COutputListing::COutputListing(wxWindow* parent)
+	: wxScrolledWindow(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxHSCROLL | wxVSCROLL | wxWANTS_CHARS)
+	, m_show_nc_code(false)
+	, m_font(10, wxFONTFAMILY_TELETYPE, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false, _T("Lucida Console"), wxFONTENCODING_SYSTEM)
+	, m_anchor_line(-1)
+	, m_caret_line(-1)
 {
-	if(event.LeftUp())
+	SetBackgroundColour(*wxWHITE);
+
+	wxClientDC dc(this);
+	dc.SetFont(m_font);
+	m_line_height = dc.GetCharHeight();
+	m_char_width = dc.GetCharWidth();
+	if(m_line_height < 1)m_line_height = 1;
+	if(m_char_width < 1)m_char_width = 1;
+
+	SetScrollbarsForLines(NULL);
+}
+
+CNCCode* COutputListing::GetNCCode()const
+{
+	if(m_show_nc_code && theApp.m_program)return theApp.m_program->NCCode();
+	return NULL;
+}
+
+long COutputListing::GetNumberOfNCLines()const
+{
+	CNCCode* nc_code = GetNCCode();
+	return nc_code ? nc_code->GetNumLines() : 0;
+}
+
+long COutputListing::GetNumberOfLines()const
+{
+	return GetNumberOfNCLines() + (long)m_messages.size();
+}
+
+wxString COutputListing::GetLineText(long line)const
+{
+	long nc_lines = GetNumberOfNCLines();
+	if(line < 0)return wxString();
+	if(line < nc_lines)
+	{
+		CNCCodeBlock* block = GetNCCode()->GetLineBlock(line);
+		wxString str;
+		block->m_text_store->AppendString(block->m_first_token, block->m_num_tokens, str);
+		return str;
+	}
+	if(line - nc_lines < (long)m_messages.size())return m_messages[line - nc_lines];
+	return wxString();
+}
+
+wxString COutputListing::GetText()const
+{
+	wxString str;
+	long num_lines = GetNumberOfLines();
+	for(long line = 0; line < num_lines; line++)
+	{
+		str.append(GetLineText(line));
+		str.append(_T("\n"));
+	}
+	return str;
+}
+
+wxString COutputListing::GetNCText()const
+{
+	wxString str;
+	long nc_lines = GetNumberOfNCLines();
+	for(long line = 0; line < nc_lines; line++)
+	{
+		str.append(GetLineText(line));
+		str.append(_T("\n"));
+	}
+	return str;
+}
+
+void COutputListing::SetScrollbarsForLines(CNCCode* nc_code)
+{
+	long width = nc_code ? nc_code->GetMaxLineLength() : 0;
+	long num_lines = nc_code ? nc_code->GetNumLines() : 0;
+	for(std::vector<wxString>::iterator It = m_messages.begin(); It != m_messages.end(); It++)
 	{
-		wxTextPos pos = GetInsertionPoint();
-		if(theApp.m_program && theApp.m_program->NCCode())
+		long length = (long)It->Len();
+		if(length > width)width = length;
+		num_lines++;
+	}
+
+	int view_x, view_y;
+	GetViewStart(&view_x, &view_y);
+	if(view_y > num_lines)view_y = num_lines;
+	SetScrollbars(m_char_width, m_line_height, width + 1, num_lines, view_x, view_y);
+}
+
+void COutputListing::Clear()
+{
+	m_show_nc_code = false;
+	m_messages.clear();
+	m_anchor_line = -1;
+	m_caret_line = -1;
+	Scroll(0, 0);
+	SetScrollbarsForLines(NULL);
+	Refresh();
+}
+
+void COutputListing::ShowNCCode(CNCCode* nc_code)
+{
+	theApp.m_output_canvas->StopEditing(); // the text being edited was of the old nc code
+	m_show_nc_code = true;
+	m_anchor_line = -1;
+	m_caret_line = -1;
+	Scroll(0, 0);
+	SetScrollbarsForLines(nc_code);
+	Refresh();
+}
+
+void COutputListing::AddMessage(const wxString& str)
+{
+	m_messages.push_back(str);
+	SetScrollbarsForLines(GetNCCode());
+	Refresh();
+}
+
+void COutputListing::OnDraw(wxDC& dc)
+{
+	CNCCode* nc_code = GetNCCode();
+	long nc_lines = nc_code ? nc_code->GetNumLines() : 0;
+	long num_lines = nc_lines + (long)m_messages.size();
+
+	// only draw the lines which can be seen
+	int view_x, view_y;
+	GetViewStart(&view_x, &view_y);
+	int width, height;
+	GetClientSize(&width, &height);
+	long first_line = view_y;
+	long last_line = first_line + height / m_line_height + 1;
+	if(last_line >= num_lines)last_line = num_lines - 1;
+	int line_width = GetVirtualSize().x;
+	if(line_width < width + view_x * m_char_width)line_width = width + view_x * m_char_width;
+
+	// look up the colours once, rather than for each word
+	wxColour colours[MaxColorTypes];
+	for(int i = 0; i < MaxColorTypes; i++)
+	{
+		if(i < CNCCode::ColorCount())
+		{
+			HeeksColor &col = CNCCode::Color((ColorEnum)i);
+			colours[i] = wxColour(col.red, col.green, col.blue);
+		}
+		else colours[i] = *wxBLACK;
+	}
+	wxColour highlight_colour(218, 242, 142);
+	wxColour selection_colour = wxSystemSettings::GetColour(wxSYS_COLOUR_HIGHLIGHT);
+	wxColour selection_text_colour = wxSystemSettings::GetColour(wxSYS_COLOUR_HIGHLIGHTTEXT);
+	long selection_first = (m_anchor_line < m_caret_line) ? m_anchor_line : m_caret_line;
+	long selection_last = (m_anchor_line < m_caret_line) ? m_caret_line : m_anchor_line;
+	CNCCodeBlock* highlighted_block = nc_code ? nc_code->GetHighlightedBlock() : NULL;
+
+	dc.SetFont(m_font);
+	dc.SetBackgroundMode(wxTRANSPARENT);
+	dc.SetPen(*wxTRANSPARENT_PEN);
+
+	for(long line = first_line; line <= last_line; line++)
+	{
+		int y = (int)(line * m_line_height);
+		bool selected = (m_anchor_line >= 0 && line >= selection_first && line <= selection_last);
+		CNCCodeBlock* block = (line < nc_lines) ? nc_code->GetLineBlock(line) : NULL;
+
+		if(selected || (block && block == highlighted_block))
 		{
-			theApp.m_program->NCCode()->HighlightBlock(pos);
-			heeksCAD->Repaint();
+			dc.SetBrush(wxBrush(selected ? selection_colour : highlight_colour));
+			dc.DrawRectangle(0, y, line_width, m_line_height);
+		}
+
+		if(block)
+		{
+			int x = 0;
+			const TextStore* text_store = block->m_text_store;
+			for(unsigned int i = block->m_first_token; i < block->m_first_token + block->m_num_tokens; i++)
+			{
+				int color_type = (text_store->GetColor(i) < MaxColorTypes) ? text_store->GetColor(i) : ColorDefaultType;
+				wxString str = text_store->GetString(i);
+				dc.SetTextForeground(selected ? selection_text_colour : colours[color_type]);
+				dc.DrawText(str, x, y);
+				wxCoord w, h;
+				dc.GetTextExtent(str, &w, &h);
+				x += w;
+			}
+		}
+		else
+		{
+			dc.SetTextForeground(selected ? selection_text_colour : colours[ColorDefaultType]);
+			dc.DrawText(m_messages[line - nc_lines], 0, y);
 		}
 	}
+}
+
+long COutputListing::LineFromPoint(const wxPoint& point)
+{
+	long num_lines = GetNumberOfLines();
+	if(num_lines == 0)return -1;
+
+	int x, y;
+	CalcUnscrolledPosition(point.x, point.y, &x, &y);
+	long line = y / m_line_height;
+	if(line < 0)line = 0;
+	if(line >= num_lines)line = num_lines - 1;
+	return line;
+}
+
+void COutputListing::SelectLine(long line, bool extend)
+{
+	if(line < 0)return;
+	m_caret_line = line;
+	if(!extend || m_anchor_line < 0)m_anchor_line = line;
+
+	// scroll, if the line can't be seen
+	int view_x, view_y;
+	GetViewStart(&view_x, &view_y);
+	int width, height;
+	GetClientSize(&width, &height);
+	long lines_visible = height / m_line_height;
+	if(lines_visible < 1)lines_visible = 1;
+	if(line < view_y)Scroll(-1, line);
+	else if(line >= view_y + lines_visible)Scroll(-1, line - lines_visible + 1);
+
+	Refresh();
+}
+
+void COutputListing::HighlightLineBlock(long line)
+{
+	CNCCode* nc_code = GetNCCode();
+	if(nc_code == NULL || line < 0 || line >= nc_code->GetNumLines())return;
+	nc_code->SetHighlightedBlock(nc_code->GetLineBlock(line));
+	heeksCAD->Repaint();
+}
+
+void COutputListing::ShowLine(long line)
+{
+	if(line < 0 || line >= GetNumberOfLines())return;
+	SelectLine(line, false);
+}
+
+void COutputListing::GotoLine(long line)
+{
+	long num_lines = GetNumberOfLines();
+	if(num_lines == 0)return;
+	if(line < 0)line = 0;
+	if(line >= num_lines)line = num_lines - 1;
+	SelectLine(line, false);
+	HighlightLineBlock(line);
+}
+
+bool COutputListing::Find(const wxString& str, long from_line)
+{
+	long num_lines = GetNumberOfLines();
+	if(num_lines == 0 || str.IsEmpty())return false;
+	if(from_line < 0 || from_line >= num_lines)from_line = 0;
+
+	wxString upper_str = str.Upper();
+	for(long i = 0; i < num_lines; i++)
+	{
+		long line = (from_line + i) % num_lines;
+		if(GetLineText(line).Upper().Find(upper_str) != wxNOT_FOUND)
+		{
+			GotoLine(line);
+			return true;
+		}
+	}
+	return false;
+}
+
+void COutputListing::CopySelection()
+{
+	if(m_anchor_line < 0)return;
+	long first = (m_anchor_line < m_caret_line) ? m_anchor_line : m_caret_line;
+	long last = (m_anchor_line < m_caret_line) ? m_caret_line : m_anchor_line;
+
+	wxString str;
+	for(long line = first; line <= last; line++)
+	{
+		str.append(GetLineText(line));
+		str.append(_T("\n"));
+	}
+
+	if(wxTheClipboard->Open())
+	{
+		wxTheClipboard->SetData(new wxTextDataObject(str));
+		wxTheClipboard->Close();
+	}
+}
+
+void COutputListing::OnMouse( wxMouseEvent& event )
+{
+	if(event.LeftDown())
+	{
+		SetFocus();
+		SelectLine(LineFromPoint(event.GetPosition()), event.ShiftDown());
+	}
+	else if(event.Dragging() && event.LeftIsDown())
+	{
+		SelectLine(LineFromPoint(event.GetPosition()), true);
+	}
+	else if(event.LeftUp())
+	{
+		HighlightLineBlock(m_caret_line);
+	}
+	else if(event.RightUp())
+	{
+		wxMenu menu;
+		menu.Append(wxID_COPY, _("Copy"));
+		menu.AppendSeparator();
+		menu.Append(wxID_FIND, _("Find..."));
+		menu.Append(ID_LISTING_FIND_NEXT, _("Find Next"));
+		menu.Append(ID_LISTING_GOTO_LINE, _("Go To Line..."));
+		menu.AppendSeparator();
+		menu.Append(ID_LISTING_EDIT, _("Edit NC Code"));
+		PopupMenu(&menu, event.GetPosition());
+	}
 
 	event.Skip();
 }
 
-bool painting = false;
-void COutputTextCtrl::OnPaint(wxPaintEvent& event)
+void COutputListing::OnKeyDown(wxKeyEvent& event)
 {
-	// this is here to Format the text ( which seems to be slow in Windows, if all done at once in CNCCode::SetTextCtrl )
-	// OnPaint doesn't seem to get called from Linux, though
-	wxPaintDC dc(this);
+	int width, height;
+	GetClientSize(&width, &height);
+	long page = height / m_line_height;
+	if(page < 1)page = 1;
+	long line = m_caret_line;
 
-	if (!painting && theApp.m_program && theApp.m_program->NCCode())
+	switch(event.GetKeyCode())
 	{
-		painting = true;
+	case WXK_UP:
+		line--;
+		break;
+	case WXK_DOWN:
+		line++;
+		break;
+	case WXK_PAGEUP:
+		line -= page;
+		break;
+	case WXK_PAGEDOWN:
+		line += page;
+		break;
+	case WXK_HOME:
+		line = 0;
+		break;
+	case WXK_END:
+		line = GetNumberOfLines() - 1;
+		break;
+	case WXK_F3:
+		Find(m_find_string, m_caret_line + 1);
+		return;
+	default:
+		if(event.ControlDown())
+		{
+			wxCommandEvent dummy;
+			switch(event.GetKeyCode())
+			{
+			case 'C':
+				OnMenuCopy(dummy);
+				return;
+			case 'F':
+				OnMenuFind(dummy);
+				return;
+			case 'G':
+				OnMenuGotoLine(dummy);
+				return;
+			}
+		}
+		event.Skip();
+		return;
+	}
 
-		wxSize size = GetClientSize();
-		int scrollpos = GetScrollPos(wxVERTICAL);
-		wxLogDebug(_T("%i"), scrollpos);
+	long num_lines = GetNumberOfLines();
+	if(num_lines == 0)return;
+	if(line < 0)line = 0;
+	if(line >= num_lines)line = num_lines - 1;
+	SelectLine(line, event.ShiftDown());
+	HighlightLineBlock(line);
+}
 
-		wxTextCoord col0, row0, col1, row1;
-		HitTest(wxPoint(0,0),      &col0, &row0);
-		HitTest(wxPoint(0,0)+size, &col1, &row1);
+void COutputListing::OnMenuGotoLine(wxCommandEvent& event)
+{
+	long num_lines = GetNumberOfLines();
+	if(num_lines == 0)return;
+	long line = wxGetNumberFromUser(_("Line number"), wxEmptyString, _("Go To Line"), m_caret_line + 1, 1, num_lines, this);
+	if(line > 0)GotoLine(line - 1);
+}
 
-		int pos0 = XYToPosition(0, row0);
-		int pos1 = XYToPosition(1, row1);
+void COutputListing::OnMenuFind(wxCommandEvent& event)
+{
+	wxString str = wxGetTextFromUser(_("Find what"), _("Find"), m_find_string, this);
+	if(str.IsEmpty())return;
+	m_find_string = str;
+	if(!Find(m_find_string, m_caret_line + 1))wxMessageBox(_("Not found"));
+}
+
+void COutputListing::OnMenuFindNext(wxCommandEvent& event)
+{
+	if(m_find_string.IsEmpty())OnMenuFind(event);
+	else if(!Find(m_find_string, m_caret_line + 1))wxMessageBox(_("Not found"));
+}
+
+void COutputListing::OnMenuCopy(wxCommandEvent& event)
+{
+	CopySelection();
+}
+
+void COutputListing::OnMenuEdit(wxCommandEvent& event)
+{
+	theApp.m_output_canvas->StartEditing();
+}
+
+BEGIN_EVENT_TABLE(COutputTextCtrl, wxTextCtrl)
+    EVT_MOUSE_EVENTS(COutputTextCtrl::OnMouse)
+	EVT_TEXT(wxID_ANY, COutputTextCtrl::OnText)
+END_EVENT_TABLE()
+
+CNCCodeBlock* COutputTextCtrl::GetLineBlock(long line)
+{
+	CNCCode* nc_code = theApp.m_program ? theApp.m_program->NCCode() : NULL;
+	if(nc_code == NULL || line < 0 || line >= nc_code->GetNumLines())return NULL;
+
+	// the text ends with a new line, so there may be an empty line after the nc code's lines
+	long num_lines = GetNumberOfLines();
+	if(num_lines != nc_code->GetNumLines() && num_lines != nc_code->GetNumLines() + 1)return NULL;
+	return nc_code->GetLineBlock(line);
+}
+
+void COutputTextCtrl::ShowLine(long line)
+{
+	if(line < 0 || line >= GetNumberOfLines())return;
+	long from_pos = XYToPosition(0, line);
+	ShowPosition(from_pos);
+	SetSelection(from_pos, from_pos + GetLineLength(line));
+}
 
-		theApp.m_program->NCCode()->FormatBlocks(this, pos0, pos1);
+void COutputTextCtrl::OnMouse( wxMouseEvent& event )
+{
+	if(event.LeftUp())
+	{
+		long x, y;
+		if(PositionToXY(GetInsertionPoint(), &x, &y))
+		{
+			CNCCodeBlock* block = GetLineBlock(y);
+			if(block)
+			{
+				theApp.m_program->NCCode()->SetHighlightedBlock(block);
+				heeksCAD->Repaint();
+			}
+		}
+	}
 
-		SetScrollPos(wxVERTICAL, scrollpos);
+	event.Skip();
+}
 
-		painting = false;
+void COutputTextCtrl::OnText( wxCommandEvent& event )
+{
+	// only the user's typing sets the modified flag; StartEditing doesn't
+	if(IsModified() && theApp.m_program && theApp.m_program->NCCode())
+	{
+		theApp.m_program->NCCode()->m_user_edited = true;
 	}
+
 	event.Skip();
 }
 
@@ -70,7 +507,10 @@ COutputCanvas::COutputCanvas(wxWindow* parent)
         : wxScrolledWindow(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize,
                            wxHSCROLL | wxVSCROLL | wxNO_FULL_REPAINT_ON_RESIZE)
 {
+	m_listing = new COutputListing(this);
 	m_textCtrl = new COutputTextCtrl( this, 100, _T(""),	wxPoint(180,170), wxSize(200,70), wxTE_MULTILINE | wxTE_DONTWRAP | wxTE_RICH | wxTE_RICH2);
+	m_textCtrl->SetFont(wxFont(10, wxFONTFAMILY_TELETYPE, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false, _T("Lucida Console"), wxFONTENCODING_SYSTEM));
+	m_textCtrl->Hide();
 
 #ifdef WIN32
 	// Ensure the wxTextCtrl object can accept the maximum 
@@ -95,12 +535,56 @@ void COutputCanvas::OnSize(wxSizeEvent& event)
 void COutputCanvas::Resize()
 {
 	wxSize size = GetClientSize();
+	m_listing->SetSize(0, 0, size.x, size.y);
 	m_textCtrl->SetSize(0, 0, size.x, size.y);
 }
 
 void COutputCanvas::Clear()
 {
+	StopEditing();
+	m_listing->Clear();
+}
+
+void COutputCanvas::StartEditing()
+{
+	if(IsEditing())return;
+	m_textCtrl->ChangeValue(m_listing->GetNCText());
+	m_textCtrl->DiscardEdits();
+	m_listing->Hide();
+	m_textCtrl->Show();
+	m_textCtrl->SetFocus();
+}
+
+void COutputCanvas::SetEditedText(const wxString& text)
+{
+	StartEditing();
+	m_textCtrl->ChangeValue(text);
+	m_textCtrl->DiscardEdits();
+}
+
+void COutputCanvas::StopEditing()
+{
+	if(!IsEditing())return;
+	m_textCtrl->Hide();
 	m_textCtrl->Clear();
+	m_listing->Show();
+}
+
+bool COutputCanvas::IsEditing()const
+{
+	return m_textCtrl->IsShown();
+}
+
+wxString COutputCanvas::GetText()const
+{
+	if(IsEditing())return m_textCtrl->GetValue();
+	return m_listing->GetNCText();
+}
+
+void COutputCanvas::ShowLine(long line)
+{
+	if(!IsEditing())m_listing->ShowLine(line);
+	else if(m_textCtrl->GetLineBlock(line))m_textCtrl->ShowLine(line);
 }
 
 
@@ -114,6 +598,10 @@ CPrintCanvas::CPrintCanvas(wxWindow* parent)
                            wxHSCROLL | wxVSCROLL | wxNO_FULL_REPAINT_ON_RESIZE)
 {
 	m_textCtrl = new wxTextCtrl( this, 100, _T(""),	wxPoint(180,170), wxSize(200,70), wxTE_MULTILINE | wxTE_DONTWRAP | wxTE_RICH | wxTE_RICH2);
+	m_gauge = new wxGauge(this, wxID_ANY, 1000);
+	m_progress_text = new wxStaticText(this, wxID_ANY, _T(""));
+	m_gauge->Hide();
+	m_progress_text->Hide();
 
 #ifdef WIN32
 	// Ensure the wxTextCtrl object can accept the maximum 
@@ -138,7 +626,16 @@ void CPrintCanvas::OnSize(wxSizeEvent& event)
 void CPrintCanvas::Resize()
 {
 	wxSize size = GetClientSize();
-	m_textCtrl->SetSize(0, 0, size.x, size.y);
+	int top = 0;
+	if(m_gauge->IsShown())
+	{
+		// the gauge on the left, with the text after it
+		top = m_gauge->GetBestSize().y;
+		int gauge_width = size.x / 3;
+		m_gauge->SetSize(0, 0, gauge_width, top);
+		m_progress_text->SetSize(gauge_width + 4, 0, size.x - gauge_width - 4, top);
+	}
+	m_textCtrl->SetSize(0, top, size.x, size.y - top);
 }
 
 void CPrintCanvas::Clear()
@@ -146,3 +643,23 @@ void CPrintCanvas::Clear()
 	m_textCtrl->Clear();
 }
 
+void CPrintCanvas::ShowProgress(double fraction, const wxString& text)
+{
+	m_gauge->SetValue((int)(fraction * 1000));
+	m_progress_text->SetLabel(text);
+	if(!m_gauge->IsShown())
+	{
+		m_gauge->Show();
+		m_progress_text->Show();
+		Resize();
+	}
+}
+
+void CPrintCanvas::HideProgress()
+{
+	if(!m_gauge->IsShown())return;
+	m_gauge->Hide();
+	m_progress_text->Hide();
+	Resize();
+}
+
@@ -7,13 +7,69 @@
 
 #pragma once
 
+class CNCCode;
+class CNCCodeBlock;
+
+// An owner drawn, read only listing of the nc code.
+// It only draws the lines which can be seen, straight from the CNCCodeBlock objects, so it doesn't get slower as the program gets longer.
+// Each CNCCodeBlock with text is one line; any messages, such as errors from the post processor, are listed after the nc code.
+class COutputListing: public wxScrolledWindow
+{
+	bool m_show_nc_code; // the nc code shown is theApp.m_program's
+	std::vector<wxString> m_messages;
+	wxFont m_font;
+	int m_line_height, m_char_width;
+	long m_anchor_line, m_caret_line; // the selected lines are the ones between these; -1 if nothing is selected
+	wxString m_find_string;
+
+	CNCCode* GetNCCode()const;
+	long GetNumberOfNCLines()const;
+	void SetScrollbarsForLines(CNCCode* nc_code);
+	long LineFromPoint(const wxPoint& point);
+	void SelectLine(long line, bool extend);
+	void HighlightLineBlock(long line);
+
+public:
+	COutputListing(wxWindow* parent);
+
+	void Clear();
+	void ShowNCCode(CNCCode* nc_code);
+	void AddMessage(const wxString& str);
+	wxString GetNCText()const; // just the nc code's lines, without the messages
+
+	long GetNumberOfLines()const;
+	wxString GetLineText(long line)const;
+	wxString GetText()const; // all the lines, each with a new line at the end
+	void ShowLine(long line); // scrolls to the line and selects it
+	void GotoLine(long line); // selects the line and highlights its block in the graphics
+	bool Find(const wxString& str, long from_line); // selects the next line containing str, from from_line, wrapping round
+	void CopySelection();
+
+	void OnDraw(wxDC& dc);
+	void OnMouse(wxMouseEvent& event);
+	void OnKeyDown(wxKeyEvent& event);
+	void OnMenuGotoLine(wxCommandEvent& event);
+	void OnMenuFind(wxCommandEvent& event);
+	void OnMenuFindNext(wxCommandEvent& event);
+	void OnMenuCopy(wxCommandEvent& event);
+	void OnMenuEdit(wxCommandEvent& event);
+
+	DECLARE_NO_COPY_CLASS(COutputListing)
+	DECLARE_EVENT_TABLE()
+};
+
+// The nc code as text, for the user to edit; shown instead of the listing, while they are editing it.
+// Each line is still the line of the same block, for as long as no lines have been added or removed.
 class COutputTextCtrl: public wxTextCtrl
 {
 public:
     COutputTextCtrl(wxWindow *parent, wxWindowID id, const wxString &value, const wxPoint &pos, const wxSize &size, int style = 0): wxTextCtrl(parent, id, value, pos, size, style){}
 
+	CNCCodeBlock* GetLineBlock(long line); // NULL, if the lines don't match the nc code's any more
+	void ShowLine(long line);
+
     void OnMouse( wxMouseEvent& event );
-	void OnPaint(wxPaintEvent& event);
+	void OnText( wxCommandEvent& event );
 
     DECLARE_NO_COPY_CLASS(COutputTextCtrl)
     DECLARE_EVENT_TABLE()
@@ -25,12 +81,19 @@ private:
     void Resize();
 
 public:
-    COutputTextCtrl *m_textCtrl;
+    COutputListing *m_listing;
+    COutputTextCtrl *m_textCtrl; // only shown while the nc code is being edited
 
     COutputCanvas(wxWindow* parent);
 	virtual ~COutputCanvas(){}
 
 	void Clear();
+	void StartEditing(); // shows the nc code in m_textCtrl, instead of the listing
+	void SetEditedText(const wxString& text); // the user's edits, read from a file
+	void StopEditing(); // goes back to the listing; any edits are lost
+	bool IsEditing()const;
+	wxString GetText()const; // the nc code, with the user's edits, for saving and sending to the machine
+	void ShowLine(long line); // in the listing, or in the text being edited
 
     void OnSize(wxSizeEvent& event);
 	void OnLengthExceeded(wxCommandEvent& event);
@@ -47,11 +110,15 @@ private:
 
 public:
     wxTextCtrl *m_textCtrl;
+	wxGauge *m_gauge; // shown above the text while the post processor is running
+	wxStaticText *m_progress_text;
 
     CPrintCanvas(wxWindow* parent);
 	virtual ~CPrintCanvas(){}
 
 	void Clear();
+	void ShowProgress(double fraction, const wxString& text);
+	void HideProgress();
 
     void OnSize(wxSizeEvent& event);
 	void OnLengthExceeded(wxCommandEvent& event);
@@ -0,0 +1,538 @@
+// PathRenderer.cpp
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+#include "stdafx.h"
+#include "PathRenderer.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+// the vertex buffer object functions are OpenGL 1.5, so they have to be fetched from the driver at run time
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_ELEMENT_ARRAY_BUFFER
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#endif
+#ifndef GL_DYNAMIC_DRAW
+#define GL_DYNAMIC_DRAW 0x88E8
+#endif
+
+#ifdef WIN32
+#define PATH_RENDERER_APIENTRY __stdcall
+#else
+#define PATH_RENDERER_APIENTRY
+#endif
+
+typedef void (PATH_RENDERER_APIENTRY *GenBuffersProc)(GLsizei n, GLuint *buffers);
+typedef void (PATH_RENDERER_APIENTRY *DeleteBuffersProc)(GLsizei n, const GLuint *buffers);
+typedef void (PATH_RENDERER_APIENTRY *BindBufferProc)(GLenum target, GLuint buffer);
+typedef void (PATH_RENDERER_APIENTRY *BufferDataProc)(GLenum target, ptrdiff_t size, const GLvoid *data, GLenum usage);
+typedef void (PATH_RENDERER_APIENTRY *BufferSubDataProc)(GLenum target, ptrdiff_t offset, ptrdiff_t size, const GLvoid *data);
+typedef void (PATH_RENDERER_APIENTRY *GetBufferSubDataProc)(GLenum target, ptrdiff_t offset, ptrdiff_t size, GLvoid *data);
+typedef void (PATH_RENDERER_APIENTRY *MultiDrawElementsProc)(GLenum mode, const GLsizei *count, GLenum type, const GLvoid* const *indices, GLsizei primcount);
+
+static GenBuffersProc pglGenBuffers = NULL;
+static DeleteBuffersProc pglDeleteBuffers = NULL;
+static BindBufferProc pglBindBuffer = NULL;
+static BufferDataProc pglBufferData = NULL;
+static BufferSubDataProc pglBufferSubData = NULL;
+static GetBufferSubDataProc pglGetBufferSubData = NULL;
+static MultiDrawElementsProc pglMultiDrawElements = NULL; // OpenGL 1.4; if the driver hasn't got it, the tiles are drawn one at a time
+
+#if !defined(WIN32) && !defined(__APPLE__)
+extern "C" void (*glXGetProcAddressARB(const GLubyte *procName))(void);
+#endif
+
+static void* GetGLProcAddress(const char* name)
+{
+#if defined(WIN32)
+	return (void*)wglGetProcAddress(name);
+#elif defined(__APPLE__)
+	return NULL;
+#else
+	return (void*)glXGetProcAddressARB((const GLubyte*)name);
+#endif
+}
+
+static bool LoadBufferFunctions(const char* suffix)
+{
+	std::string s(suffix);
+	pglGenBuffers = (GenBuffersProc)GetGLProcAddress(("glGenBuffers" + s).c_str());
+	pglDeleteBuffers = (DeleteBuffersProc)GetGLProcAddress(("glDeleteBuffers" + s).c_str());
+	pglBindBuffer = (BindBufferProc)GetGLProcAddress(("glBindBuffer" + s).c_str());
+	pglBufferData = (BufferDataProc)GetGLProcAddress(("glBufferData" + s).c_str());
+	pglBufferSubData = (BufferSubDataProc)GetGLProcAddress(("glBufferSubData" + s).c_str());
+	pglGetBufferSubData = (GetBufferSubDataProc)GetGLProcAddress(("glGetBufferSubData" + s).c_str());
+	return pglGenBuffers && pglDeleteBuffers && pglBindBuffer && pglBufferData && pglBufferSubData && pglGetBufferSubData;
+}
+
+// static
+bool PathRenderer::Available()
+{
+	static int available = -1;
+	if(available == -1)
+	{
+		available = 0;
+
+		// software renderers, such as the Windows GDI one, only go up to OpenGL 1.1
+		const char* version = (const char*)glGetString(GL_VERSION);
+		const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+		if(version)
+		{
+			int major = atoi(version);
+			const char* dot = strchr(version, '.');
+			int minor = dot ? atoi(dot + 1) : 0;
+			if(major > 1 || (major == 1 && minor >= 5))
+			{
+				if(LoadBufferFunctions(""))available = 1;
+			}
+		}
+		if(!available && extensions && strstr(extensions, "GL_ARB_vertex_buffer_object"))
+		{
+			if(LoadBufferFunctions("ARB"))available = 1;
+		}
+		if(available)
+		{
+			pglMultiDrawElements = (MultiDrawElementsProc)GetGLProcAddress("glMultiDrawElements");
+			if(pglMultiDrawElements == NULL && extensions && strstr(extensions, "GL_EXT_multi_draw_arrays"))pglMultiDrawElements = (MultiDrawElementsProc)GetGLProcAddress("glMultiDrawElementsEXT");
+		}
+	}
+
+	return available != 0;
+}
+
+#define PATH_RENDERER_TILE_SIZE 1024 // moves in each tile
+
+PathRenderer::PathRenderer():m_vertex_buffer(0), m_index_buffer(0), m_vertex_buffer_size(0), m_vertices_used(0), m_index_buffer_size(0), m_indices_used(0)
+{
+	for(int i = 0; i < PATH_RENDERER_LEVELS; i++)m_level_tolerance[i] = 0.0;
+}
+
+static void AddVertex(std::vector<float> &vertices, double x, double y, double z)
+{
+	vertices.push_back((float)x);
+	vertices.push_back((float)y);
+	vertices.push_back((float)z);
+}
+
+// a sphere around the tile's moves, including the start of its first move
+static void GetTileSphere(const PathStore &store, PathRendererTile &tile)
+{
+	CBox box;
+	unsigned int first = (tile.m_first_move > 0) ? tile.m_first_move - 1 : 0;
+	store.GetBox(first, tile.m_first_move + tile.m_num_moves - first, box);
+	if(!box.m_valid)return;
+	double c[3];
+	box.Centre(c);
+	for(int k = 0; k < 3; k++)tile.m_centre[k] = (float)c[k];
+	tile.m_radius = (float)(sqrt(box.Width() * box.Width() + box.Height() * box.Height() + box.Depth() * box.Depth()) * 0.5);
+}
+
+static double DistanceToLine(const float* p, const float* a, const float* b)
+{
+	double ab[3], ap[3];
+	double ab_length_squared = 0.0, t = 0.0;
+	for(int k = 0; k < 3; k++)
+	{
+		ab[k] = b[k] - a[k];
+		ap[k] = p[k] - a[k];
+		ab_length_squared += ab[k] * ab[k];
+		t += ab[k] * ap[k];
+	}
+	t = (ab_length_squared > 0.0) ? t / ab_length_squared : 0.0;
+	if(t < 0.0)t = 0.0;
+	if(t > 1.0)t = 1.0;
+	double d_squared = 0.0;
+	for(int k = 0; k < 3; k++)
+	{
+		double d = ap[k] - ab[k] * t;
+		d_squared += d * d;
+	}
+	return sqrt(d_squared);
+}
+
+// Douglas-Peucker simplification of the polyline through the vertices from first to last
+static void Simplify(const std::vector<float> &vertices, unsigned int first, unsigned int last, double tolerance, std::vector<unsigned int> &kept)
+{
+	std::vector<bool> keep(last - first + 1, false);
+	keep[0] = true;
+	keep[last - first] = true;
+
+	std::vector< std::pair<unsigned int, unsigned int> > spans;
+	spans.push_back(std::make_pair(first, last));
+	while(!spans.empty())
+	{
+		unsigned int a = spans.back().first;
+		unsigned int b = spans.back().second;
+		spans.pop_back();
+
+		double max_distance = 0.0;
+		unsigned int furthest = a;
+		for(unsigned int v = a + 1; v < b; v++)
+		{
+			double d = DistanceToLine(&vertices[v*3], &vertices[a*3], &vertices[b*3]);
+			if(d > max_distance)
+			{
+				max_distance = d;
+				furthest = v;
+			}
+		}
+
+		if(max_distance > tolerance)
+		{
+			keep[furthest - first] = true;
+			spans.push_back(std::make_pair(a, furthest));
+			spans.push_back(std::make_pair(furthest, b));
+		}
+	}
+
+	kept.clear();
+	for(unsigned int v = first; v <= last; v++)
+	{
+		if(keep[v - first])kept.push_back(v);
+	}
+}
+
+void PathRenderer::Build(const PathStore &store)
+{
+	Destroy();
+
+	// the level tolerances go up by eight times, from a very small part of the toolpath's size
+	CBox box;
+	store.GetBox(0, store.size(), box);
+	double diagonal = box.m_valid ? sqrt(box.Width() * box.Width() + box.Height() * box.Height() + box.Depth() * box.Depth()) : 0.0;
+	m_level_tolerance[0] = 0.0;
+	for(int level = 1; level < PATH_RENDERER_LEVELS; level++)
+	{
+		m_level_tolerance[level] = (level == 1) ? diagonal / 65536 : m_level_tolerance[level - 1] * 8;
+	}
+
+	// make the tiles; their lines are made when they are first seen
+	for(unsigned int first = 0; first < store.size(); first += PATH_RENDERER_TILE_SIZE)
+	{
+		m_tiles.push_back(PathRendererTile());
+		PathRendererTile &tile = m_tiles.back();
+		tile.m_first_move = first;
+		tile.m_num_moves = (first + PATH_RENDERER_TILE_SIZE > store.size()) ? store.size() - first : PATH_RENDERER_TILE_SIZE;
+		GetTileSphere(store, tile);
+	}
+
+	GLuint buffers[2];
+	pglGenBuffers(2, buffers);
+	m_vertex_buffer = buffers[0];
+	m_index_buffer = buffers[1];
+}
+
+void PathRenderer::MakeTile(const PathStore &store, PathRendererTile &tile, double arc_tolerance)const
+{
+	// the vertices are one polyline, from the start of the tile's first move
+	// each move adds the vertices after its start point, which is the previous move's last vertex
+	std::vector<float> &vertices = tile.m_vertices;
+	std::vector<unsigned char> vertex_color; // the colour of the line to each vertex from the one before
+	vertices.clear();
+
+	unsigned int i = tile.m_first_move;
+	unsigned int end_move = tile.m_first_move + tile.m_num_moves;
+	const double* s = (i > 0) ? store.GetEnd(i - 1) : store.GetEnd(i++);
+	AddVertex(vertices, s[0], s[1], s[2]);
+	vertex_color.push_back(0);
+	tile.m_has_arcs = false;
+
+	for(; i < end_move; i++)
+	{
+		if(store.GetType(i) == PathObject::eArc)
+		{
+			tile.m_has_arcs = true;
+			PathObject prev_po;
+			store.GetPathObject(i - 1, prev_po);
+			PathArc arc;
+			store.GetArc(i, arc);
+			std::list<gp_Pnt> points = arc.Interpolate( &prev_po, arc.GetNumberOfSegments( &prev_po, arc_tolerance ) );
+			points.pop_front(); // the start point
+			for(std::list<gp_Pnt>::const_iterator It = points.begin(); It != points.end(); It++)
+			{
+				AddVertex(vertices, It->X(), It->Y(), It->Z());
+			}
+		}
+		else
+		{
+			const double* x = store.GetEnd(i);
+			AddVertex(vertices, x[0], x[1], x[2]);
+		}
+
+		unsigned int last_vertex = (unsigned int)(vertices.size() / 3) - 1;
+		vertex_color.resize(last_vertex + 1, (unsigned char)store.GetColor(i));
+	}
+
+	tile.m_indices.clear();
+	unsigned int num_vertices = (unsigned int)(vertices.size() / 3);
+	std::vector<unsigned int> kept;
+	for(int level = 0; level < PATH_RENDERER_LEVELS; level++)
+	{
+		std::vector<unsigned int> tile_lines[MaxColorTypes];
+
+		// each run of lines of the same colour is simplified on its own, so the colours don't change
+		unsigned int run_start = 1;
+		while(run_start < num_vertices)
+		{
+			unsigned char color = vertex_color[run_start];
+			unsigned int run_end = run_start + 1;
+			while(run_end < num_vertices && vertex_color[run_end] == color)run_end++;
+
+			if(level == 0)
+			{
+				for(unsigned int v = run_start; v < run_end; v++)
+				{
+					tile_lines[color].push_back(v - 1);
+					tile_lines[color].push_back(v);
+				}
+			}
+			else
+			{
+				Simplify(vertices, run_start - 1, run_end - 1, m_level_tolerance[level], kept);
+				for(unsigned int k = 1; k < kept.size(); k++)
+				{
+					tile_lines[color].push_back(kept[k - 1]);
+					tile_lines[color].push_back(kept[k]);
+				}
+			}
+
+			run_start = run_end;
+		}
+
+		for(int c = 0; c < MaxColorTypes; c++)
+		{
+			tile.m_first[level][c] = (unsigned int)tile.m_indices.size();
+			tile.m_count[level][c] = (unsigned int)tile_lines[c].size();
+			tile.m_indices.insert(tile.m_indices.end(), tile_lines[c].begin(), tile_lines[c].end());
+		}
+	}
+
+	tile.m_arc_tolerance = arc_tolerance;
+	tile.m_made = true;
+}
+
+// makes the buffer bigger, keeping the used part of it
+static void GrowBuffer(GLenum target, GLuint buffer, size_t used_bytes, size_t new_bytes)
+{
+	// the only time any of the buffer is copied back from the GL; the buffers grow by half each time, so it doesn't happen often
+	std::vector<unsigned char> used(used_bytes);
+	pglBindBuffer(target, buffer);
+	if(used_bytes > 0)pglGetBufferSubData(target, 0, used_bytes, &used[0]);
+	pglBufferData(target, new_bytes, NULL, GL_DYNAMIC_DRAW);
+	if(used_bytes > 0)pglBufferSubData(target, 0, used_bytes, &used[0]);
+	pglBindBuffer(target, 0);
+}
+
+void PathRenderer::Upload(const std::vector<unsigned int> &made)
+{
+	// the tiles which have outgrown their ranges, or haven't got one yet, get new ones at the end of the buffers.
+	// A tile with arcs gets twice the room it needs now, because zooming in makes more lines for its arcs
+	size_t vertices_needed = m_vertices_used;
+	size_t indices_needed = m_indices_used;
+	for(unsigned int k = 0; k < made.size(); k++)
+	{
+		PathRendererTile &tile = m_tiles[made[k]];
+		unsigned int num_vertices = (unsigned int)(tile.m_vertices.size() / 3);
+		unsigned int num_indices = (unsigned int)tile.m_indices.size();
+		if(num_vertices <= tile.m_vertex_capacity && num_indices <= tile.m_index_capacity)continue;
+		unsigned int room = tile.m_has_arcs ? 2 : 1;
+		tile.m_first_vertex = (unsigned int)vertices_needed;
+		tile.m_vertex_capacity = num_vertices * room;
+		tile.m_first_index = (unsigned int)indices_needed;
+		tile.m_index_capacity = num_indices * room;
+		vertices_needed += tile.m_vertex_capacity;
+		indices_needed += tile.m_index_capacity;
+	}
+
+	if(vertices_needed > m_vertex_buffer_size)
+	{
+		size_t size = vertices_needed + vertices_needed / 2;
+		GrowBuffer(GL_ARRAY_BUFFER, m_vertex_buffer, m_vertices_used * 3 * sizeof(float), size * 3 * sizeof(float));
+		m_vertex_buffer_size = size;
+	}
+	if(indices_needed > m_index_buffer_size)
+	{
+		size_t size = indices_needed + indices_needed / 2;
+		GrowBuffer(GL_ELEMENT_ARRAY_BUFFER, m_index_buffer, m_indices_used * sizeof(unsigned int), size * sizeof(unsigned int));
+		m_index_buffer_size = size;
+	}
+	m_vertices_used = vertices_needed;
+	m_indices_used = indices_needed;
+
+	pglBindBuffer(GL_ARRAY_BUFFER, m_vertex_buffer);
+	pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_index_buffer);
+	for(unsigned int k = 0; k < made.size(); k++)
+	{
+		PathRendererTile &tile = m_tiles[made[k]];
+		if(tile.m_vertices.size() > 0)pglBufferSubData(GL_ARRAY_BUFFER, tile.m_first_vertex * 3 * sizeof(float), tile.m_vertices.size() * sizeof(float), &tile.m_vertices[0]);
+
+		// the indices are into the whole vertex buffer
+		for(std::vector<unsigned int>::iterator It = tile.m_indices.begin(); It != tile.m_indices.end(); It++)*It += tile.m_first_vertex;
+		if(tile.m_indices.size() > 0)pglBufferSubData(GL_ELEMENT_ARRAY_BUFFER, tile.m_first_index * sizeof(unsigned int), tile.m_indices.size() * sizeof(unsigned int), &tile.m_indices[0]);
+
+		// the lines are only needed again if the tile is made again, which makes them again
+		std::vector<float>().swap(tile.m_vertices);
+		std::vector<unsigned int>().swap(tile.m_indices);
+	}
+	pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	pglBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void PathRenderer::Destroy()
+{
+	if(m_vertex_buffer)
+	{
+		GLuint buffers[2] = {m_vertex_buffer, m_index_buffer};
+		pglDeleteBuffers(2, buffers);
+		m_vertex_buffer = 0;
+		m_index_buffer = 0;
+	}
+	m_vertex_buffer_size = 0;
+	m_vertices_used = 0;
+	m_index_buffer_size = 0;
+	m_indices_used = 0;
+	m_tiles.clear();
+}
+
+void PathRenderer::ChooseLevels(std::vector<int> &levels, std::vector<double> &arc_tolerances)const
+{
+	GLdouble modelview[16], projection[16];
+	GLint viewport[4];
+	glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+	glGetDoublev(GL_PROJECTION_MATRIX, projection);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	// m = projection * modelview, column major
+	double m[16];
+	for(int c = 0; c < 4; c++)
+	{
+		for(int r = 0; r < 4; r++)
+		{
+			m[c*4 + r] = 0.0;
+			for(int k = 0; k < 4; k++)m[c*4 + r] += projection[k*4 + r] * modelview[c*4 + k];
+		}
+	}
+
+	// the planes of the view volume, normalized, so the distance to them can be compared with the tiles' radii
+	double planes[6][4];
+	for(int p = 0; p < 6; p++)
+	{
+		int row = p / 2;
+		double sign = (p % 2) ? -1.0 : 1.0;
+		double length = 0.0;
+		for(int k = 0; k < 4; k++)
+		{
+			planes[p][k] = m[k*4 + 3] + sign * m[k*4 + row];
+			if(k < 3)length += planes[p][k] * planes[p][k];
+		}
+		length = sqrt(length);
+		if(length > 0.0)for(int k = 0; k < 4; k++)planes[p][k] /= length;
+	}
+
+	// the size of a pixel, at a point, is its clip w times this
+	double model_scale = sqrt(modelview[0] * modelview[0] + modelview[1] * modelview[1] + modelview[2] * modelview[2]);
+	double pixel_size_factor = 0.0;
+	if(viewport[3] > 0 && projection[5] != 0.0 && model_scale > 0.0)pixel_size_factor = 2.0 / (viewport[3] * fabs(projection[5]) * model_scale);
+	double pixels = (CNCCode::s_arc_chord_tolerance > 0.01) ? CNCCode::s_arc_chord_tolerance : 0.01;
+
+	levels.resize(m_tiles.size());
+	arc_tolerances.resize(m_tiles.size());
+	for(unsigned int t = 0; t < m_tiles.size(); t++)
+	{
+		const PathRendererTile &tile = m_tiles[t];
+		const float* c = tile.m_centre;
+
+		bool visible = true;
+		for(int p = 0; p < 6 && visible; p++)
+		{
+			if(planes[p][0] * c[0] + planes[p][1] * c[1] + planes[p][2] * c[2] + planes[p][3] < -tile.m_radius)visible = false;
+		}
+		arc_tolerances[t] = 0.0;
+		if(!visible)
+		{
+			levels[t] = -1;
+			continue;
+		}
+
+		// the simplest level which is within tolerance of the toolpath, at this tile's pixel size
+		int level = 0;
+		double w = m[3] * c[0] + m[7] * c[1] + m[11] * c[2] + m[15];
+		if(w > 0.0 && pixel_size_factor > 0.0)
+		{
+			double tolerance = w * pixel_size_factor * pixels;
+			while(level + 1 < PATH_RENDERER_LEVELS && m_level_tolerance[level + 1] <= tolerance)level++;
+
+			// rounded down to a power of two, so the arcs aren't made again for every small zoom
+			if(CNCCode::s_arc_chord_tolerance > 0.0)arc_tolerances[t] = pow(2.0, floor(log(tolerance) / log(2.0)));
+		}
+		levels[t] = level;
+	}
+}
+
+void PathRenderer::glCommands(const PathStore &store, bool select)
+{
+	if(!Built())return;
+
+	// in selection mode, the pick matrix leaves just the tiles near the mouse; the moves are found from a PathTree, not from names
+	std::vector<int> levels;
+	std::vector<double> arc_tolerances;
+	ChooseLevels(levels, arc_tolerances);
+
+	// make the tiles seen for the first time, and the ones with arcs zoomed into past their arcs' tolerance
+	// the pick matrix makes everything look bigger, so when selecting, only tiles not made yet are made
+	std::vector<unsigned int> made;
+	for(unsigned int t = 0; t < m_tiles.size(); t++)
+	{
+		if(levels[t] < 0)continue;
+		PathRendererTile &tile = m_tiles[t];
+		if(tile.m_made && (select || !tile.m_has_arcs || arc_tolerances[t] <= 0.0 || (tile.m_arc_tolerance > 0.0 && arc_tolerances[t] >= tile.m_arc_tolerance)))continue;
+		MakeTile(store, tile, arc_tolerances[t]);
+		made.push_back(t);
+	}
+	if(made.size() > 0)Upload(made);
+
+	pglBindBuffer(GL_ARRAY_BUFFER, m_vertex_buffer);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, NULL);
+
+	// each colour's ranges of the index buffer, from all the tiles, are drawn with one call
+	std::vector<GLsizei> counts;
+	std::vector<const GLvoid*> offsets;
+	counts.reserve(m_tiles.size());
+	offsets.reserve(m_tiles.size());
+
+	pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_index_buffer);
+	for(int i = 0; i < MaxColorTypes; i++)
+	{
+		counts.clear();
+		offsets.clear();
+		for(unsigned int t = 0; t < m_tiles.size(); t++)
+		{
+			int level = levels[t];
+			if(level < 0)continue;
+			const PathRendererTile &tile = m_tiles[t];
+			if(tile.m_count[level][i] == 0)continue;
+			counts.push_back((GLsizei)tile.m_count[level][i]);
+			offsets.push_back((const GLvoid*)((tile.m_first_index + tile.m_first[level][i]) * sizeof(unsigned int)));
+		}
+		if(counts.empty())continue;
+
+		if(!select)CNCCode::Color((ColorEnum)i).glColor();
+		if(pglMultiDrawElements)
+		{
+			pglMultiDrawElements(GL_LINES, &counts[0], GL_UNSIGNED_INT, &offsets[0], (GLsizei)counts.size());
+		}
+		else
+		{
+			for(unsigned int k = 0; k < counts.size(); k++)glDrawElements(GL_LINES, counts[k], GL_UNSIGNED_INT, offsets[k]);
+		}
+	}
+	pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	glDisableClientState(GL_VERTEX_ARRAY);
+	pglBindBuffer(GL_ARRAY_BUFFER, 0);
+}
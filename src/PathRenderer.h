@@ -0,0 +1,69 @@
+// PathRenderer.h
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+// Draws the moves of a PathStore from vertex buffer objects, as one vertex buffer, and one index buffer of GL_LINES.
+// Each tile has its own range of each buffer, which is updated when the tile is made again, and only moved to the end of the buffer
+// if the tile has outgrown it. The lines are only kept in memory until they are in the buffers.
+//
+// For levels of detail, the toolpath is split into tiles of consecutive moves.
+// Each tile has its lines at several levels, each simplified to a bigger tolerance, with a range of the index buffer for each colour.
+// When drawing, each tile's level is chosen from the size of a pixel at the tile, and tiles out of view aren't drawn.
+//
+// Each tile's arcs are tessellated for the size of a pixel at the tile, the first time it is seen.
+// A tile with arcs is only made again when it is zoomed into past its arcs' tolerance; zooming out just draws it at a simpler level.
+// A tile without arcs is never made again.
+
+#pragma once
+
+#include "NCCode.h"
+
+#define PATH_RENDERER_LEVELS 5 // level 0 has every vertex
+
+class PathRendererTile
+{
+public:
+	unsigned int m_first_move;
+	unsigned int m_num_moves;
+	float m_centre[3];
+	float m_radius; // of a sphere around the tile's moves
+	bool m_made;
+	bool m_has_arcs; // if not, the tile is never made again
+	double m_arc_tolerance; // in mm, that the arcs were tessellated to
+	std::vector<float> m_vertices; // three per vertex; emptied once they are in the vertex buffer
+	std::vector<unsigned int> m_indices; // into m_vertices; emptied once they are in the index buffer
+	unsigned int m_first[PATH_RENDERER_LEVELS][MaxColorTypes]; // offsets in m_indices
+	unsigned int m_count[PATH_RENDERER_LEVELS][MaxColorTypes];
+	unsigned int m_first_vertex; // the tile's range of the vertex buffer, in vertices
+	unsigned int m_vertex_capacity;
+	unsigned int m_first_index; // the tile's range of the index buffer
+	unsigned int m_index_capacity;
+
+	PathRendererTile():m_first_move(0), m_num_moves(0), m_radius(0.0f), m_made(false), m_has_arcs(false), m_arc_tolerance(0.0), m_first_vertex(0), m_vertex_capacity(0), m_first_index(0), m_index_capacity(0){}
+};
+
+class PathRenderer
+{
+	unsigned int m_vertex_buffer;
+	unsigned int m_index_buffer;
+	size_t m_vertex_buffer_size; // in vertices
+	size_t m_vertices_used; // the end of the last tile's range
+	size_t m_index_buffer_size; // in indices
+	size_t m_indices_used;
+	std::vector<PathRendererTile> m_tiles;
+	double m_level_tolerance[PATH_RENDERER_LEVELS]; // in mm
+	void ChooseLevels(std::vector<int> &levels, std::vector<double> &arc_tolerances)const; // for each tile, its level of detail, or -1 if it can't be seen, and the tolerance its arcs need
+	void MakeTile(const PathStore &store, PathRendererTile &tile, double arc_tolerance)const;
+	void Upload(const std::vector<unsigned int> &made); // puts the tiles just made into their ranges of the buffers
+
+public:
+	PathRenderer();
+
+	static bool Available(); // false, if the GL driver doesn't have vertex buffer objects; needs a current GL context
+
+	bool Built()const{return m_vertex_buffer != 0;}
+	void Build(const PathStore &store);
+	void Destroy(); // deletes the buffers; needs a current GL context
+
+	void glCommands(const PathStore &store, bool select);
+};
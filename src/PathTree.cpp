@@ -0,0 +1,240 @@
+// PathTree.cpp
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+#include "stdafx.h"
+#include "PathTree.h"
+
+#include <algorithm>
+#include <math.h>
+
+#define PATH_TREE_LEAF_SIZE 4
+#define PATH_TREE_ARC_TOLERANCE_FRACTION 16384 // of the toolpath's diagonal
+
+static void AddTreeLine(std::vector<PathTreeLine> &lines, const double* s, const double* e, unsigned int move, double t0, double t1)
+{
+	PathTreeLine line;
+	for(int k = 0; k < 3; k++)
+	{
+		line.m_s[k] = (float)s[k];
+		line.m_e[k] = (float)e[k];
+	}
+	line.m_move = move;
+	line.m_t0 = (float)t0;
+	line.m_t1 = (float)t1;
+	lines.push_back(line);
+}
+
+void PathTree::Build(const PathStore &store)
+{
+	Clear();
+	if(store.size() == 0)return;
+
+	CBox box;
+	store.GetBox(0, store.size(), box);
+	if(box.m_valid)m_arc_tolerance = sqrt(box.Width() * box.Width() + box.Height() * box.Height() + box.Depth() * box.Depth()) / PATH_TREE_ARC_TOLERANCE_FRACTION;
+	if(m_arc_tolerance <= 0.0)m_arc_tolerance = 0.001;
+
+	// the first move has no start point, so it has no line
+	m_lines.reserve(store.size());
+	for(unsigned int i = 1; i < store.size(); i++)
+	{
+		const double* s = store.GetStart(i);
+		if(store.GetType(i) == PathObject::eArc)
+		{
+			PathObject prev_po;
+			store.GetPathObject(i - 1, prev_po);
+			PathArc arc;
+			store.GetArc(i, arc);
+			std::list<gp_Pnt> points = arc.Interpolate( &prev_po, arc.GetNumberOfSegments( &prev_po, m_arc_tolerance ) );
+			points.pop_front(); // the start point
+			unsigned int num_vertices = (unsigned int)points.size();
+			double prev[3] = {s[0], s[1], s[2]};
+			unsigned int v = 0;
+			for(std::list<gp_Pnt>::const_iterator It = points.begin(); It != points.end(); It++, v++)
+			{
+				double p[3] = {It->X(), It->Y(), It->Z()};
+				AddTreeLine(m_lines, prev, p, i, (double)v / num_vertices, (double)(v + 1) / num_vertices);
+				memcpy(prev, p, sizeof(p));
+			}
+		}
+		else
+		{
+			AddTreeLine(m_lines, s, store.GetEnd(i), i, 0.0, 1.0);
+		}
+	}
+
+	if(m_lines.empty())return;
+
+	m_nodes.reserve(m_lines.size() * 2 / PATH_TREE_LEAF_SIZE + 1);
+	m_nodes.push_back(PathTreeNode());
+	BuildNode(0, 0, (unsigned int)m_lines.size());
+}
+
+void PathTree::Clear()
+{
+	m_nodes.clear();
+	m_lines.clear();
+	m_arc_tolerance = 0.0;
+}
+
+class LineCentreLess
+{
+	int m_axis;
+public:
+	LineCentreLess(int axis):m_axis(axis){}
+	bool operator()(const PathTreeLine &a, const PathTreeLine &b)const
+	{
+		return a.m_s[m_axis] + a.m_e[m_axis] < b.m_s[m_axis] + b.m_e[m_axis];
+	}
+};
+
+void PathTree::BuildNode(unsigned int node, unsigned int first, unsigned int count)
+{
+	float box[6];
+	float centre_box[6];
+	for(unsigned int i = first; i < first + count; i++)
+	{
+		const PathTreeLine &line = m_lines[i];
+		for(int k = 0; k < 3; k++)
+		{
+			float mn = (line.m_s[k] < line.m_e[k]) ? line.m_s[k] : line.m_e[k];
+			float mx = (line.m_s[k] < line.m_e[k]) ? line.m_e[k] : line.m_s[k];
+			float c = (line.m_s[k] + line.m_e[k]) * 0.5f;
+			if(i == first || mn < box[k])box[k] = mn;
+			if(i == first || mx > box[k + 3])box[k + 3] = mx;
+			if(i == first || c < centre_box[k])centre_box[k] = c;
+			if(i == first || c > centre_box[k + 3])centre_box[k + 3] = c;
+		}
+	}
+	memcpy(m_nodes[node].m_box, box, sizeof(box));
+
+	if(count <= PATH_TREE_LEAF_SIZE)
+	{
+		m_nodes[node].m_first = first;
+		m_nodes[node].m_count = count;
+		return;
+	}
+
+	// split at the median of the line centres, across the longest side
+	int axis = 0;
+	for(int k = 1; k < 3; k++)
+	{
+		if(centre_box[k + 3] - centre_box[k] > centre_box[axis + 3] - centre_box[axis])axis = k;
+	}
+	unsigned int half = count / 2;
+	std::nth_element(m_lines.begin() + first, m_lines.begin() + first + half, m_lines.begin() + first + count, LineCentreLess(axis));
+
+	unsigned int child = (unsigned int)m_nodes.size();
+	m_nodes[node].m_first = child;
+	m_nodes[node].m_count = 0;
+	m_nodes.push_back(PathTreeNode());
+	m_nodes.push_back(PathTreeNode());
+	BuildNode(child, first, half);
+	BuildNode(child + 1, first + half, count - half);
+}
+
+// where the ray enters the box, grown by tolerance; returns false, if it misses
+static bool RayHitsBox(const double* o, const double* d, const float* box, double tolerance, double &t_enter)
+{
+	double t0 = 0.0, t1 = 1e300;
+	for(int k = 0; k < 3; k++)
+	{
+		double mn = box[k] - tolerance;
+		double mx = box[k + 3] + tolerance;
+		if(fabs(d[k]) < 1e-300)
+		{
+			if(o[k] < mn || o[k] > mx)return false;
+			continue;
+		}
+		double ta = (mn - o[k]) / d[k];
+		double tb = (mx - o[k]) / d[k];
+		if(ta > tb)std::swap(ta, tb);
+		if(ta > t0)t0 = ta;
+		if(tb < t1)t1 = tb;
+		if(t0 > t1)return false;
+	}
+	t_enter = t0;
+	return true;
+}
+
+// the distance between the ray o + s d, with d of unit length and s >= 0, and the line a + u (b - a), with u from 0 to 1
+static double RayLineDistance(const double* o, const double* d, const float* a, const float* b, double &s, double &u)
+{
+	double e[3], w[3];
+	for(int k = 0; k < 3; k++)
+	{
+		e[k] = b[k] - a[k];
+		w[k] = a[k] - o[k];
+	}
+	double ee = e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+	double de = d[0] * e[0] + d[1] * e[1] + d[2] * e[2];
+	double dw = d[0] * w[0] + d[1] * w[1] + d[2] * w[2];
+	double ew = e[0] * w[0] + e[1] * w[1] + e[2] * w[2];
+
+	double denominator = ee - de * de;
+	u = (denominator > 1e-12 * ee) ? (de * dw - ew) / denominator : 0.0;
+	if(u < 0.0)u = 0.0;
+	if(u > 1.0)u = 1.0;
+	s = dw + u * de;
+	if(s < 0.0)
+	{
+		s = 0.0;
+		u = (ee > 0.0) ? -ew / ee : 0.0;
+		if(u < 0.0)u = 0.0;
+		if(u > 1.0)u = 1.0;
+	}
+
+	double distance_squared = 0.0;
+	for(int k = 0; k < 3; k++)
+	{
+		double v = w[k] + u * e[k] - s * d[k];
+		distance_squared += v * v;
+	}
+	return sqrt(distance_squared);
+}
+
+bool PathTree::Pick(const double* ray_start, const double* ray_direction, double tolerance, unsigned int &move, double &t)const
+{
+	if(m_nodes.empty())return false;
+	tolerance += m_arc_tolerance; // the lines may cut inside an arc by this much
+
+	double length = sqrt(ray_direction[0] * ray_direction[0] + ray_direction[1] * ray_direction[1] + ray_direction[2] * ray_direction[2]);
+	if(length <= 0.0)return false;
+	double d[3] = {ray_direction[0] / length, ray_direction[1] / length, ray_direction[2] / length};
+
+	bool found = false;
+	double best_s = 0.0;
+	std::vector<unsigned int> stack;
+	stack.push_back(0);
+	while(!stack.empty())
+	{
+		const PathTreeNode &node = m_nodes[stack.back()];
+		stack.pop_back();
+
+		double t_enter;
+		if(!RayHitsBox(ray_start, d, node.m_box, tolerance, t_enter))continue;
+		if(found && t_enter > best_s)continue;
+
+		if(node.m_count == 0)
+		{
+			stack.push_back(node.m_first);
+			stack.push_back(node.m_first + 1);
+			continue;
+		}
+
+		for(unsigned int i = node.m_first; i < node.m_first + node.m_count; i++)
+		{
+			const PathTreeLine &line = m_lines[i];
+			double s, u;
+			if(RayLineDistance(ray_start, d, line.m_s, line.m_e, s, u) > tolerance)continue;
+			if(found && s >= best_s)continue;
+			found = true;
+			best_s = s;
+			move = line.m_move;
+			t = line.m_t0 + (line.m_t1 - line.m_t0) * u;
+		}
+	}
+
+	return found;
+}
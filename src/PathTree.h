@@ -0,0 +1,49 @@
+// PathTree.h
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+// A bounding volume hierarchy over the lines of a PathStore, for finding the move under the mouse from a ray,
+// rather than drawing every block with its own name in selection mode.
+// Arcs are split into lines for a fixed fraction of the toolpath's size, not the tolerance they are drawn with,
+// so the tree is made once, when the nc code is loaded, and doesn't change with the view.
+
+#pragma once
+
+#include "NCCode.h"
+
+class PathTreeNode
+{
+public:
+	float m_box[6]; // minimum x, y, z, then maximum x, y, z
+	unsigned int m_first; // index of the first of the two child nodes, or of the first line, for a leaf
+	unsigned int m_count; // number of lines in a leaf; 0 for other nodes
+};
+
+class PathTreeLine
+{
+public:
+	float m_s[3], m_e[3];
+	unsigned int m_move;
+	float m_t0, m_t1; // the part of the move, from 0 to 1, that this line is
+};
+
+class PathTree
+{
+	std::vector<PathTreeNode> m_nodes;
+	std::vector<PathTreeLine> m_lines;
+	double m_arc_tolerance; // how far the lines for an arc may be from it; added to the pick tolerance
+
+	void BuildNode(unsigned int node, unsigned int first, unsigned int count);
+
+public:
+	PathTree():m_arc_tolerance(0.0){}
+
+	bool Built()const{return !m_nodes.empty();}
+	void Build(const PathStore &store);
+	void Clear();
+
+	// finds the move, passing within tolerance of the ray, nearest to the ray's start
+	// t is where the move passes nearest to the ray, from 0 at its start to 1 at its end
+	// returns false, if no move passes within tolerance of the ray
+	bool Pick(const double* ray_start, const double* ray_direction, double tolerance, unsigned int &move, double &t)const;
+};
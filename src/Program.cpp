@@ -34,6 +34,8 @@
 #include "Surface.h"
 #include "Stock.h"
 #include "ProgramDlg.h"
+#include "MeshCache.h"
+#include "OpCache.h"
 
 #include <wx/stdpaths.h>
 #include <wx/filename.h>
@@ -405,7 +407,8 @@ void CProgram::WriteXML(TiXmlNode *root)
 	element->SetAttribute( "output_file", m_output_file.utf8_str());
 	element->SetAttribute( "output_file_name_follows_data_file_name", (int) (m_output_file_name_follows_data_file_name?1:0));
 
-	element->SetAttribute( "program", theApp.m_program_canvas->m_textCtrl->GetValue().utf8_str());
+	// only a program the user has edited; otherwise it is made again from the operations
+	if(theApp.m_program_canvas->Edited())element->SetAttribute( "program", theApp.m_program_canvas->GetProgram().utf8_str());
 	element->SetDoubleAttribute( "units", m_units);
 
 	element->SetAttribute( "ProgramPathControlMode", int(m_path_control_mode));
@@ -485,7 +488,7 @@ HeeksObj* CProgram::ReadFromXMLElement(TiXmlElement* pElem)
 		if(name == "machine")new_object->m_machine = GetMachine(Ctt(a->Value()));
 		else if(name == "output_file"){new_object->m_output_file.assign(Ctt(a->Value()));}
 		else if(name == "output_file_name_follows_data_file_name"){new_object->m_output_file_name_follows_data_file_name = (atoi(a->Value()) != 0); }
-		else if(name == "program"){theApp.m_program_canvas->m_textCtrl->SetValue(Ctt(a->Value()));}
+		else if(name == "program"){theApp.m_program_canvas->SetProgram(Ctt(a->Value()));}
 		else if(name == "units"){new_object->m_units = a->DoubleValue();}
 		else if(name == "ProgramPathControlMode"){new_object->m_path_control_mode = ePathControlMode_t(atoi(a->Value()));}
 		else if(name == "ProgramMotionBlendingTolerance"){new_object->m_motion_blending_tolerance = a->DoubleValue();}
@@ -509,34 +512,39 @@ void CMachine::ReadBaseXML(TiXmlElement* element)
 {
 } // End ReadBaseXML() method
 
-void ApplyPatternToText(Python &python, int p, std::set<int> &patterns_written)
+// the definitions are written to definitions, not in the operation's python, so they are there for the operations after it, even if its block isn't run
+// key is made from anything the operation's NC code depends on which isn't in its python
+void ApplyPatternToText(Python &definitions, Python &python, int p, std::set<int> &patterns_written, wxUint64 &key)
 {
 	CPattern* pattern = (CPattern*)heeksCAD->GetIDObject(PatternType, p);
 	if(pattern)
 	{
-		// if pattern not already written
-		if(patterns_written.find(p) == patterns_written.end())
+		// a pattern definition
+		Python definition;
+		definition << _T("pattern") << p << _T(" = [");
+		std::list<gp_Trsf> matrices;
+		pattern->GetMatrices(matrices);
+		for(std::list<gp_Trsf>::iterator It = matrices.begin(); It != matrices.end(); It++)
 		{
-			// write a pattern definition
-			python << _T("pattern") << p << _T(" = [");
-			std::list<gp_Trsf> matrices;
-			pattern->GetMatrices(matrices);
-			for(std::list<gp_Trsf>::iterator It = matrices.begin(); It != matrices.end(); It++)
+			if(It != matrices.begin())definition << _T(", ");
+			gp_Trsf &mat = *It;
+			definition << _T("area.Matrix([");
+			double m[16];
+			extract(mat, m);
+			for(int i = 0; i<16; i++)
 			{
-				if(It != matrices.begin())python << _T(", ");
-				gp_Trsf &mat = *It;
-				python << _T("area.Matrix([");
-				double m[16];
-				extract(mat, m);
-				for(int i = 0; i<16; i++)
-				{
-					if(i>0)python<<_T(", ");
-					python<<m[i];
-				}
-				python << _T("])");
+				if(i>0)definition<<_T(", ");
+				definition<<m[i];
 			}
-			python<<_T("]\n");
+			definition << _T("])");
+		}
+		definition<<_T("]\n");
+		key = OpCache::Hash(definition, key);
 
+		// if pattern not already written
+		if(patterns_written.find(p) == patterns_written.end())
+		{
+			definitions << definition;
 			patterns_written.insert(p);
 		}
 
@@ -545,33 +553,32 @@ void ApplyPatternToText(Python &python, int p, std::set<int> &patterns_written)
 	}
 }
 
-void ApplySurfaceToText(Python &python, CSurface* surface, std::set<CSurface*> &surfaces_written)
+// the nc_attach library, which nc/attach.py loads
+static wxString GetAttachLibraryPath()
+{
+#ifdef WIN32
+	return theApp.GetDllFolder() + _T("\\nc_attach.dll");
+#else
+	return theApp.GetDllFolder() + _T("/libnc_attach.so");
+#endif
+}
+
+void ApplySurfaceToText(Python &definitions, Python &python, CSurface* surface, std::set<CSurface*> &surfaces_written, wxUint64 &key)
 {
 	if(surfaces_written.find(surface) == surfaces_written.end())
 	{
 		surfaces_written.insert(surface);
-		// get the solids list
-		std::list<HeeksObj*> solids;
-		for (std::list<int>::iterator It = surface->m_solids.begin(); It != surface->m_solids.end(); It++)
-		{
-			HeeksObj* object = heeksCAD->GetIDObject(SolidType, *It);
-			if (object != NULL)solids.push_back(object);
-		} // End for
 
-#if wxCHECK_VERSION(3, 0, 0)
-		wxStandardPaths& standard_paths = wxStandardPaths::Get();
-#else
-		wxStandardPaths standard_paths;
-#endif
-		wxFileName filepath(standard_paths.GetTempDir().c_str(), wxString::Format(_T("surface%d.stl"), CSurface::number_for_stl_file).c_str());
-		CSurface::number_for_stl_file++;
+		// the stl file is only written again if the solids have changed.
+		// Without the library, attach.py uses OpenCAMLib, which can only read ASCII STL files
+		wxString filepath = MeshCache::GetSTLFile(surface->m_solids, surface->m_tolerance, wxFileExists(GetAttachLibraryPath()));
 
-		//write stl file
-		heeksCAD->SaveSTLFile(solids, filepath.GetFullPath(), 0.01);
-
-		python << _T("stl") << (int)(surface->m_id) << _T(" = ocl_funcs.STLSurfFromFile(") << PythonString(filepath.GetFullPath()) << _T(")\n");
+		definitions << _T("stl") << (int)(surface->m_id) << _T(" = attach.Surface(") << PythonString(filepath) << _T(")\n");
 	}
 
+	wxUint64 mesh_hash = MeshCache::GetHash(surface->m_solids, surface->m_tolerance);
+	key = OpCache::Hash(&mesh_hash, sizeof(mesh_hash), key);
+
 	python << _T("attach.units = ") << theApp.m_program->m_units << _T("\n");
 	python << _T("attach.attach_begin()\n");
 	python << _T("nc.creator.stl = stl") << (int)(surface->m_id) << _T("\n");
@@ -581,13 +588,13 @@ void ApplySurfaceToText(Python &python, CSurface* surface, std::set<CSurface*> &
 	theApp.m_attached_to_surface = surface;
 }
 
-Python CProgram::RewritePythonProgram()
+bool CProgram::RewritePythonProgram()
 {
-	Python python;
+	Python python; // the python before the operations; the operations are written straight to the file
+	python.Reserve(4096);
 
-	theApp.m_program_canvas->m_textCtrl->Clear();
+	theApp.m_program_canvas->Clear();
 	theApp.m_attached_to_surface = NULL;
-	CSurface::number_for_stl_file = 1;
 	theApp.m_tool_number = 0;
 
 	// call any OnRewritePython functions from other plugins
@@ -613,7 +620,7 @@ Python CProgram::RewritePythonProgram()
 	{
 		// If there are no operations then there is no GCode.
 		// No socks, no shirt, no service.
-		return(python);
+		return(false);
 	} // End if - then
 
 	for(HeeksObj* object = m_operations->GetFirstChild(); object; object = m_operations->GetNextChild())
@@ -623,7 +630,7 @@ Python CProgram::RewritePythonProgram()
 		if(((COp*)object)->m_active)
 		{
 			if(((COp*)object)->m_pattern != 0)transform_module_needed = true;
-			if(((COp*)object)->m_surface != 0){nc_attach_needed = true; ocl_module_needed = true; ocl_funcs_needed = true;}
+			if(((COp*)object)->m_surface != 0)nc_attach_needed = true;
 
 			switch(object->GetType())
 			{
@@ -761,6 +768,7 @@ Python CProgram::RewritePythonProgram()
 	if(nc_attach_needed)
 	{
 		python << _T("import nc.attach as attach\n");
+		python << _T("attach.library_path = ") << PythonString(GetAttachLibraryPath()) << _T("\n");
 	}
 
 	// OpenCamLib stuff
@@ -779,6 +787,11 @@ Python CProgram::RewritePythonProgram()
 		python << _T("\n");
 	}
 
+	if(theApp.m_use_op_cache)
+	{
+		OpCache::WriteBegin(python);
+	}
+
 	if(depths_needed)
 	{
 		python << _T("from depth_params import depth_params as depth_params\n");
@@ -808,7 +821,8 @@ Python CProgram::RewritePythonProgram()
 	}
 
 	// output file
-	python << _T("output(") << PythonString(GetOutputFileName()) << _T(")\n");
+	if(theApp.m_use_op_cache)python << _T("output(opcache.output_filename(") << PythonString(GetOutputFileName()) << _T("))\n");
+	else python << _T("output(") << PythonString(GetOutputFileName()) << _T(")\n");
 
 
 #ifdef FREE_VERSION
@@ -878,6 +892,24 @@ Python CProgram::RewritePythonProgram()
 
 	std::set<CSurface*> surfaces_written;
 	std::set<int> patterns_written;
+	wxUint64 program_key = OpCache::HashImports(python, OpCache::Hash(python)); // everything before the operations
+	Python header = python; // for the jobs
+	PythonRope all_definitions; // for the jobs
+	std::list<wxString> job_keys;
+	bool write_jobs = theApp.m_use_op_cache && theApp.m_op_cache_parallel;
+	if(write_jobs)OpCache::WriteRunJobs(python);
+
+	PythonWriter writer(GetPythonFilePath());
+	writer << python;
+
+	// the number of operations, for the progress written before each of them
+	int op_count = 0;
+	for (OperationsMap_t::const_iterator l_itOperation = operations.begin(); l_itOperation != operations.end(); l_itOperation++)
+	{
+		HeeksObj *object = (HeeksObj *) *l_itOperation;
+		if (object != NULL && COperations::IsAnOperation(object->GetType()) && ((COp*)object)->m_active)op_count++;
+	}
+	int op_index = 0;
 
 	for (OperationsMap_t::const_iterator l_itOperation = operations.begin(); l_itOperation != operations.end(); l_itOperation++)
 	{
@@ -889,47 +921,68 @@ Python CProgram::RewritePythonProgram()
 			COp* op = (COp*)object;
 			if(op->m_active)
 			{
+				Python definitions;
+				Python op_python;
+				wxUint64 key = program_key;
+
 				CSurface* surface = (CSurface*)heeksCAD->GetIDObject(SurfaceType, op->m_surface);
-				if(surface && !surface->m_same_for_each_pattern_position)ApplySurfaceToText(python, surface, surfaces_written);
-				ApplyPatternToText(python, op->m_pattern, patterns_written);
-				if(surface && surface->m_same_for_each_pattern_position)ApplySurfaceToText(python, surface, surfaces_written);
+				if(surface && !surface->m_same_for_each_pattern_position)ApplySurfaceToText(definitions, op_python, surface, surfaces_written, key);
+				ApplyPatternToText(definitions, op_python, op->m_pattern, patterns_written, key);
+				if(surface && surface->m_same_for_each_pattern_position)ApplySurfaceToText(definitions, op_python, surface, surfaces_written, key);
 
-				python << op->AppendTextToProgram();
+				op_python << op->AppendTextToProgram();
 
 				// end surface attach
-				if(surface && surface->m_same_for_each_pattern_position)python << _T("attach.attach_end()\n");
-				if(op->m_pattern != 0)python << _T("transform.transform_end()\n");
-				if(surface && !surface->m_same_for_each_pattern_position)python << _T("attach.attach_end()\n");
+				if(surface && surface->m_same_for_each_pattern_position)op_python << _T("attach.attach_end()\n");
+				if(op->m_pattern != 0)op_python << _T("transform.transform_end()\n");
+				if(surface && !surface->m_same_for_each_pattern_position)op_python << _T("attach.attach_end()\n");
 				theApp.m_attached_to_surface = NULL;
+
+				Python progress;
+				progress << _T("progress(") << op_index << _T(", ") << op_count << _T(")\n");
+				op_index++;
+				writer << progress;
+
+				writer << definitions;
+				all_definitions << definitions;
+				if(theApp.m_use_op_cache)
+				{
+					key = OpCache::Hash(op_python, key);
+					key = OpCache::HashImports(op_python, key);
+					Python block;
+					// the surface's and the pattern's redirectors read the creator's position, which a job would have from the start of the
+					// operations, not from the operation before, so the program would have to run the operation again anyway
+					bool redirected = (surface != NULL) || (op->m_pattern != 0);
+					if(OpCache::WriteBlock(block, op_python, key) && write_jobs && !redirected)
+					{
+						// a job to run the operation, at the same time as the others, before the program is run
+						OpCache::WriteJob((int)job_keys.size(), header, all_definitions, op_python, key);
+						job_keys.push_back(OpCache::KeyString(key));
+					}
+					writer << block;
+				}
+				else writer << op_python;
 			}
 		}
 	} // End for - operation
 
-	python << _T("program_end()\n");
-	m_python_program = python;
-	theApp.m_program_canvas->m_textCtrl->AppendText(python);
-	if (python.Length() > theApp.m_program_canvas->m_textCtrl->GetValue().Length())
-	{
-		// The python program is longer than the text control object can handle.  The maximum
-		// length of the text control objects changes depending on the operating system (and its
-		// implementation of wxWidgets).  Rather than showing the truncated program, tell the
-		// user that it has been truncated and where to find it.
+	Python end;
+	end << _T("progress(") << op_count << _T(", ") << op_count << _T(")\n");
+	end << _T("program_end()\n");
+	if(theApp.m_use_op_cache)OpCache::WriteEnd(end);
+	writer << end;
+	if(write_jobs)OpCache::WriteJobList(job_keys);
 
-#if wxCHECK_VERSION(3, 0, 0)
-		wxStandardPaths& standard_paths = wxStandardPaths::Get();
-#else
-		wxStandardPaths standard_paths;
-#endif
-		wxFileName file_str(standard_paths.GetTempDir().c_str(), _T("post.py"));
-
-		theApp.m_program_canvas->m_textCtrl->Clear();
-		theApp.m_program_canvas->m_textCtrl->AppendText(_("The Python program is too long \n"));
-		theApp.m_program_canvas->m_textCtrl->AppendText(_("to display in this window.\n"));
-		theApp.m_program_canvas->m_textCtrl->AppendText(_("Please edit the python program directly at \n"));
-		theApp.m_program_canvas->m_textCtrl->AppendText(file_str.GetFullPath());
+	if(!writer.Close())
+	{
+		wxMessageBox(wxString(_("couldn't write")) + _T(" ") + GetPythonFilePath());
+		return(false);
 	}
 
-	return(python);
+	// the program is shown a piece at a time, when the program canvas isn't busy
+	theApp.m_program_canvas->ShowFile(GetPythonFilePath());
+
+	return(true);
 }
 
 ProgramUserType CProgram::GetUserType()
@@ -1078,6 +1131,16 @@ CMachine CProgram::GetMachine(const wxString& description)
 	return machine;
 }
 
+wxString CProgram::GetPythonFilePath() const
+{
+#if wxCHECK_VERSION(3, 0, 0)
+	wxStandardPaths& standard_paths = wxStandardPaths::Get();
+#else
+	wxStandardPaths standard_paths;
+#endif
+	return wxFileName(standard_paths.GetTempDir().c_str(), _T("post.py")).GetFullPath();
+}
+
 /**
 	If the m_output_file_name_follows_data_file_name flag is true then
 	we don't want to use the temporary directory.
@@ -1118,6 +1181,18 @@ wxString CProgram::GetBackplotFilePath() const
 	return file_str.GetFullPath();
 }
 
+wxString CProgram::GetBinaryBackplotFilePath() const
+{
+	// written by nc/hbin_writer.py, in the temporary folder
+#if wxCHECK_VERSION(3, 0, 0)
+	wxStandardPaths& standard_paths = wxStandardPaths::Get();
+#else
+	wxStandardPaths standard_paths;
+#endif
+	wxFileName file_str(standard_paths.GetTempDir().c_str(), _T("backplot.hnc"));
+	return file_str.GetFullPath();
+}
+
 CNCCode* CProgram::NCCode()
 {
     if (m_nc_code == NULL) ReloadPointers();
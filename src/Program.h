@@ -114,7 +114,6 @@ public:
 
 	bool m_script_edited;
 	double m_units; // 1.0 for mm, 25.4 for inches
-	Python m_python_program;
 
 	CProgram();
 	CProgram( const CProgram & rhs );
@@ -127,8 +126,10 @@ public:
 	bool IsDifferent( HeeksObj *other ) { return(*this != (*(CProgram *)other)); }
 
 	wxString GetDefaultOutputFilePath()const;
+	wxString GetPythonFilePath() const; // post.py, which RewritePythonProgram writes
 	wxString GetOutputFileName() const;
 	wxString GetBackplotFilePath() const;
+	wxString GetBinaryBackplotFilePath() const;
 
 	// HeeksObj's virtual functions
 	int GetType()const{return ProgramType;}
@@ -155,7 +156,7 @@ public:
 	void GetOnEdit(bool(**callback)(HeeksObj*));
 	void Clear();
 
-	Python RewritePythonProgram();
+	bool RewritePythonProgram(); // writes post.py, and shows it in the program canvas; returns false if it couldn't
 	ProgramUserType GetUserType();
 	void UpdateFromUserType();
 
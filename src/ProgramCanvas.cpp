@@ -15,19 +15,25 @@
 #include "interface/PropertyInt.h"
 #include "interface/PropertyDouble.h"
 #include "interface/PropertyChoice.h"
+#include "PythonString.h"
+
+#include <wx/file.h>
+#include <wx/stdpaths.h>
+#include <wx/filename.h>
 
 #include <sstream>
 #include <iomanip>
 
 BEGIN_EVENT_TABLE(CProgramCanvas, wxScrolledWindow)
     EVT_SIZE(CProgramCanvas::OnSize)
+    EVT_IDLE(CProgramCanvas::OnIdle)
 END_EVENT_TABLE()
 
 //	if(heeksCAD->PickPosition(_T("Pick finish position"), pos)){
 
 CProgramCanvas::CProgramCanvas(wxWindow* parent)
         : wxScrolledWindow(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize,
-                           wxHSCROLL | wxVSCROLL | wxNO_FULL_REPAINT_ON_RESIZE)
+                           wxHSCROLL | wxVSCROLL | wxNO_FULL_REPAINT_ON_RESIZE), m_shown(0), m_all_shown(true), m_too_long(false), m_from_project(false)
 {
 	m_textCtrl = new wxTextCtrl( this, 100, _T(""),	wxPoint(180,170), wxSize(200,70), wxTE_MULTILINE | wxTE_DONTWRAP);
 
@@ -58,6 +64,167 @@ void CProgramCanvas::Resize()
 void CProgramCanvas::Clear()
 {
 	m_textCtrl->Clear();
+	m_textCtrl->DiscardEdits();
+	m_filepath.Clear();
+	m_shown = 0;
+	m_all_shown = true;
+	m_too_long = false;
+	m_from_project = false;
+}
+
+#define PROGRAM_PIECE_SIZE 65536
+
+void CProgramCanvas::ShowFile(const wxString& filepath)
+{
+	Clear();
+	m_filepath = filepath;
+	m_all_shown = false;
+	ShowPiece(); // the start of it is shown straight away
+}
+
+void CProgramCanvas::ShowPiece()
+{
+	wxFile file(m_filepath);
+	if(!file.IsOpened() || file.Seek(m_shown) == wxInvalidOffset)
+	{
+		m_all_shown = true;
+		return;
+	}
+
+	char buffer[PROGRAM_PIECE_SIZE];
+	ssize_t num_read = file.Read(buffer, PROGRAM_PIECE_SIZE);
+	if(num_read <= 0)
+	{
+		m_all_shown = true;
+		return;
+	}
+
+	// don't split a UTF-8 character between two pieces
+	size_t len = num_read;
+	if(num_read == PROGRAM_PIECE_SIZE)
+	{
+		size_t start = len - 1;
+		while(start > 0 && (buffer[start] & 0xc0) == 0x80)start--;
+		unsigned char c = buffer[start];
+		size_t char_len = ((c & 0x80) == 0) ? 1 : (((c & 0xe0) == 0xc0) ? 2 : (((c & 0xf0) == 0xe0) ? 3 : 4));
+		if(start + char_len > len)len = start;
+	}
+
+	wxString text(buffer, wxConvUTF8, len);
+	text.Replace(_T("\r\n"), _T("\n"));
+	wxTextPos before = m_textCtrl->GetLastPosition();
+	m_textCtrl->AppendText(text);
+	m_shown += len;
+
+	if(!AllTaken(text, before))
+	{
+		// The python program is longer than the text control object can handle.  The maximum
+		// length of the text control objects changes depending on the operating system (and its
+		// implementation of wxWidgets).  Rather than showing the truncated program, tell the
+		// user that it has been truncated and where to find it.
+		ShowTooLong();
+	}
+
+	m_textCtrl->DiscardEdits();
+}
+
+bool CProgramCanvas::AllTaken(const wxString& text, wxTextPos before)const
+{
+	wxTextPos added = m_textCtrl->GetLastPosition() - before;
+	if(added == (wxTextPos)text.Len())return true;
+#ifdef __WXMSW__
+	// the control may count each new line as two characters
+	if(added == (wxTextPos)(text.Len() + text.Freq(_T('\n'))))return true;
+#endif
+	return false;
+}
+
+void CProgramCanvas::ShowTooLong()
+{
+	m_textCtrl->Clear();
+	m_textCtrl->AppendText(_("The Python program is too long \n"));
+	m_textCtrl->AppendText(_("to display in this window.\n"));
+	m_textCtrl->AppendText(_("Please edit the python program directly at \n"));
+	m_textCtrl->AppendText(m_filepath);
+	m_too_long = true;
+	m_all_shown = true;
+}
+
+void CProgramCanvas::OnIdle(wxIdleEvent& event)
+{
+	// once the user has started editing, the rest is left until it is needed
+	if(m_all_shown || m_textCtrl->IsModified())return;
+
+	ShowPiece();
+	if(!m_all_shown)event.RequestMore();
+}
+
+void CProgramCanvas::SetProgram(const wxString& text)
+{
+	Clear();
+	wxString program = text;
+	program.Replace(_T("\r\n"), _T("\n"));
+	m_textCtrl->SetValue(program);
+	if(AllTaken(program, 0))return;
+
+	// it is kept in a file, like the programs the operations make, which is used instead of them
+#if wxCHECK_VERSION(3, 0, 0)
+	wxStandardPaths& standard_paths = wxStandardPaths::Get();
+#else
+	wxStandardPaths standard_paths;
+#endif
+	m_filepath = wxFileName(standard_paths.GetTempDir(), _T("post_from_project.py")).GetFullPath();
+	PythonWriter writer(m_filepath);
+	writer << program;
+	if(!writer.Close())
+	{
+		wxMessageBox(wxString(_("couldn't write")) + _T(" ") + m_filepath);
+		Clear();
+		return;
+	}
+	ShowTooLong();
+	m_from_project = true;
+	m_textCtrl->DiscardEdits();
+}
+
+wxString CProgramCanvas::GetRestOfFile()const
+{
+	if(m_all_shown && !m_too_long)return wxString();
+
+	wxFile file(m_filepath);
+	if(!file.IsOpened())return wxString();
+	wxFileOffset from = m_too_long ? 0 : m_shown;
+	wxFileOffset length = file.Length() - from;
+	if(length <= 0 || file.Seek(from) == wxInvalidOffset)return wxString();
+
+	std::vector<char> buffer((size_t)length);
+	ssize_t num_read = file.Read(&buffer[0], (size_t)length);
+	if(num_read <= 0)return wxString();
+	return wxString(&buffer[0], wxConvUTF8, num_read);
+}
+
+wxString CProgramCanvas::GetProgram()const
+{
+	if(m_too_long)return GetRestOfFile();
+	return m_textCtrl->GetValue() + GetRestOfFile();
+}
+
+bool CProgramCanvas::Edited()const
+{
+	if(m_too_long)return m_from_project; // it can't be edited here
+	if(m_filepath.Len() == 0)return m_textCtrl->GetLastPosition() > 0; // from a .heeks file
+	return m_textCtrl->IsModified();
+}
+
+bool CProgramCanvas::WriteProgram(const wxString& filepath)
+{
+	wxString program = GetProgram();
+	PythonWriter writer(filepath);
+	writer << program;
+	if(!writer.Close())return false;
+
+	ShowFile(filepath);
+	return true;
 }
 
 void CProgramCanvas::AppendText(const wxString& text)
@@ -14,6 +14,18 @@ class CProgramCanvas: public wxScrolledWindow
 private:
     void Resize();
 
+	// ShowFile's file is shown a piece at a time, in idle time, so a long program doesn't hold anything up
+	wxString m_filepath; // empty if the text isn't from a file
+	wxFileOffset m_shown; // how many bytes of the file have been shown
+	bool m_all_shown;
+	bool m_too_long; // the text control can't hold the program, so a message is shown instead
+	bool m_from_project; // SetProgram's program, from a .heeks file, which is used instead of the one the operations make
+
+	void ShowPiece();
+	bool AllTaken(const wxString& text, wxTextPos before)const; // true if the text control took all of the text appended at before
+	void ShowTooLong();
+	wxString GetRestOfFile()const; // the part of the file not shown yet
+
 public:
     wxTextCtrl *m_textCtrl;
 
@@ -21,8 +33,14 @@ public:
 	virtual ~CProgramCanvas(){}
 
 	void Clear();
+	void ShowFile(const wxString& filepath);
+	void SetProgram(const wxString& text); // a program which isn't in a file
+	wxString GetProgram()const; // all of it, even the part not shown yet
+	bool Edited()const; // true if the program shown isn't the same as the file, or is SetProgram's program
+	bool WriteProgram(const wxString& filepath); // the program, with the edits, which is then shown from this file
 
     void OnSize(wxSizeEvent& event);
+    void OnIdle(wxIdleEvent& event);
 
     void AppendText(const wxString& text);
     void AppendText(double value);
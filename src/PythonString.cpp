@@ -42,13 +42,20 @@ wxString PythonString( const wxString value )
 
 wxString PythonString( const double value )
 {
+	// the stream is only made once; there can be a number for each of thousands of points
 	#ifdef UNICODE
-        std::wostringstream _value;
+        static std::wostringstream _value;
     #else
-        std::ostringstream _value;
+        static std::ostringstream _value;
     #endif
-        _value.imbue(std::locale("C"));
-        _value<<std::setprecision(10);
+        static bool imbued = false;
+        if(!imbued)
+        {
+            _value.imbue(std::locale("C"));
+            _value<<std::setprecision(10);
+            imbued = true;
+        }
+        _value.str(_T(""));
         _value << value;
 
         return(_value.str().c_str());
@@ -82,3 +89,59 @@ Python & Python::operator<< ( const int value )
 }
 
 
+
+PythonRope & PythonRope::operator<< ( const Python & value )
+{
+	if(value.Len() == 0)return(*this);
+	m_pieces.push_back(value);
+	m_length += value.Len();
+	return(*this);
+}
+
+Python PythonRope::Join()const
+{
+	Python python;
+	python.Reserve(m_length);
+	for(std::list<Python>::const_iterator It = m_pieces.begin(); It != m_pieces.end(); It++)
+	{
+		python << *It;
+	}
+	return(python);
+}
+
+PythonWriter::PythonWriter( const wxString &filepath ):m_file(filepath.c_str(), wxFile::write)
+{
+	m_ok = m_file.IsOpened();
+	m_buffer.reserve(65536);
+}
+
+void PythonWriter::Flush()
+{
+	if(m_buffer.size() == 0)return;
+	if(m_ok && m_file.Write(m_buffer.data(), m_buffer.size()) != m_buffer.size())m_ok = false;
+	m_buffer.clear();
+}
+
+PythonWriter & PythonWriter::operator<< ( const wxString & value )
+{
+	const wxCharBuffer buffer = value.mb_str(wxConvUTF8);
+	m_buffer.append(buffer.data());
+	if(m_buffer.size() >= 65536)Flush();
+	return(*this);
+}
+
+PythonWriter & PythonWriter::operator<< ( const PythonRope & value )
+{
+	for(std::list<Python>::const_iterator It = value.Pieces().begin(); It != value.Pieces().end(); It++)
+	{
+		*this << *It;
+	}
+	return(*this);
+}
+
+bool PythonWriter::Close()
+{
+	Flush();
+	if(m_file.IsOpened())m_file.Close();
+	return(m_ok);
+}
@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include <wx/file.h>
+
 wxString PythonString( const wxString value );
 wxString PythonString( const double value );
 
@@ -14,5 +16,40 @@ public:
 	Python & operator<< ( const wxChar *value );
 	Python & operator<< ( const int value );
 
+	void Reserve( size_t length ) { Alloc(length); } // for text which is known to be long, so it isn't copied again each time it grows
+
 }; // End Python class definition
 
+// Python text kept in pieces, for when the text is still needed in memory, so adding to it never copies what is already there
+class PythonRope
+{
+	std::list<Python> m_pieces;
+	size_t m_length;
+
+public:
+	PythonRope():m_length(0){}
+
+	PythonRope & operator<< ( const Python & value );
+	size_t Len()const{return m_length;}
+	Python Join()const; // all the pieces, copied once into a string of the right length
+	const std::list<Python>& Pieces()const{return m_pieces;}
+};
+
+// writes Python text to a file as it is made, through a buffer, so the whole program never has to be in memory
+class PythonWriter
+{
+	wxFile m_file;
+	std::string m_buffer; // UTF-8, not written yet
+	bool m_ok;
+
+	void Flush();
+
+public:
+	PythonWriter( const wxString &filepath );
+	~PythonWriter(){Close();}
+
+	PythonWriter & operator<< ( const wxString & value );
+	PythonWriter & operator<< ( const PythonRope & value );
+	bool Close(); // returns false if any of it couldn't be written
+};
+
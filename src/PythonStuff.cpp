@@ -13,74 +13,469 @@
 #include "ProgramCanvas.h"
 #include "OutputCanvas.h"
 #include "Program.h"
+#include "NCCode.h"
+#include "NCReader.h"
 #include "CNCConfig.h"
+#include "OpCache.h"
 #include "interface/PropertyString.h"
 
+static const wxEventType wxEVT_PY_RECEIVED = wxNewEventType();
+
+// reads one of the process's pipes, on its own thread, so what the process writes is shown as soon as it is written
+class CPyPipeReader : public wxThread
+{
+	CPyProcess* m_process;
+	wxInputStream* m_stream;
+	int m_index; // 0 for stdout, 1 for stderr
+
+public:
+	CPyPipeReader(CPyProcess* process, wxInputStream* stream, int index):wxThread(wxTHREAD_JOINABLE), m_process(process), m_stream(stream), m_index(index){}
+
+	ExitCode Entry()
+	{
+		char buffer[4096];
+		while(true)
+		{
+			// waits until there's something to read, then returns what there is
+			m_stream->Read(buffer, sizeof(buffer));
+			size_t num_read = m_stream->LastRead();
+			if(num_read == 0)break; // the process has closed the pipe
+			m_process->Received(m_index, buffer, num_read);
+		}
+		m_process->Received(m_index, NULL, 0);
+		return 0;
+	}
+};
+
 //static
 bool CPyProcess::redirect = false;
 
 CPyProcess::CPyProcess(void)
 {
   m_pid = 0;
+  m_in_worker = false;
+  m_there_were_errors = false;
+  m_cancelled = false;
+  m_start_time = 0;
+  m_readers[0] = m_readers[1] = NULL;
+  m_at_end[0] = m_at_end[1] = true;
+  m_event_pending = false;
+  m_terminated = false;
   wxProcess(heeksCAD->GetMainFrame());
-  Connect(wxEVT_TIMER, wxTimerEventHandler(CPyProcess::OnTimer));
-  m_timer.SetOwner(this);
+  Connect(wxEVT_PY_RECEIVED, wxCommandEventHandler(CPyProcess::OnReceived));
+}
 
+CPyProcess::~CPyProcess(void)
+{
+	WaitForReaders();
 }
 
-void CPyProcess::OnTimer(wxTimerEvent& event)
+void CPyProcess::Started(void)
 {
-  HandleInput();
+	m_there_were_errors = false;
+	m_cancelled = false;
+	m_terminated = false;
+	m_start_time = wxGetLocalTime();
 }
 
-void CPyProcess::HandleInput(void) {
-	wxInputStream *m_in, *m_err;
+void CPyProcess::OnLine(const wxString& line)
+{
+	if(line.StartsWith(_T(PROGRESS_MARKER)))
+	{
+		// the operation's index, the number of operations, and how far through the operation it is, in thousandths
+		long values[3] = {0, 0, 0};
+		wxString rest = line;
+		for(int i = 0; i < 3; i++)
+		{
+			rest = rest.AfterFirst(_T('\t'));
+			rest.BeforeFirst(_T('\t')).ToLong(&values[i]);
+		}
+		OnProgress(values[0], values[1], values[2] * 0.001);
+		return;
+	}
+
+	theApp.m_print_canvas->m_textCtrl->AppendText(line + _T("\n"));
+}
+
+void CPyProcess::OnErrorLine(const wxString& line)
+{
+	// shown straight away, not when the process has finished
+	if(line.StartsWith(_T("Traceback")))m_there_were_errors = true;
+	theApp.m_output_canvas->m_listing->AddMessage(line);
+}
+
+void CPyProcess::OnProgress(int op_index, int op_count, double fraction)
+{
+	if(op_count <= 0)return;
+	double done = (op_index + fraction) / op_count;
+	if(done > 1.0)done = 1.0;
 
-	m_in = GetInputStream();
-	m_err = GetErrorStream();
+	wxString text;
+	if(op_index < op_count)text = wxString::Format(_("operation %d of %d"), op_index + 1, op_count);
+	else text = _("finishing");
 
-	if (m_in) {
-		wxString s;
-		while (m_in->CanRead()) {
-			char buffer[4096];
-			m_in->Read(buffer, sizeof(buffer));
-			s += wxString::From8BitData(buffer, m_in->LastRead());
+	long seconds = wxGetLocalTime() - m_start_time;
+	if(done > 0.0 && done < 1.0 && seconds > 0)
+	{
+		long seconds_left = (long)(seconds * (1.0 - done) / done);
+		text << _T(", ") << wxString::Format(_("about %ld:%02ld left"), seconds_left / 60, seconds_left % 60);
+	}
+
+	theApp.m_print_canvas->ShowProgress(done, text);
+}
+
+bool CPyProcess::ProcessErrors(void)
+{
+	if (m_there_were_errors)
+	{
+		wxMessageBox(_("There were errors!, see Output window"));
+		return false;
+	}
+
+	return true;
+}
+
+void CPyProcess::StartReaders(void)
+{
+	WaitForReaders();
+
+	wxInputStream* streams[2] = {GetInputStream(), GetErrorStream()};
+	for(int i = 0; i < 2; i++)
+	{
+		m_partial[i].clear();
+		m_at_end[i] = true;
+		if(streams[i] == NULL)continue;
+
+		CPyPipeReader* reader = new CPyPipeReader(this, streams[i], i);
+		m_at_end[i] = false;
+		if(reader->Create() == wxTHREAD_NO_ERROR && reader->Run() == wxTHREAD_NO_ERROR)
+		{
+			m_readers[i] = reader;
 		}
-		if (s.Length() > 0) {
-			theApp.m_print_canvas->m_textCtrl->AppendText(s);
+		else
+		{
+			m_at_end[i] = true;
+			delete reader;
+			wxLogMessage(_T("couldn't start a thread to read the python output"));
 		}
 	}
-	if (m_err) {
-		wxString s;
-		while (m_err->CanRead()) {
-			char buffer[4096];
-			m_err->Read(buffer, sizeof(buffer));
-			s += wxString::From8BitData(buffer, m_err->LastRead());
-		}
-		if (s.Length() > 0) {
-			wxLogMessage(_T("%s"), s.c_str());
+}
+
+void CPyProcess::Received(int stream, const char* data, size_t size)
+{
+	wxCriticalSectionLocker locker(m_received_lock);
+	if(data)m_received[stream].append(data, size);
+	else m_at_end[stream] = true;
+
+	// the main thread takes everything received so far, when it gets the event, so one event at a time is enough
+	if(m_event_pending)return;
+	m_event_pending = true;
+	wxCommandEvent event(wxEVT_PY_RECEIVED);
+	AddPendingEvent(event);
+}
+
+void CPyProcess::OnReceived(wxCommandEvent& event)
+{
+	std::string received[2];
+	bool at_end[2];
+	{
+		wxCriticalSectionLocker locker(m_received_lock);
+		m_event_pending = false;
+		for(int i = 0; i < 2; i++)
+		{
+			received[i].swap(m_received[i]);
+			at_end[i] = m_at_end[i];
 		}
 	}
+
+	// the errors are shown first, so they are shown before anything the output causes to be done
+	HandleLines(1, received[1], at_end[1]);
+	HandleLines(0, received[0], at_end[0]);
+
+	if(at_end[0] && at_end[1] && (m_readers[0] || m_readers[1]))
+	{
+		WaitForReaders();
+		Finished();
+	}
 }
 
-void CPyProcess::Execute(const wxChar* cmd)
+static wxString FromPython(const std::string& line)
+{
+	wxString s(line.c_str(), wxConvUTF8);
+	if(s.Len() == 0 && line.size() > 0)s = wxString::From8BitData(line.c_str(), line.size()); // it wasn't UTF-8
+	return s;
+}
+
+void CPyProcess::HandleLines(int stream, const std::string& data, bool at_end)
+{
+	// the lines are taken out first, because showing them might show a message box, which would get the next event
+	std::string& partial = m_partial[stream];
+	partial += data;
+	std::list<wxString> lines;
+	size_t start = 0;
+	while(true)
+	{
+		size_t end = partial.find('\n', start);
+		if(end == std::string::npos)break;
+		size_t line_end = (end > start && partial[end - 1] == '\r') ? end - 1 : end;
+		lines.push_back(FromPython(partial.substr(start, line_end - start)));
+		start = end + 1;
+	}
+	partial.erase(0, start);
+	if(at_end && partial.size() > 0)
+	{
+		// the last line didn't have a new line at the end
+		lines.push_back(FromPython(partial));
+		partial.clear();
+	}
+
+	for(std::list<wxString>::iterator It = lines.begin(); It != lines.end(); It++)
+	{
+		if(m_cancelled)break;
+		if(stream == 0)OnLine(*It);
+		else OnErrorLine(*It);
+	}
+}
+
+void CPyProcess::WaitForReaders(void)
 {
-	if(redirect) {
-		Redirect();
+	for(int i = 0; i < 2; i++)
+	{
+		CPyPipeReader* reader = m_readers[i];
+		if(reader == NULL)continue;
+		m_readers[i] = NULL;
+		reader->Wait();
+		delete reader;
 	}
+}
+
+// ThenDo, once the process has finished, and everything it wrote has been seen
+void CPyProcess::Finished(void)
+{
+	if(!m_terminated || m_readers[0] || m_readers[1])return;
+	m_terminated = false;
+	ThenDo();
+}
+
+void CPyProcess::Execute(const wxChar* cmd)
+{
+	Started();
+	if(redirect)Redirect();
+
 	// make process group leader so Cancel kan terminate process including children
+#if wxCHECK_VERSION(2, 9, 2)
+	wxExecuteEnv env;
+	if(redirect)
+	{
+		// so python writes each line when it is printed, not when its buffer is full
+		wxGetEnvMap(&env.env);
+		env.env[_T("PYTHONUNBUFFERED")] = _T("1");
+	}
+	m_pid = wxExecute(cmd, wxEXEC_ASYNC|wxEXEC_MAKE_GROUP_LEADER, this, &env);
+#else
+	// the process takes a copy of HeeksCAD's environment, so it is only changed while the process is started
+	wxString unbuffered;
+	bool was_set = wxGetEnv(_T("PYTHONUNBUFFERED"), &unbuffered);
+	if(redirect)wxSetEnv(_T("PYTHONUNBUFFERED"), _T("1"));
 	m_pid = wxExecute(cmd, wxEXEC_ASYNC|wxEXEC_MAKE_GROUP_LEADER, this);
+	if(redirect)
+	{
+		if(was_set)wxSetEnv(_T("PYTHONUNBUFFERED"), unbuffered);
+		else wxUnsetEnv(_T("PYTHONUNBUFFERED"));
+	}
+#endif
 	if (!m_pid) {
 	  wxLogMessage(_T("could not execute '%s'"),cmd);
 	}
+	else if (redirect) {
+		StartReaders();
+	}
+}
+
+// the folder with backplot.py and post_worker.py in
+static wxString GetScriptFolder()
+{
+#ifdef WIN32
+	return theApp.GetDllFolder() + _T("\\");
+#else
+	#ifdef RUNINPLACE
+		return theApp.GetDllFolder() + _T("/");
+	#else
+		#ifdef CMAKE_UNIX
+			return _T("/usr/lib/heekscnc/");
+		#else
+			return theApp.GetDllFolder() + _T("/../heekscnc/");
+		#endif
+	#endif
+#endif
+}
+
+#define WORKER_DONE_MARKER "HEEKSCNC_WORKER_JOB_DONE"
+
+// a python, started once and kept running, which runs the python scripts, one after the other, so python,
+// and area and ocl, are only loaded once, not for every post-process and backplot; see post_worker.py.
+// Each job is sent as a line on the worker's stdin, and the worker writes WORKER_DONE_MARKER to stdout and stderr when it has finished;
+// the job is done when the marker has come from both, so none of the errors are missed.
+// If the worker stops in the middle of a job, or the job is cancelled, a new one is started for the next job.
+class CPyWorker : public CPyProcess
+{
+	CPyProcess* m_job; // the process the script is being run for, which is given the worker's output, and told when it has finished
+	int m_markers_seen;
+	bool m_use_Clipper_not_Boolean; // area stays loaded, so the worker has to be restarted to change it
+
+	static CPyWorker* m_object;
+	static std::list<CPyWorker*> m_finished; // workers which have stopped, to be deleted when the next one is started
+
+	CPyWorker(): m_job(NULL), m_markers_seen(0), m_use_Clipper_not_Boolean(theApp.m_use_Clipper_not_Boolean){}
+
+	static void Start()
+	{
+		// not deleted in their own ThenDo, which is called from their own event handlers
+		for(std::list<CPyWorker*>::iterator It = m_finished.begin(); It != m_finished.end(); It++)delete *It;
+		m_finished.clear();
+
+		CPyWorker* worker = new CPyWorker;
+		redirect = true; // the jobs are sent through stdin
+#ifdef WIN32
+		worker->Execute(wxString(_T("\"")) + theApp.GetDllFolder() + _T("\\post.bat\" \"") + GetScriptFolder() + _T("post_worker.py\""));
+#else
+		worker->Execute(wxString(_T("python \"")) + GetScriptFolder() + _T("post_worker.py\""));
+#endif
+		if(worker->m_pid)m_object = worker;
+		else m_finished.push_back(worker);
+	}
 
-	if (redirect) {
-		m_timer.Start(100);   //msec
+	void JobDone()
+	{
+		CPyProcess* job = m_job;
+		m_job = NULL;
+		m_markers_seen = 0;
+		job->m_in_worker = false;
+		job->ThenDo();
 	}
+
+	void OnWorkerLine(const wxString& line, bool error)
+	{
+		// the marker may be at the end of the script's last line, if it didn't end with a new line
+		wxString text = line;
+		bool marker = line.EndsWith(_T(WORKER_DONE_MARKER), &text);
+
+		if(!marker || text.Len() > 0)
+		{
+			if(m_job == NULL){ if(error)CPyProcess::OnErrorLine(text); else CPyProcess::OnLine(text); }
+			else if(error)m_job->OnErrorLine(text);
+			else m_job->OnLine(text);
+		}
+
+		if(marker)
+		{
+			m_markers_seen++;
+			if(m_markers_seen == 2 && m_job)JobDone();
+		}
+	}
+
+	void OnLine(const wxString& line){ OnWorkerLine(line, false); }
+	void OnErrorLine(const wxString& line){ OnWorkerLine(line, true); }
+
+	void ThenDo(void)
+	{
+		// the worker has stopped
+		if(m_object == this)m_object = NULL;
+		if(m_job)
+		{
+			// the script didn't finish, so its output mustn't be used
+			m_job->m_there_were_errors = true;
+			m_job->OnErrorLine(_("python stopped while running the script"));
+			Start();
+			JobDone();
+		}
+		m_finished.push_back(this);
+	}
+
+public:
+	// returns false if the worker couldn't take the job, because it is busy or isn't running
+	static bool Run(CPyProcess* job, const wxString& script, const std::list<wxString> &args)
+	{
+		if(!theApp.m_use_python_worker)return false;
+
+		if(m_object && m_object->m_job == NULL && m_object->m_use_Clipper_not_Boolean != theApp.m_use_Clipper_not_Boolean)Stop();
+		if(m_object == NULL)Start();
+		if(m_object == NULL || m_object->m_job != NULL)return false;
+
+		wxOutputStream* out = m_object->GetOutputStream();
+		if(out == NULL)return false;
+
+		wxString line = wxGetCwd() + _T("\t") + script;
+		for(std::list<wxString>::const_iterator It = args.begin(); It != args.end(); It++)
+		{
+			line << _T("\t") << *It;
+		}
+		line << _T("\n");
+
+		const wxCharBuffer buffer = line.mb_str(wxConvUTF8);
+		out->Write(buffer.data(), strlen(buffer.data()));
+		if(out->GetLastError() != wxSTREAM_NO_ERROR)
+		{
+			Stop();
+			return false;
+		}
+
+		m_object->m_job = job;
+		m_object->m_markers_seen = 0;
+		job->m_in_worker = true;
+		return true;
+	}
+
+	static void CancelJob(CPyProcess* job)
+	{
+		job->m_in_worker = false;
+		if(m_object == NULL || m_object->m_job != job)return;
+
+		// there's no way to stop just the script, so the worker is killed, and another one started, ready for the next job
+		Stop();
+		Start();
+	}
+
+	static void Stop()
+	{
+		if(m_object == NULL)return;
+		CPyWorker* worker = m_object;
+		m_object = NULL;
+		if(worker->m_job)
+		{
+			worker->m_job->m_in_worker = false;
+			worker->m_job = NULL;
+
+			// not Cancel, which forgets the pid, so the worker would never be told it has finished
+			worker->m_cancelled = true; // nothing more it writes is shown
+			if(wxProcess::Exists(worker->m_pid))wxKill(worker->m_pid, wxSIGTERM, NULL, wxKILL_CHILDREN);
+		}
+		else
+		{
+			worker->CloseOutput(); // the worker finishes when its stdin is closed
+		}
+	}
+};
+
+CPyWorker* CPyWorker::m_object = NULL;
+std::list<CPyWorker*> CPyWorker::m_finished;
+
+void CPyProcess::ExecutePython(const wxChar* cmd, const wxString& script, const std::list<wxString> &args)
+{
+	Started();
+	if(!CPyWorker::Run(this, script, args))Execute(cmd);
 }
 
 void CPyProcess::Cancel(void)
 {
+	m_cancelled = true; // nothing more it writes is shown
+
+	if (m_in_worker)
+	{
+		CPyWorker::CancelJob(this);
+		return;
+	}
+
 	if (m_pid)
 	{
 		wxKillError kerror;
@@ -117,87 +512,16 @@ void CPyProcess::OnTerminate(int pid, int status)
 {
 	if (pid == m_pid)
 	{
-	  if (redirect) {
-		  m_timer.Stop();
-		  HandleInput();   // anything left?
-	  }
-
+	  if (status != 0)m_there_were_errors = true;
 	  m_pid = 0;
-	  ThenDo();
+	  m_terminated = true;
+	  Finished(); // or, if the readers haven't got to the end of what it wrote, when they have
 	}
 	// else: the process already was already treated with Cancel() so m_pid is 0
 }
 
 ////////////////////////////////////////////////////////
 
-static void ClearErrorAndOutputFiles()
-{
-	#if wxCHECK_VERSION(3, 0, 0)
-	wxStandardPaths& standard_paths = wxStandardPaths::Get();
-	#else
-	wxStandardPaths standard_paths;
-	#endif
-	wxFileName errors_path(standard_paths.GetTempDir().c_str(), _T(ERRORS_TXT_FILE_NAME));
-	wxFileName output_path(standard_paths.GetTempDir().c_str(), _T(OUTPUT_TXT_FILE_NAME));
-
-	// clear the error and output files
-	{
-		ofstream ofs(Ttc(errors_path.GetFullPath().c_str()));
-	}
-	{
-		ofstream ofs(Ttc(output_path.GetFullPath().c_str()));
-	}
-}
-
-static bool ProcessErrorAndOutputFiles()
-{
-#if wxCHECK_VERSION(3, 0, 0)
-	wxStandardPaths& standard_paths = wxStandardPaths::Get();
-#else
-	wxStandardPaths standard_paths;
-#endif
-	wxFileName errors_path(standard_paths.GetTempDir().c_str(), _T(ERRORS_TXT_FILE_NAME));
-	wxFileName output_path(standard_paths.GetTempDir().c_str(), _T(OUTPUT_TXT_FILE_NAME));
-
-	ifstream ifs(Ttc(errors_path.GetFullPath().c_str()));
-	if (!ifs)
-	{
-#ifdef UNICODE
-		std::wostringstream l_ossMessage;
-#else
-		std::ostringstream l_ossMessage;
-#endif
-
-		l_ossMessage << "Could not open '" << errors_path.GetFullPath().c_str() << "' for reading";
-		wxMessageBox(l_ossMessage.str().c_str());
-		return false;
-	}
-
-	char str[1024] = "";
-
-	bool there_were_errors = false;
-	while (!(ifs.eof()))
-	{
-		ifs.getline(str, 1024);
-		if (strlen(str) > 0)
-		{
-			there_were_errors = true;
-			theApp.m_output_canvas->m_textCtrl->AppendText(Ctt(str));
-			theApp.m_output_canvas->m_textCtrl->AppendText(_T("\n"));
-		}
-	}
-
-	if (there_were_errors)
-	{
-		wxFont font(12, wxFONTFAMILY_DEFAULT, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false, _T("Lucida Console"), wxFONTENCODING_SYSTEM);
-		theApp.m_output_canvas->m_textCtrl->SetFont(font);
-		wxMessageBox(_("There were errors!, see Output window"));
-		return false;
-	}
-
-	return true;
-}
-
 class CPyBackPlot : public CPyProcess
 {
 protected:
@@ -216,39 +540,51 @@ public:
 
 	void Do(void)
 	{
-		ClearErrorAndOutputFiles();
-
 		if (m_busy_cursor == NULL)m_busy_cursor = new wxBusyCursor();
 
+		// remove any old binary file, so the xml file is used if the python can't write a new one
+		wxString binary_file_str = m_program->GetBinaryBackplotFilePath();
+		if(wxFileExists(binary_file_str))wxRemoveFile(binary_file_str);
+
 		if (m_program->m_machine.reader == _T("not found"))
 		{
 			wxMessageBox(_T("Machine reader name (defined in Program Properties) not found"));
 		} // End if - then
 		else
 		{
+			std::list<wxString> args;
+			args.push_back(m_program->m_machine.reader);
+			args.push_back(m_filename);
+			args.push_back(_T("binary"));
+
 			#ifdef WIN32
-				Execute(wxString(_T("\"")) + theApp.GetDllFolder() + _T("\\nc_read.bat\" ") + m_program->m_machine.reader + _T(" \"") + m_filename + _T("\""));
+				ExecutePython(wxString(_T("\"")) + theApp.GetDllFolder() + _T("\\nc_read.bat\" ") + m_program->m_machine.reader + _T(" \"") + m_filename + _T("\" binary"), GetScriptFolder() + _T("backplot.py"), args);
 			#else
-				#ifdef RUNINPLACE
-					wxString path(theApp.GetDllFolder() +_T("/"));
-				#else
-					#ifdef CMAKE_UNIX
-						wxString path(_T("/usr/lib/heekscnc/"));
-					#else
-						wxString path(theApp.GetDllFolder() + _T("/../heekscnc/"));
-					#endif
-				#endif
-
-				Execute(wxString(_T("python \"")) + path + wxString(_T("backplot.py\" \"")) + m_program->m_machine.reader + wxString(_T("\" \"")) + m_filename + wxString(_T("\"")) );
+				wxString path = GetScriptFolder();
+				ExecutePython(wxString(_T("python \"")) + path + wxString(_T("backplot.py\" \"")) + m_program->m_machine.reader + wxString(_T("\" \"")) + m_filename + wxString(_T("\" binary")), path + _T("backplot.py"), args);
 			#endif
 		} // End if - else
 	}
 	void ThenDo(void)
 	{
-		if (!ProcessErrorAndOutputFiles())
+		if (!ProcessErrors())
 			return;
 
-		// there should now be an xml file written
+		// read the binary file, if the python wrote one, straight into the program's nc code
+		if(m_into->GetType() == ProgramType)
+		{
+			CNCCode* nc_code = ((CProgram*)m_into)->NCCode();
+			if(nc_code && nc_code->ReadFromBinaryFile(m_program->GetBinaryBackplotFilePath()))
+			{
+				heeksCAD->Repaint();
+				heeksCAD->GetMainFrame()->Raise();
+				delete m_busy_cursor;
+				m_busy_cursor = NULL;
+				return;
+			}
+		}
+
+		// otherwise there should now be an xml file written
 		wxString xml_file_str = theApp.m_program->GetBackplotFilePath();
 		wxFile ofs(xml_file_str.c_str());
 		if(!ofs.IsOpened())
@@ -271,6 +607,21 @@ public:
 
 CPyBackPlot* CPyBackPlot::m_object = NULL;
 
+// reads the nc file with CNCReader, if it can be used instead of the machine's python reader
+static bool BuiltInBackplot(const CProgram* program, HeeksObj* into, const wxString &filepath)
+{
+	if(!theApp.m_use_builtin_nc_reader || !CNCReader::CanRead(program->m_machine.reader))return false;
+	if(into->GetType() != ProgramType)return false;
+	CNCCode* nc_code = ((CProgram*)into)->NCCode();
+	if(nc_code == NULL)return false;
+
+	wxBusyCursor wait;
+	CNCReader reader;
+	if(!reader.Read(filepath, nc_code))return false;
+	heeksCAD->Repaint();
+	return true;
+}
+
 class CPyPostProcess : public CPyProcess
 {
 protected:
@@ -295,8 +646,6 @@ public:
 
 	void Do(void)
 	{
-		ClearErrorAndOutputFiles();
-
 		wxBusyCursor wait; // show an hour glass until the end of this function
 
 #if wxCHECK_VERSION(3, 0, 0)
@@ -307,19 +656,21 @@ public:
 		wxFileName path(standard_paths.GetTempDir().c_str(), _T("post.py"));
 
 #ifdef WIN32
-        Execute(wxString(_T("\"")) + theApp.GetDllFolder() + wxString(_T("\\post.bat\" \"")) + path.GetFullPath() + wxString(_T("\"")));
+        ExecutePython(wxString(_T("\"")) + theApp.GetDllFolder() + wxString(_T("\\post.bat\" \"")) + path.GetFullPath() + wxString(_T("\"")), path.GetFullPath());
 #else
 
         wxString post_path = wxString(_T("python ")) + path.GetFullPath();
-		Execute(post_path);
+		ExecutePython(post_path, path.GetFullPath());
 #endif
 	}
 	void ThenDo(void)
 	{
-		if (!ProcessErrorAndOutputFiles())
+		theApp.m_print_canvas->HideProgress();
+
+		if (!ProcessErrors())
 			return;
 
-		if (m_include_backplot_processing)
+		if (m_include_backplot_processing && !BuiltInBackplot(m_program, (HeeksObj*)m_program, m_filename))
 		{
 			CPyBackPlot::redirect = true;
 			(new CPyBackPlot(m_program, (HeeksObj*)m_program, m_filename))->Do();
@@ -331,34 +682,22 @@ CPyPostProcess* CPyPostProcess::m_object = NULL;
 
 ////////////////////////////////////////////////////////
 
-static bool write_python_file(const wxString& python_file_path)
-{
-	wxFile ofs(python_file_path.c_str(), wxFile::write);
-	if(!ofs.IsOpened())return false;
-
-	ofs.Write(theApp.m_program->m_python_program.c_str());
-
-	return true;
-}
-
 bool HeeksPyPostProcess(const CProgram* program, const wxString &filepath, const bool include_backplot_processing)
 {
 	try{
-		theApp.m_output_canvas->m_textCtrl->Clear(); // clear the output window
+		theApp.m_output_canvas->Clear(); // clear the output window
 		theApp.m_print_canvas->m_textCtrl->Clear(); // clear the output window
 
-		// write the python file
+		// RewritePythonProgram has already written the python file
 #if wxCHECK_VERSION(3, 0, 0)
 		wxStandardPaths& standard_paths = wxStandardPaths::Get();
 #else
 		wxStandardPaths standard_paths;
 #endif
-		wxFileName file_str(standard_paths.GetTempDir().c_str(), _T("post.py"));
-
-		if(!write_python_file(file_str.GetFullPath()))
+		if(!wxFileExists(program->GetPythonFilePath()))
 		{
 		    wxString error;
-		    error << _T("couldn't write ") << file_str.GetFullPath();
+		    error << _T("couldn't find ") << program->GetPythonFilePath();
 		    wxMessageBox(error.c_str());
 		}
 		else
@@ -389,9 +728,11 @@ bool HeeksPyPostProcess(const CProgram* program, const wxString &filepath, const
 bool HeeksPyBackplot(const CProgram* program, HeeksObj* into, const wxString &filepath)
 {
 	try{
-		theApp.m_output_canvas->m_textCtrl->Clear(); // clear the output window
+		theApp.m_output_canvas->Clear(); // clear the output window
 		theApp.m_print_canvas->m_textCtrl->Clear(); // clear the output window
 
+		if(BuiltInBackplot(program, into, filepath))return true;
+
 		::wxSetWorkingDirectory(theApp.GetDllFolder());
 
 		// call the python file
@@ -415,6 +756,12 @@ void HeeksPyCancel(void)
 {
 	CPyBackPlot::StaticCancel();
 	CPyPostProcess::StaticCancel();
+	theApp.m_print_canvas->HideProgress();
+}
+
+void HeeksPyStopWorker(void)
+{
+	CPyWorker::Stop();
 }
 
 
@@ -449,7 +796,7 @@ void CSendToMachine::SendGCode(const wxChar *gcode)
 				wxMessageBox(wxString(_("Couldn't open file")) + _T(" - ") + ngcpath.GetFullPath());
 				return;
 			}
-			ofs.Write(theApp.m_output_canvas->m_textCtrl->GetValue());
+			ofs.Write(gcode);
 		}
 		wxLogDebug(_T("created '%s')"), ngcpath.GetFullPath().c_str());
 
@@ -8,34 +8,65 @@ class Property;
 #include "PythonString.h"
 #include <wx/process.h>
 
-#define ERRORS_TXT_FILE_NAME "heeks errors.txt"
-#define OUTPUT_TXT_FILE_NAME "heeks output.txt"
+// the start of the lines nc.Creator.progress writes to stdout; see nc/nc.py
+#define PROGRESS_MARKER "HEEKSCNC_PROGRESS"
+
+class CPyPipeReader;
 
 class CPyProcess : public wxProcess
 {
+  friend class CPyWorker;
+  friend class CPyPipeReader;
+
 protected:
   int m_pid;
+  bool m_in_worker; // the script is being run by the python worker, not by its own process
+  bool m_there_were_errors; // python wrote a traceback, or the process failed
+  bool m_cancelled;
+  long m_start_time; // wxGetLocalTime when it was started, for the estimate of the time left
+
+  virtual void OnLine(const wxString& line); // a line the process wrote to stdout, without the new line
+  virtual void OnErrorLine(const wxString& line); // a line it wrote to stderr
+  virtual void OnProgress(int op_index, int op_count, double fraction);
+  void Started(void);
+  bool ProcessErrors(void); // tells the user, and returns false, if there were errors
 
 public:
   CPyProcess(void);
+  virtual ~CPyProcess(void);
   static bool redirect;
 
   void Execute(const wxChar* cmd);
+  // runs the python script, with args, in the python worker, if it can; otherwise executes cmd
+  void ExecutePython(const wxChar* cmd, const wxString& script, const std::list<wxString> &args = std::list<wxString>());
   void Cancel(void);
   void OnTerminate(int pid, int status);
-  void OnTimer(wxTimerEvent& WXUNUSED(event));
+  void OnReceived(wxCommandEvent& WXUNUSED(event));
 
   virtual void ThenDo(void) { }
 
 private:
-  wxTimer m_timer;
-  void HandleInput(void);
-
+  // stdout and stderr are each read by a CPyPipeReader, as soon as the process writes to them.
+  // The reader adds what it reads to m_received, and sends an event, so it is split into lines on the main thread.
+  CPyPipeReader* m_readers[2]; // stdout, stderr
+  wxCriticalSection m_received_lock;
+  std::string m_received[2]; // read, but not yet seen by the main thread
+  bool m_at_end[2]; // the reader has read everything the process will write
+  bool m_event_pending;
+  std::string m_partial[2]; // the start of a line, the rest of which hasn't come yet
+  bool m_terminated;
+
+  void StartReaders(void);
+  void Received(int stream, const char* data, size_t size); // on the reader's thread; data is NULL at the end
+  void HandleLines(int stream, const std::string& data, bool at_end);
+  void WaitForReaders(void);
+  void Finished(void);
 };
 
 bool HeeksPyPostProcess(const CProgram* program, const wxString &filepath, const bool include_backplot_processing);
 bool HeeksPyBackplot(const CProgram* program, HeeksObj* into, const wxString &filepath);
 void HeeksPyCancel(void);
+void HeeksPyStopWorker(void);
 
 
 class CSendToMachine : public CPyProcess
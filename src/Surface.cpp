@@ -12,8 +12,6 @@
 #include "Reselect.h"
 #include "SurfaceDlg.h"
 
-int CSurface::number_for_stl_file = 1;
-
 CSurface::CSurface()
 {
 	ReadDefaultValues();
@@ -16,7 +16,6 @@ public:
 	double m_tolerance;
 	double m_material_allowance;
 	bool m_same_for_each_pattern_position;
-	static int number_for_stl_file;
 
 	//	Constructors.
 	CSurface();
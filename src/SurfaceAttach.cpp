@@ -0,0 +1,380 @@
+// SurfaceAttach.cpp
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+// Only the nc_attach library is built from this, so it doesn't include stdafx.h.
+
+#include "SurfaceAttach.h"
+#include "DropCutterTool.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+SurfaceAttach::SurfaceAttach():m_tool(NULL)
+{
+}
+
+SurfaceAttach::~SurfaceAttach()
+{
+	delete m_tool;
+}
+
+// STL files are little endian
+static double ReadSTLFloat(const unsigned char* b)
+{
+	unsigned int i = (unsigned int)b[0] | ((unsigned int)b[1] << 8) | ((unsigned int)b[2] << 16) | ((unsigned int)b[3] << 24);
+	float f;
+	memcpy(&f, &i, 4);
+	return f;
+}
+
+bool SurfaceAttach::ReadSTLFile(const char* filepath)
+{
+	FILE* fp = fopen(filepath, "rb");
+	if(fp == NULL)return false;
+
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	// a binary file is 80 bytes of header, the number of triangles, then 50 bytes for each triangle
+	unsigned char header[84];
+	bool binary = false;
+	unsigned int num_tris = 0;
+	if(size >= 84 && fread(header, 1, 84, fp) == 84)
+	{
+		num_tris = (unsigned int)header[80] | ((unsigned int)header[81] << 8) | ((unsigned int)header[82] << 16) | ((unsigned int)header[83] << 24);
+		binary = (84 + 50 * (double)num_tris == (double)size);
+	}
+
+	if(binary)
+	{
+		m_grid.m_tris.reserve(m_grid.m_tris.size() + num_tris);
+		unsigned char b[50];
+		for(unsigned int i = 0; i < num_tris; i++)
+		{
+			if(fread(b, 1, 50, fp) != 50)break;
+			double x[9];
+			for(int j = 0; j < 9; j++)x[j] = ReadSTLFloat(&b[12 + j * 4]); // after the normal
+			m_grid.m_tris.push_back(GTri(x));
+		}
+	}
+	else
+	{
+		// an ASCII file; only the vertices are needed
+		fseek(fp, 0, SEEK_SET);
+		char line[1024];
+		double x[9];
+		int num_vertices = 0;
+		while(fgets(line, 1024, fp))
+		{
+			const char* v = strstr(line, "vertex");
+			if(v == NULL)continue;
+			if(sscanf(v + 6, "%lf %lf %lf", &x[num_vertices * 3], &x[num_vertices * 3 + 1], &x[num_vertices * 3 + 2]) != 3)continue;
+			num_vertices++;
+			if(num_vertices == 3)
+			{
+				m_grid.m_tris.push_back(GTri(x));
+				num_vertices = 0;
+			}
+		}
+	}
+
+	fclose(fp);
+	m_grid.Build();
+	return true;
+}
+
+void SurfaceAttach::SetTool(DropCutterTool* tool)
+{
+	delete m_tool;
+	m_tool = tool;
+}
+
+double SurfaceAttach::Drop(double x, double y, double minz)const
+{
+	if(m_tool == NULL || !m_grid.Built())return minz;
+	double e[2] = {x, y};
+	return m_tool->TriTest(e, m_grid, minz);
+}
+
+void SurfaceAttach::AddSamples(const double* start, const double* move, int move_index, double minz, double sampling)
+{
+	Sample sample;
+	sample.m_move = move_index;
+	sample.m_angle = 0.0;
+
+	int type = (int)move[0];
+	if(type == AttachLine)
+	{
+		double dx = move[1] - start[0];
+		double dy = move[2] - start[1];
+		int n = (int)ceil(sqrt(dx * dx + dy * dy) / sampling);
+		if(n < 1)n = 1;
+		for(int i = 1; i <= n; i++)
+		{
+			double fraction = (double)i / n;
+			sample.m_p[0] = (i == n) ? move[1] : start[0] + dx * fraction;
+			sample.m_p[1] = (i == n) ? move[2] : start[1] + dy * fraction;
+			sample.m_p[2] = Drop(sample.m_p[0], sample.m_p[1], minz);
+			m_samples.push_back(sample);
+		}
+	}
+	else
+	{
+		double cx = move[4];
+		double cy = move[5];
+		double radius = sqrt((start[0] - cx) * (start[0] - cx) + (start[1] - cy) * (start[1] - cy));
+		double a0 = atan2(start[1] - cy, start[0] - cx);
+		double a1 = atan2(move[2] - cy, move[1] - cx);
+		double sweep = a1 - a0;
+		if(type == AttachArcCCW)
+		{
+			if(sweep <= 0.000000000001)sweep += 2 * M_PI; // a whole circle, if it ends where it starts
+		}
+		else
+		{
+			if(sweep >= -0.000000000001)sweep -= 2 * M_PI;
+		}
+		m_start_angles[move_index] = a0;
+
+		int n = (int)ceil(radius * fabs(sweep) / sampling);
+		if(n < 1)n = 1;
+		for(int i = 1; i <= n; i++)
+		{
+			sample.m_angle = a0 + sweep * i / n;
+			sample.m_p[0] = (i == n) ? move[1] : cx + radius * cos(sample.m_angle);
+			sample.m_p[1] = (i == n) ? move[2] : cy + radius * sin(sample.m_angle);
+			sample.m_p[2] = Drop(sample.m_p[0], sample.m_p[1], minz);
+			m_samples.push_back(sample);
+		}
+	}
+}
+
+static double Dot(const double* a, const double* b){return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];}
+
+// the angle between two directions, which needn't be unit vectors
+static double Angle(const double* a, const double* b)
+{
+	double c[3] = {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+	return atan2(sqrt(Dot(c, c)), Dot(a, b));
+}
+
+// The directions, from the first sample of a run, for a line which passes within tolerance of every sample added so far.
+// Each sample allows a cone of directions around it; the cone kept is the biggest one inside all of them,
+// so it may be a bit smaller than it need be, but each sample is only looked at once.
+class LineRun
+{
+	const double* m_a;
+	double m_tolerance;
+	bool m_cone; // false until a sample further than the tolerance from m_a has been added
+	double m_axis[3]; // a unit vector
+	double m_angle; // half of the angle of the cone; negative, if there are no directions left
+	double m_max_distance; // of the samples from m_a, so no sample is beyond the end of the line
+
+public:
+	LineRun(const double* a, double tolerance):m_a(a), m_tolerance(tolerance), m_cone(false), m_angle(0.0), m_max_distance(0.0){}
+
+	// can the line go from m_a to p
+	bool CanEndAt(const double* p)const
+	{
+		double w[3] = {p[0] - m_a[0], p[1] - m_a[1], p[2] - m_a[2]};
+		if(sqrt(Dot(w, w)) < m_max_distance)return false;
+		if(!m_cone)return true;
+		return Angle(w, m_axis) <= m_angle;
+	}
+
+	void Add(const double* p)
+	{
+		double w[3] = {p[0] - m_a[0], p[1] - m_a[1], p[2] - m_a[2]};
+		double distance = sqrt(Dot(w, w));
+		if(distance > m_max_distance)m_max_distance = distance;
+		if(distance <= m_tolerance)return; // any line from m_a passes near enough
+
+		double axis[3] = {w[0] / distance, w[1] / distance, w[2] / distance};
+		double angle = asin(m_tolerance / distance);
+		if(!m_cone)
+		{
+			memcpy(m_axis, axis, 3 * sizeof(double));
+			m_angle = angle;
+			m_cone = true;
+			return;
+		}
+		if(m_angle < 0.0)return;
+
+		double d = Angle(m_axis, axis);
+		if(d + angle <= m_angle)
+		{
+			// the new cone is inside the old one
+			memcpy(m_axis, axis, 3 * sizeof(double));
+			m_angle = angle;
+		}
+		else if(d + m_angle > angle)
+		{
+			// the biggest cone in both is between their axes; if they don't overlap, its angle is negative
+			double new_angle = (m_angle + angle - d) * 0.5;
+			if(new_angle >= 0.0)
+			{
+				double turn = (d - angle + m_angle) * 0.5; // from the old axis towards the new one
+				double s = sin(d);
+				double f0 = sin(d - turn) / s;
+				double f1 = sin(turn) / s;
+				for(int k = 0; k < 3; k++)m_axis[k] = m_axis[k] * f0 + axis[k] * f1;
+			}
+			m_angle = new_angle;
+		}
+		// else the old cone is inside the new one
+	}
+};
+
+// The heights, against the angle around an arc's centre, for a helix which passes within tolerance of every sample added so far.
+// This is a range of slopes for the helix, from the first sample of the run.
+class HelixRun
+{
+	double m_a0, m_z0;
+	double m_tolerance;
+	double m_min_slope, m_max_slope;
+
+public:
+	HelixRun(double a0, double z0, double tolerance):m_a0(a0), m_z0(z0), m_tolerance(tolerance), m_min_slope(-1.0e30), m_max_slope(1.0e30){}
+
+	bool CanEndAt(double a, double z)const
+	{
+		if(a == m_a0)return false;
+		double slope = (z - m_z0) / (a - m_a0);
+		return slope >= m_min_slope && slope <= m_max_slope;
+	}
+
+	void Add(double a, double z)
+	{
+		double da = a - m_a0;
+		if(da == 0.0)return;
+		double s0 = (z - m_tolerance - m_z0) / da;
+		double s1 = (z + m_tolerance - m_z0) / da;
+		if(s0 > s1){double temp = s0; s0 = s1; s1 = temp;}
+		if(s0 > m_min_slope)m_min_slope = s0;
+		if(s1 < m_max_slope)m_max_slope = s1;
+	}
+};
+
+void SurfaceAttach::AddMove(int type, const Sample& sample, const double* move)
+{
+	m_moves.push_back(type);
+	m_moves.push_back(sample.m_p[0]);
+	m_moves.push_back(sample.m_p[1]);
+	m_moves.push_back(sample.m_p[2]);
+	m_moves.push_back(move[4]);
+	m_moves.push_back(move[5]);
+}
+
+void SurfaceAttach::CutPath(const double* start, const double* moves, int num_moves, double minz, double sampling, double tolerance)
+{
+	m_moves.clear();
+	m_samples.clear();
+	m_start_angles.resize(num_moves);
+	if(sampling <= 0.0)sampling = 0.1;
+
+	// the start isn't given back, the last move finished there
+	Sample sample;
+	sample.m_p[0] = start[0];
+	sample.m_p[1] = start[1];
+	sample.m_p[2] = Drop(start[0], start[1], minz);
+	sample.m_move = -1;
+	sample.m_angle = 0.0;
+	m_samples.push_back(sample);
+
+	const double* p = start;
+	for(int i = 0; i < num_moves; i++)
+	{
+		AddSamples(p, &moves[i * 6], i, minz, sampling);
+		p = &moves[i * 6 + 1];
+	}
+
+	// join the samples up again, looking at each sample once; arcs are only joined with the rest of the same arc, so they stay arcs
+	int num_samples = (int)m_samples.size();
+	int first = 0;
+	while(first < num_samples - 1)
+	{
+		int move = m_samples[first + 1].m_move;
+		int type = (int)moves[move * 6];
+		int last = first + 1;
+		if(type == AttachLine)
+		{
+			LineRun run(m_samples[first].m_p, tolerance);
+			run.Add(m_samples[last].m_p);
+			while(last + 1 < num_samples && (int)moves[m_samples[last + 1].m_move * 6] == AttachLine && run.CanEndAt(m_samples[last + 1].m_p))
+			{
+				last++;
+				run.Add(m_samples[last].m_p);
+			}
+		}
+		else
+		{
+			double a0 = (m_samples[first].m_move == move) ? m_samples[first].m_angle : m_start_angles[move];
+			HelixRun run(a0, m_samples[first].m_p[2], tolerance);
+			run.Add(m_samples[last].m_angle, m_samples[last].m_p[2]);
+			while(last + 1 < num_samples && m_samples[last + 1].m_move == move && run.CanEndAt(m_samples[last + 1].m_angle, m_samples[last + 1].m_p[2]))
+			{
+				last++;
+				run.Add(m_samples[last].m_angle, m_samples[last].m_p[2]);
+			}
+		}
+		AddMove(type, m_samples[last], &moves[move * 6]);
+		first = last;
+	}
+
+	m_samples.clear();
+}
+
+// the functions nc/attach.py calls, with ctypes
+
+#ifdef WIN32
+#define ATTACH_EXPORT extern "C" __declspec(dllexport)
+#else
+#define ATTACH_EXPORT extern "C"
+#endif
+
+ATTACH_EXPORT void* attach_new(const char* stl_filepath)
+{
+	SurfaceAttach* attach = new SurfaceAttach;
+	if(!attach->ReadSTLFile(stl_filepath))
+	{
+		delete attach;
+		return NULL;
+	}
+	return attach;
+}
+
+ATTACH_EXPORT void attach_delete(void* attach)
+{
+	delete (SurfaceAttach*)attach;
+}
+
+ATTACH_EXPORT void attach_set_tool(void* attach, int type, double diameter, double corner_radius, double flat_radius, double cutting_edge_angle, double allowance)
+{
+	((SurfaceAttach*)attach)->SetTool(DropCutterTool::New(type, diameter, corner_radius, flat_radius, cutting_edge_angle, allowance));
+}
+
+ATTACH_EXPORT double attach_drop(void* attach, double x, double y, double minz)
+{
+	return ((SurfaceAttach*)attach)->Drop(x, y, minz);
+}
+
+// returns the number of moves made, which attach_get_moves copies
+ATTACH_EXPORT int attach_cut_path(void* attach, const double* start, const double* moves, int num_moves, double minz, double sampling, double tolerance)
+{
+	((SurfaceAttach*)attach)->CutPath(start, moves, num_moves, minz, sampling, tolerance);
+	return (int)(((SurfaceAttach*)attach)->GetMoves().size() / 6);
+}
+
+ATTACH_EXPORT void attach_get_moves(void* attach, double* moves)
+{
+	const std::vector<double> &made = ((SurfaceAttach*)attach)->GetMoves();
+	if(made.size() > 0)memcpy(moves, &made[0], made.size() * sizeof(double));
+}
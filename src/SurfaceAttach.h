@@ -0,0 +1,57 @@
+// SurfaceAttach.h
+// Copyright (c) 2009, Dan Heeks
+// This program is released under the BSD license. See the file COPYING for details.
+
+// Projects the moves of an operation, made in xy, down onto a surface, for nc/attach.py.
+// It is built into its own library, nc_attach, which makes no wxWidgets or HeeksCAD calls, so attach.py can load it with ctypes.
+// attach.py hands over a whole path of moves at a time. Each move is sampled, the tool is dropped onto the surface at each sample,
+// then runs of samples which stay on a line, or on a helix over an arc, to within the tolerance, are joined up into single moves again.
+
+#pragma once
+
+#include "GTriGrid.h"
+
+#include <vector>
+
+class DropCutterTool;
+
+// the moves handed to CutPath, and given back by it, are six doubles each; type, x, y, z, and the arc's centre x and y
+enum
+{
+	AttachLine,
+	AttachArcCW,
+	AttachArcCCW
+};
+
+class SurfaceAttach
+{
+	GTriGrid m_grid;
+	DropCutterTool* m_tool;
+	std::vector<double> m_moves; // made by CutPath
+
+	// CutPath's samples
+	class Sample
+	{
+	public:
+		double m_p[3];
+		int m_move; // the move it is on
+		double m_angle; // around the arc's centre, for arcs
+	};
+	std::vector<Sample> m_samples;
+	std::vector<double> m_start_angles; // for each arc, the angle of its start around its centre
+
+	void AddSamples(const double* start, const double* move, int move_index, double minz, double sampling);
+	void AddMove(int type, const Sample& sample, const double* move);
+
+public:
+	SurfaceAttach();
+	~SurfaceAttach();
+
+	bool ReadSTLFile(const char* filepath); // ASCII or binary; returns false if it can't be read
+	void SetTool(DropCutterTool* tool); // it is deleted by this
+	double Drop(double x, double y, double minz)const; // the height of the tool tip at x, y
+
+	// moves start at start ( x y z ); minz is the lowest the tool can go
+	void CutPath(const double* start, const double* moves, int num_moves, double minz, double sampling, double tolerance);
+	const std::vector<double>& GetMoves()const{return m_moves;}
+};